@@ -0,0 +1,291 @@
+#include "aot.hpp"
+#include "chunk.hpp"
+#include "value.hpp"
+#include <cmath>
+
+static std::string escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// a C++ expression producing exactly this value
+static std::string literal(const Value& value) {
+    switch (value.type) {
+        case valueType::NUMBER: {
+            double number = value.data.number;
+            if (!std::isfinite(number)) {
+                //only reachable through -O2 constant folding (eg. 1 / 0) , rebuild it from its bits
+                uint64_t bits;
+                std::memcpy(&bits, &number, sizeof(bits));
+                return "numberFromBits(" + std::to_string(bits) + "ULL)";
+            }
+            char buffer[64];
+            std::snprintf(buffer, sizeof(buffer), "%a", number); //hex float , round trips exactly
+            return std::string("Value(") + buffer + ")";
+        }
+        case valueType::INTEGER:
+            if (value.data.integer == INT64_MIN) return "Value(INT64_MIN)"; //no literal for it
+            return "Value(int64_t(" + std::to_string(value.data.integer) + "LL))";
+        case valueType::BOOLEAN:
+            return value.data.boolean ? "Value(true)" : "Value(false)";
+        case valueType::STRING:
+            return "Value(std::string(\"" + escape(*value.data.string) + "\"))";
+        default:
+            return "Value()";
+    }
+}
+
+bool emitCpp(Chunk* chunk, std::ostream& out, const std::string& functionName, const std::string& sourceName) {
+    const std::vector<Opcode>& code = chunk->code;
+    const std::vector<Value>& constants = chunk->constants.ValueVector;
+
+    // globals become locals of the generated function , one per name
+    std::unordered_map<std::string, int> globals;
+    std::vector<std::string> globalNames;
+    int maxDepth = 0;
+    int depth = 0;
+    bool arrays = false; //globals start out undefined , so only the script itself can make an array
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        Opcode opcode = code[i];
+        if (opcode == Opcode::OP_BREAK) return false; //a debugger's copy , the opcode under the trap is in its side table
+        arrays = arrays || opcode == Opcode::OP_ARRAY || opcode == Opcode::OP_RANGE;
+        if (opcode == Opcode::OP_DEFINE_GLOBAL || opcode == Opcode::OP_GET_GLOBAL || opcode == Opcode::OP_SET_GLOBAL) {
+            std::string name = *constants[static_cast<int>(code[i + 1])].data.string;
+            if (globals.find(name) == globals.end()) {
+                globals[name] = static_cast<int>(globalNames.size());
+                globalNames.push_back(name);
+            }
+        }
+        depth += stackEffect(opcode);
+        maxDepth = std::max(maxDepth, depth);
+    }
+
+    out << "// generated by clox --emit-cpp from " << sourceName << " , do not edit\n";
+    out << "#include \"value.hpp\"\n";
+    out << "#include \"result.hpp\"\n\n";
+    out << "namespace {\n\n";
+    out << "struct Global {\n";
+    out << "    Value value;\n";
+    out << "    bool defined = false;\n";
+    out << "};\n\n";
+    // helpers , a script that never needs one still compiles quietly under -Wall
+    out << "[[maybe_unused]] void runtimeError(const char* message, int line) {\n";
+    out << "    std::cout << \"Runtime Error: \" << message << \" at line \" << line << std::endl;\n";
+    out << "}\n\n";
+    out << "[[maybe_unused]] Value numberFromBits(uint64_t bits) {\n";
+    out << "    double number;\n";
+    out << "    std::memcpy(&number, &bits, sizeof(number));\n";
+    out << "    return Value(number);\n";
+    out << "}\n\n";
+    out << "}\n\n";
+
+    out << "InterpretResult " << functionName << "() {\n";
+    for (size_t g = 0; g < globalNames.size(); g++) {
+        out << "    Global g" << g << "; // " << globalNames[g] << "\n";
+    }
+    for (int s = 0; s < maxDepth; s++) {
+        out << "    Value s" << s << ";\n";
+    }
+    out << "\n";
+
+    auto fail = [&](const std::string& message, int line) {
+        return "{ runtimeError(\"" + escape(message) + "\", " + std::to_string(line)
+               + "); return InterpretResult::INTERPRET_RUNTIME_ERROR; }";
+    };
+    // the array helpers (array.hpp) return their error message , or nullptr
+    auto check = [&](const std::string& call, int line) {
+        return "if (const char* error = " + call + ") { runtimeError(error, " + std::to_string(line)
+               + "); return InterpretResult::INTERPRET_RUNTIME_ERROR; }";
+    };
+    auto opcodeName = [](Opcode opcode) {
+        switch (opcode) {
+            case Opcode::OP_ADD:      return "Opcode::OP_ADD";
+            case Opcode::OP_SUBTRACT: return "Opcode::OP_SUBTRACT";
+            case Opcode::OP_MULTIPLY: return "Opcode::OP_MULTIPLY";
+            case Opcode::OP_DIVIDE:   return "Opcode::OP_DIVIDE";
+            case Opcode::OP_SUM:      return "Opcode::OP_SUM";
+            case Opcode::OP_MIN:      return "Opcode::OP_MIN";
+            case Opcode::OP_MAX:      return "Opcode::OP_MAX";
+            case Opcode::OP_LENGTH:   return "Opcode::OP_LENGTH";
+            default:                  return "Opcode::OP_RANGE";
+        }
+    };
+
+    depth = 0;
+    int lastLine = -1;
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        Opcode opcode = code[i];
+        int line = chunk->lines[i];
+        if (line != lastLine) {
+            out << "    // line " << line << "\n";
+            lastLine = line;
+        }
+        std::string top = "s" + std::to_string(depth - 1);
+        std::string below = "s" + std::to_string(depth - 2);
+        std::string push = "s" + std::to_string(depth);
+
+        switch (opcode) {
+            case Opcode::OP_CONSTANT:
+                out << "    " << push << " = " << literal(constants[static_cast<int>(code[i + 1])]) << ";\n";
+                depth++;
+                break;
+            case Opcode::OP_NIL:
+                out << "    " << push << " = Value();\n";
+                depth++;
+                break;
+            case Opcode::OP_TRUE:
+            case Opcode::OP_FALSE:
+                out << "    " << push << " = Value(" << (opcode == Opcode::OP_TRUE ? "true" : "false") << ");\n";
+                depth++;
+                break;
+            case Opcode::OP_NEGATE:
+                out << "    if (!isNumeric(" << top << ")"
+                    << (arrays ? " && " + top + ".type != valueType::ARRAY" : std::string()) << ") "
+                    << fail("You do know only numbers support '-' right?", line) << "\n";
+                out << "    " << top << ".negate();\n";
+                break;
+            case Opcode::OP_NEGATE_NUM:
+                out << "    " << top << ".data.number = -" << top << ".data.number;\n";
+                break;
+            case Opcode::OP_NOT:
+                out << "    " << top << " = Value(" << top << ".isFalsey());\n";
+                break;
+            case Opcode::OP_ADD:
+            case Opcode::OP_SUBTRACT:
+            case Opcode::OP_MULTIPLY:
+            case Opcode::OP_DIVIDE:
+            case Opcode::OP_GREATER:
+            case Opcode::OP_LESSER:
+            case Opcode::OP_ADD_NUM:
+            case Opcode::OP_SUBTRACT_NUM:
+            case Opcode::OP_MULTIPLY_NUM:
+            case Opcode::OP_DIVIDE_NUM:
+            case Opcode::OP_GREATER_NUM:
+            case Opcode::OP_LESSER_NUM: {
+                const char* symbol;
+                bool checked = true;
+                switch (opcode) {
+                    case Opcode::OP_ADD_NUM:      checked = false; [[fallthrough]];
+                    case Opcode::OP_ADD:          symbol = "+"; break;
+                    case Opcode::OP_SUBTRACT_NUM: checked = false; [[fallthrough]];
+                    case Opcode::OP_SUBTRACT:     symbol = "-"; break;
+                    case Opcode::OP_MULTIPLY_NUM: checked = false; [[fallthrough]];
+                    case Opcode::OP_MULTIPLY:     symbol = "*"; break;
+                    case Opcode::OP_DIVIDE_NUM:   checked = false; [[fallthrough]];
+                    case Opcode::OP_DIVIDE:       symbol = "/"; break;
+                    case Opcode::OP_GREATER_NUM:  checked = false; [[fallthrough]];
+                    case Opcode::OP_GREATER:      symbol = ">"; break;
+                    case Opcode::OP_LESSER_NUM:   checked = false; [[fallthrough]];
+                    default:                      symbol = "<"; break;
+                }
+                if (checked) {
+                    // the Value operators and comparisons carry the integer rules (see value.hpp)
+                    if (symbol[0] == '>' || symbol[0] == '<') {
+                        out << "    if (!isNumeric(" << below << ") || !isNumeric(" << top << ")) "
+                            << fail("Invalid operation for given operands", line) << "\n";
+                        out << "    " << below << " = Value(" << (symbol[0] == '>' ? "greaterThan(" : "lessThan(")
+                            << below << ", " << top << "));\n";
+                    } else if (arrays) {
+                        out << "    if (!isNumeric(" << below << ") || !isNumeric(" << top << ")) {\n";
+                        out << "        " << check(std::string("arrayArithmetic(") + opcodeName(opcode) + ", " + below
+                                                  + ", " + top + ")", line) << "\n";
+                        out << "    } else {\n";
+                        out << "        " << below << " = " << below << " " << symbol << " " << top << ";\n";
+                        out << "    }\n";
+                    } else {
+                        out << "    if (!isNumeric(" << below << ") || !isNumeric(" << top << ")) "
+                            << fail("Invalid operation for given operands", line) << "\n";
+                        out << "    " << below << " = " << below << " " << symbol << " " << top << ";\n";
+                    }
+                } else {
+                    out << "    " << below << " = Value(" << below << ".data.number " << symbol << " " << top
+                        << ".data.number);\n";
+                }
+                depth--;
+                break;
+            }
+            case Opcode::OP_EQUAL:
+                out << "    " << below << " = Value(valuesEqual(" << below << ", " << top << "));\n";
+                depth--;
+                break;
+            case Opcode::OP_PRINT:
+                out << "    " << top << ".printValue();\n";
+                out << "    std::cout << '\\n';\n";
+                depth--;
+                break;
+            case Opcode::OP_POP:
+                depth--;
+                break;
+            case Opcode::OP_DEFINE_GLOBAL:
+            case Opcode::OP_GET_GLOBAL:
+            case Opcode::OP_SET_GLOBAL: {
+                std::string name = *constants[static_cast<int>(code[i + 1])].data.string;
+                std::string global = "g" + std::to_string(globals[name]);
+                if (opcode == Opcode::OP_DEFINE_GLOBAL) {
+                    out << "    " << global << ".value = " << top << ";\n";
+                    out << "    " << global << ".defined = true;\n";
+                    depth--;
+                    break;
+                }
+                out << "    if (!" << global << ".defined) " << fail("Undefined variable '" + name + "'", line) << "\n";
+                if (opcode == Opcode::OP_GET_GLOBAL) {
+                    out << "    " << push << " = " << global << ".value;\n";
+                    depth++;
+                } else {
+                    out << "    " << global << ".value = " << top << ";\n";
+                }
+                break;
+            }
+            case Opcode::OP_YIELD:
+                out << "    // yield , runs to completion\n";
+                break;
+            case Opcode::OP_ARRAY:
+                out << "    " << push << " = Value(NumberArray::create(0));\n";
+                depth++;
+                break;
+            case Opcode::OP_APPEND:
+                out << "    " << check("arrayAppend(" + below + ", " + top + ")", line) << "\n";
+                depth--;
+                break;
+            case Opcode::OP_DOT:
+                out << "    " << check("arrayDot(" + below + ", " + top + ")", line) << "\n";
+                depth--;
+                break;
+            case Opcode::OP_SUM:
+            case Opcode::OP_MIN:
+            case Opcode::OP_MAX:
+            case Opcode::OP_LENGTH:
+            case Opcode::OP_RANGE:
+                out << "    " << check(std::string("arrayBuiltin(") + opcodeName(opcode) + ", " + top + ")", line) << "\n";
+                break;
+            case Opcode::OP_IMPORT: { //the generated function has no modules to run
+                std::string name = *constants[static_cast<int>(code[i + 1])].data.string;
+                out << "    " << fail("Module '" + name + "' isn't loaded , imports need the VM", line) << "\n";
+                break;
+            }
+            case Opcode::OP_RETURN:
+                out << "    return InterpretResult::INTERPRET_OK;\n";
+                break;
+            case Opcode::OP_BREAK: //refused before anything was written
+                break;
+        }
+    }
+    out << "}\n\n";
+
+    out << "#ifndef CLOX_AOT_NO_MAIN\n";
+    out << "int main() {\n";
+    out << "    return " << functionName << "() == InterpretResult::INTERPRET_OK ? 0 : 70;\n";
+    out << "}\n";
+    out << "#endif\n";
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "common.hpp"
+
+class Chunk;
+
+// lowers a compiled chunk into a self contained C++ translation unit.
+// the generated code keeps the VM's semantics (type checks , "Runtime Error: ... at line N"
+// messages using Chunk::lines , print formatting through Value::printValue) and only
+// needs value.hpp / result.hpp , value.cpp and array.cpp from this repository to build :
+//
+//   g++ -std=c++17 -O2 -I<repo> script.cpp <repo>/value.cpp <repo>/array.cpp -o script
+//
+// it defines InterpretResult <functionName>() and , unless CLOX_AOT_NO_MAIN is defined , a main().
+// false , with nothing written , for a chunk with a breakpoint trap in it (see debugger.hpp)
+bool emitCpp(Chunk* chunk, std::ostream& out, const std::string& functionName, const std::string& sourceName);
@@ -0,0 +1,73 @@
+#include "arena.hpp"
+
+// what a release() keeps at most , a huge compile shouldn't pin its memory to the thread forever
+static constexpr size_t KEEP_LIMIT = 1024 * 1024;
+
+Arena::~Arena() {
+    freeBlocks();
+}
+
+void Arena::freeBlocks() {
+    while (this->blocks != nullptr) {
+        Block* next = this->blocks->next;
+        std::free(this->blocks);
+        this->blocks = next;
+    }
+}
+
+void* Arena::allocate(size_t bytes, size_t align) {
+    uintptr_t at = (reinterpret_cast<uintptr_t>(this->cursor) + align - 1) & ~(uintptr_t(align) - 1);
+    if (this->cursor == nullptr || at + bytes > reinterpret_cast<uintptr_t>(this->limit)) {
+        return grow(bytes, align);
+    }
+    this->cursor = reinterpret_cast<char*>(at + bytes);
+    if (this->charge != nullptr) {
+        this->charge->bytes += bytes;
+        this->charge->allocations++;
+    }
+    return reinterpret_cast<void*>(at);
+}
+
+// a new block big enough for this allocation , whatever was left in the current one is given up
+void* Arena::grow(size_t bytes, size_t align) {
+    size_t size = std::max(BLOCK_SIZE, bytes + align);
+    Block* block = static_cast<Block*>(std::malloc(sizeof(Block) + size));
+    if (block == nullptr) throw std::bad_alloc();
+    block->next = this->blocks;
+    block->size = size;
+    this->blocks = block;
+    this->cursor = reinterpret_cast<char*>(block + 1);
+    this->limit = this->cursor + size;
+    return allocate(bytes, align);
+}
+
+// frees every block , and if it took more than one keeps a single block as big as all of them
+// together (up to KEEP_LIMIT) , so the next compile of the same size fits without growing
+void Arena::release() {
+    if (this->blocks == nullptr) return;
+    size_t total = 0;
+    int count = 0;
+    for (Block* block = this->blocks; block != nullptr; block = block->next) {
+        total += block->size;
+        count++;
+    }
+    if (count > 1) {
+        freeBlocks();
+        size_t keep = std::min(total, KEEP_LIMIT);
+        Block* block = static_cast<Block*>(std::malloc(sizeof(Block) + keep));
+        if (block == nullptr) throw std::bad_alloc();
+        block->next = nullptr;
+        block->size = keep;
+        this->blocks = block;
+    }
+    this->cursor = reinterpret_cast<char*>(this->blocks + 1);
+    this->limit = this->cursor + this->blocks->size;
+}
+
+size_t Arena::reserved() const {
+    size_t total = 0;
+    for (Block* block = this->blocks; block != nullptr; block = block->next) {
+        total += block->size;
+    }
+    return total;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "common.hpp"
+#include <cstddef>
+
+// bump pointer scratch memory for one compile. allocate() moves a cursor through a block and only
+// asks the heap for a new block when the current one is full , nothing is freed on its own , the
+// whole arena goes in one release() at the end of the compile. release() keeps one block sized
+// for what the compile needed , so a thread compiling one script after another stops touching the
+// heap once it has seen its largest one.
+// every allocation is charged to whichever counter the owner points charge at , the compiler uses
+// that to split its memory by phase (see CompileMemory in compiler.hpp).
+struct MemoryCount {
+    uint64_t bytes = 0;
+    uint64_t allocations = 0;
+};
+
+class Arena {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    MemoryCount* charge = nullptr; //where allocations are counted , nothing when null
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+    void release();             //everything allocated so far in one go
+    size_t reserved() const;    //bytes held in blocks right now
+
+private:
+    struct Block {
+        Block* next;
+        size_t size; //usable bytes after the header
+    };
+    Block* blocks = nullptr; //newest first , the last one is the kept one
+    char* cursor = nullptr;
+    char* limit = nullptr;
+
+    void* grow(size_t bytes, size_t align);
+    void freeBlocks();
+};
+
+// lets standard containers live in an arena , deallocate is a no-op and the memory comes back
+// with the arena's release()
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    Arena* arena;
+
+    explicit ArenaAllocator(Arena* arena) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
@@ -0,0 +1,423 @@
+#include "array.hpp"
+#include "value.hpp"
+#include <limits>
+#include <new>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CLOX_ARRAY_AVX2
+#endif
+
+// ------ STORAGE ------
+
+static thread_local const std::shared_ptr<std::atomic<size_t>>* currentHeap = nullptr;
+
+ArrayCharge::ArrayCharge(const std::shared_ptr<std::atomic<size_t>>& heap) : previous(currentHeap) {
+    currentHeap = &heap;
+}
+
+ArrayCharge::~ArrayCharge() {
+    currentHeap = this->previous;
+}
+
+NumberArray* NumberArray::create(size_t length) {
+    NumberArray* array = new NumberArray();
+    if (currentHeap != nullptr) {
+        array->heap = *currentHeap;
+        array->heap->fetch_add(sizeof(NumberArray), std::memory_order_relaxed);
+    }
+    array->reserve(length);
+    array->length = length;
+    return array;
+}
+
+NumberArray* NumberArray::copyOf(const double* elements, size_t length) {
+    NumberArray* array = create(length);
+    if (length > 0) std::memcpy(array->elements, elements, length * sizeof(double));
+    return array;
+}
+
+void NumberArray::push(double element) {
+    if (this->length == this->capacity) reserve(std::max<size_t>(8, this->capacity * 2));
+    this->elements[this->length++] = element;
+}
+
+void NumberArray::reserve(size_t capacity) {
+    if (capacity <= this->capacity) return;
+    size_t bytes = (capacity * sizeof(double) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; //aligned_alloc wants a multiple
+    double* grown = static_cast<double*>(std::aligned_alloc(ALIGNMENT, bytes));
+    if (grown == nullptr) throw std::bad_alloc();
+    if (this->length > 0) std::memcpy(grown, this->elements, this->length * sizeof(double));
+    std::free(this->elements);
+    if (this->heap) this->heap->fetch_add(bytes - this->capacity * sizeof(double), std::memory_order_relaxed);
+    this->elements = grown;
+    this->capacity = bytes / sizeof(double);
+}
+
+void NumberArray::destroy() {
+    if (this->heap) this->heap->fetch_sub(sizeof(NumberArray) + this->capacity * sizeof(double), std::memory_order_relaxed);
+    std::free(this->elements);
+    delete this;
+}
+
+// ------ KERNELS ------
+
+namespace {
+
+#ifdef CLOX_ARRAY_AVX2
+bool simd = __builtin_cpu_supports("avx2");
+#else
+bool simd = false;
+#endif
+
+enum class Shape { ARRAYS, SCALAR_SECOND, SCALAR_FIRST };
+
+template <Opcode op>
+inline double apply(double x, double y) {
+    if constexpr (op == Opcode::OP_ADD) return x + y;
+    else if constexpr (op == Opcode::OP_SUBTRACT) return x - y;
+    else if constexpr (op == Opcode::OP_MULTIPLY) return x * y;
+    else return x / y;
+}
+
+template <Opcode op, Shape shape>
+void scalarLoop(const double* x, const double* y, double scalar, double* out, size_t from, size_t length) {
+    for (size_t i = from; i < length; i++) {
+        if constexpr (shape == Shape::ARRAYS) out[i] = apply<op>(x[i], y[i]);
+        else if constexpr (shape == Shape::SCALAR_SECOND) out[i] = apply<op>(x[i], scalar);
+        else out[i] = apply<op>(scalar, x[i]);
+    }
+}
+
+#ifdef CLOX_ARRAY_AVX2
+template <Opcode op>
+__attribute__((target("avx2"))) inline __m256d applyAvx2(__m256d x, __m256d y) {
+    if constexpr (op == Opcode::OP_ADD) return _mm256_add_pd(x, y);
+    else if constexpr (op == Opcode::OP_SUBTRACT) return _mm256_sub_pd(x, y);
+    else if constexpr (op == Opcode::OP_MULTIPLY) return _mm256_mul_pd(x, y);
+    else return _mm256_div_pd(x, y);
+}
+
+// an output bigger than this goes around the cache with streaming stores , reading it back into
+// cache first only to write it out again costs a third of the bandwidth of x + y
+const size_t STREAM_ELEMENTS = 1 << 19;
+
+// two vectors a trip , every element is loaded before its result is stored so out may be x or y
+template <Opcode op, Shape shape, bool stream>
+__attribute__((target("avx2"))) size_t avx2Trips(const double* x, const double* y, double scalar, double* out, size_t length) {
+    __m256d broadcast = _mm256_set1_pd(scalar);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m256d low = _mm256_loadu_pd(x + i);
+        __m256d high = _mm256_loadu_pd(x + i + 4);
+        if constexpr (shape == Shape::ARRAYS) {
+            low = applyAvx2<op>(low, _mm256_loadu_pd(y + i));
+            high = applyAvx2<op>(high, _mm256_loadu_pd(y + i + 4));
+        } else if constexpr (shape == Shape::SCALAR_SECOND) {
+            low = applyAvx2<op>(low, broadcast);
+            high = applyAvx2<op>(high, broadcast);
+        } else {
+            low = applyAvx2<op>(broadcast, low);
+            high = applyAvx2<op>(broadcast, high);
+        }
+        if constexpr (stream) {
+            _mm256_stream_pd(out + i, low);
+            _mm256_stream_pd(out + i + 4, high);
+        } else {
+            _mm256_storeu_pd(out + i, low);
+            _mm256_storeu_pd(out + i + 4, high);
+        }
+    }
+    if constexpr (stream) _mm_sfence();
+    return i;
+}
+
+template <Opcode op, Shape shape>
+void avx2Loop(const double* x, const double* y, double scalar, double* out, size_t length) {
+    bool aligned = reinterpret_cast<uintptr_t>(out) % NumberArray::ALIGNMENT == 0; //always for an array's own buffer
+    size_t done = length >= STREAM_ELEMENTS && aligned ? avx2Trips<op, shape, true>(x, y, scalar, out, length)
+                                                       : avx2Trips<op, shape, false>(x, y, scalar, out, length);
+    scalarLoop<op, shape>(x, y, scalar, out, done, length);
+}
+#endif
+
+template <Opcode op, Shape shape>
+void loop(const double* x, const double* y, double scalar, double* out, size_t length) {
+#ifdef CLOX_ARRAY_AVX2
+    if (simd) {
+        avx2Loop<op, shape>(x, y, scalar, out, length);
+        return;
+    }
+#endif
+    scalarLoop<op, shape>(x, y, scalar, out, 0, length);
+}
+
+template <Shape shape>
+void byOperator(Opcode op, const double* x, const double* y, double scalar, double* out, size_t length) {
+    switch (op) {
+        case Opcode::OP_ADD:      loop<Opcode::OP_ADD, shape>(x, y, scalar, out, length); break;
+        case Opcode::OP_SUBTRACT: loop<Opcode::OP_SUBTRACT, shape>(x, y, scalar, out, length); break;
+        case Opcode::OP_MULTIPLY: loop<Opcode::OP_MULTIPLY, shape>(x, y, scalar, out, length); break;
+        default:                  loop<Opcode::OP_DIVIDE, shape>(x, y, scalar, out, length); break;
+    }
+}
+
+// reductions keep LANES partial results , lane k takes elements k , k + 16 , k + 32 ... which is
+// four AVX2 accumulators side by side. the scalar loops keep the same lanes and both fold them
+// in the same order at the end , so a sum doesn't change with the hardware it ran on
+const size_t LANES = 16;
+
+enum class Reduce { SUM, MIN, MAX, DOT };
+
+template <Reduce kind>
+inline double step(double lane, double x, double y) {
+    if constexpr (kind == Reduce::SUM) return lane + x;
+    else if constexpr (kind == Reduce::MIN) return lane < x ? lane : x; //what minpd does
+    else if constexpr (kind == Reduce::MAX) return lane > x ? lane : x; //and maxpd
+    else return lane + x * y;
+}
+
+template <Reduce kind>
+double start() {
+    if constexpr (kind == Reduce::MIN) return std::numeric_limits<double>::infinity();
+    else if constexpr (kind == Reduce::MAX) return -std::numeric_limits<double>::infinity();
+    else return 0;
+}
+
+// the lanes are full for i < done , the tail goes into them and then they're folded
+template <Reduce kind>
+double finish(double* lanes, const double* x, const double* y, size_t done, size_t length) {
+    for (size_t k = 0; done + k < length; k++) {
+        lanes[k] = step<kind>(lanes[k], x[done + k], kind == Reduce::DOT ? y[done + k] : 0);
+    }
+    double total = lanes[0];
+    for (size_t k = 1; k < LANES; k++) {
+        total = kind == Reduce::DOT ? total + lanes[k] : step<kind>(total, lanes[k], 0);
+    }
+    return total;
+}
+
+template <Reduce kind>
+double reduceScalar(const double* x, const double* y, size_t length) {
+    double lanes[LANES];
+    std::fill(lanes, lanes + LANES, start<kind>());
+    size_t i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        for (size_t k = 0; k < LANES; k++) {
+            lanes[k] = step<kind>(lanes[k], x[i + k], kind == Reduce::DOT ? y[i + k] : 0);
+        }
+    }
+    return finish<kind>(lanes, x, y, i, length);
+}
+
+#ifdef CLOX_ARRAY_AVX2
+template <Reduce kind>
+__attribute__((target("avx2"))) inline __m256d stepAvx2(__m256d lane, const double* x, const double* y) {
+    if constexpr (kind == Reduce::SUM) return _mm256_add_pd(lane, _mm256_loadu_pd(x));
+    else if constexpr (kind == Reduce::MIN) return _mm256_min_pd(lane, _mm256_loadu_pd(x));
+    else if constexpr (kind == Reduce::MAX) return _mm256_max_pd(lane, _mm256_loadu_pd(x));
+    else return _mm256_add_pd(lane, _mm256_mul_pd(_mm256_loadu_pd(x), _mm256_loadu_pd(y))); //no fma , same as scalar
+}
+
+template <Reduce kind>
+__attribute__((target("avx2"))) double reduceAvx2(const double* x, const double* y, size_t length) {
+    __m256d lanes0 = _mm256_set1_pd(start<kind>());
+    __m256d lanes1 = lanes0, lanes2 = lanes0, lanes3 = lanes0;
+    size_t i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        lanes0 = stepAvx2<kind>(lanes0, x + i, y + i);
+        lanes1 = stepAvx2<kind>(lanes1, x + i + 4, y + i + 4);
+        lanes2 = stepAvx2<kind>(lanes2, x + i + 8, y + i + 8);
+        lanes3 = stepAvx2<kind>(lanes3, x + i + 12, y + i + 12);
+    }
+    double lanes[LANES];
+    _mm256_storeu_pd(lanes, lanes0);
+    _mm256_storeu_pd(lanes + 4, lanes1);
+    _mm256_storeu_pd(lanes + 8, lanes2);
+    _mm256_storeu_pd(lanes + 12, lanes3);
+    return finish<kind>(lanes, x, y, i, length);
+}
+#endif
+
+// y is only read for DOT , the others pass x for it so the pointer arithmetic stays in bounds
+template <Reduce kind>
+double reduce(const double* x, const double* y, size_t length) {
+#ifdef CLOX_ARRAY_AVX2
+    if (simd) return reduceAvx2<kind>(x, y, length);
+#endif
+    return reduceScalar<kind>(x, y, length);
+}
+
+}
+
+void elementwise(Opcode op, const double* x, const double* y, double* out, size_t length) {
+    byOperator<Shape::ARRAYS>(op, x, y, 0, out, length);
+}
+
+void elementwiseScalar(Opcode op, const double* x, double scalar, bool scalarFirst, double* out, size_t length) {
+    if (scalarFirst) {
+        byOperator<Shape::SCALAR_FIRST>(op, x, x, scalar, out, length);
+    } else {
+        byOperator<Shape::SCALAR_SECOND>(op, x, x, scalar, out, length);
+    }
+}
+
+double sumElements(const double* x, size_t length) {
+    return reduce<Reduce::SUM>(x, x, length);
+}
+
+double minElement(const double* x, size_t length) {
+    return reduce<Reduce::MIN>(x, x, length);
+}
+
+double maxElement(const double* x, size_t length) {
+    return reduce<Reduce::MAX>(x, x, length);
+}
+
+double dotElements(const double* x, const double* y, size_t length) {
+    return reduce<Reduce::DOT>(x, y, length);
+}
+
+bool arraySimdAvailable() {
+#ifdef CLOX_ARRAY_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+void setArraySimd(bool enabled) {
+    simd = enabled && arraySimdAvailable();
+}
+
+bool arraySimdEnabled() {
+    return simd;
+}
+
+// ------ VALUES ------
+
+const char* arrayArithmetic(Opcode op, Value& first, Value& second) {
+    bool firstArray = first.type == valueType::ARRAY;
+    bool secondArray = second.type == valueType::ARRAY;
+    if ((!firstArray && !secondArray) || (!firstArray && !isNumeric(first)) || (!secondArray && !isNumeric(second))) {
+        return "Invalid operation for given operands";
+    }
+    if (firstArray && secondArray) {
+        NumberArray* x = first.data.array;
+        NumberArray* y = second.data.array;
+        if (x->length != y->length) {
+            return "Array lengths don't match";
+        }
+        if (!x->shared()) {
+            elementwise(op, x->elements, y->elements, x->elements, x->length);
+        } else if (!y->shared()) {
+            elementwise(op, x->elements, y->elements, y->elements, y->length);
+            first = std::move(second);
+        } else {
+            NumberArray* out = NumberArray::create(x->length);
+            elementwise(op, x->elements, y->elements, out->elements, x->length);
+            first = Value(out);
+        }
+        return nullptr;
+    }
+    Value& array = firstArray ? first : second;
+    double scalar = asDouble(firstArray ? second : first);
+    NumberArray* x = array.data.array;
+    NumberArray* out = x->shared() ? NumberArray::create(x->length) : x;
+    elementwiseScalar(op, x->elements, scalar, !firstArray, out->elements, x->length);
+    if (out != x) {
+        first = Value(out);
+    } else if (!firstArray) {
+        first = std::move(second);
+    }
+    return nullptr;
+}
+
+const char* arrayAppend(Value& array, const Value& element) {
+    if (!isNumeric(element)) {
+        return "Array elements must be numbers";
+    }
+    if (array.data.array->shared()) {
+        array = Value(NumberArray::copyOf(array.data.array->elements, array.data.array->length));
+    }
+    array.data.array->push(asDouble(element));
+    return nullptr;
+}
+
+const char* arrayBuiltin(Opcode op, Value& operand) {
+    if (op == Opcode::OP_RANGE) {
+        if (operand.type != valueType::INTEGER || operand.data.integer < 0) {
+            return "range() needs a whole number that isn't negative";
+        }
+        if (static_cast<uint64_t>(operand.data.integer) > SIZE_MAX / sizeof(double) / 2) {
+            return "Array too long";
+        }
+        size_t length = static_cast<size_t>(operand.data.integer);
+        NumberArray* array = NumberArray::create(length);
+        for (size_t k = 0; k < length; k++) array->elements[k] = static_cast<double>(k);
+        operand = Value(array);
+        return nullptr;
+    }
+    if (operand.type != valueType::ARRAY) {
+        switch (op) {
+            case Opcode::OP_SUM: return "sum() needs an array";
+            case Opcode::OP_MIN: return "min() needs an array";
+            case Opcode::OP_MAX: return "max() needs an array";
+            default:             return "len() needs an array";
+        }
+    }
+    const NumberArray& array = *operand.data.array;
+    if ((op == Opcode::OP_MIN || op == Opcode::OP_MAX) && array.length == 0) {
+        return op == Opcode::OP_MIN ? "min() of an empty array" : "max() of an empty array";
+    }
+    switch (op) {
+        case Opcode::OP_SUM: operand = Value(sumElements(array.elements, array.length)); break;
+        case Opcode::OP_MIN: operand = Value(minElement(array.elements, array.length)); break;
+        case Opcode::OP_MAX: operand = Value(maxElement(array.elements, array.length)); break;
+        default:             operand = Value(static_cast<int64_t>(array.length)); break;
+    }
+    return nullptr;
+}
+
+const char* arrayDot(Value& first, const Value& second) {
+    if (first.type != valueType::ARRAY || second.type != valueType::ARRAY) {
+        return "dot() needs two arrays";
+    }
+    if (first.data.array->length != second.data.array->length) {
+        return "Array lengths don't match";
+    }
+    first = Value(dotElements(first.data.array->elements, second.data.array->elements, first.data.array->length));
+    return nullptr;
+}
+
+// * -1 rather than 0 - x , so 0 turns into -0 like a negated number does
+void negateArray(Value& array) {
+    NumberArray* x = array.data.array;
+    NumberArray* out = x->shared() ? NumberArray::create(x->length) : x;
+    elementwiseScalar(Opcode::OP_MULTIPLY, x->elements, -1.0, false, out->elements, x->length);
+    if (out != x) array = Value(out);
+}
+
+bool arraysEqual(const NumberArray& first, const NumberArray& second) {
+    if (first.length != second.length) return false;
+    for (size_t k = 0; k < first.length; k++) {
+        if (first.elements[k] != second.elements[k]) return false;
+    }
+    return true;
+}
+
+static const Builtin builtins[] = {
+    {"sum", Opcode::OP_SUM, 1},
+    {"min", Opcode::OP_MIN, 1},
+    {"max", Opcode::OP_MAX, 1},
+    {"dot", Opcode::OP_DOT, 2},
+    {"len", Opcode::OP_LENGTH, 1},
+    {"range", Opcode::OP_RANGE, 1},
+};
+
+const Builtin* findBuiltin(std::string_view name) {
+    for (const Builtin& builtin : builtins) {
+        if (name == builtin.name) return &builtin;
+    }
+    return nullptr;
+}
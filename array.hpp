@@ -0,0 +1,92 @@
+#pragma once
+#include "common.hpp"
+#include "opcode.hpp"
+#include <atomic>
+#include <string_view>
+
+class Value;
+
+// the elements of an ARRAY value : unboxed doubles in one buffer aligned for AVX2 , so whole array
+// arithmetic and the reductions below are a loop over memory instead of one dispatch per element.
+// the script can't change an array in place , so copying a Value only takes a reference. an
+// operation writes into an operand's buffer when its value is the only one holding it (the
+// temporaries in a * 2 + 1) and into a new buffer otherwise.
+class NumberArray {
+public:
+    static constexpr size_t ALIGNMENT = 32;
+
+    std::atomic<uint32_t> references{1}; //Values holding it , atomic since globals are copied across VMs
+    size_t length = 0;
+    size_t capacity = 0;
+    double* elements = nullptr;
+    std::shared_ptr<std::atomic<size_t>> heap; //where its bytes are charged , see ArrayCharge
+
+    static NumberArray* create(size_t length);                        //elements left uninitialized
+    static NumberArray* copyOf(const double* elements, size_t length);
+
+    void retain() { this->references.fetch_add(1, std::memory_order_relaxed); }
+    void release() {
+        if (this->references.fetch_sub(1, std::memory_order_acq_rel) == 1) destroy();
+    }
+    bool shared() const { return this->references.load(std::memory_order_acquire) != 1; }
+    void push(double element);
+
+private:
+    NumberArray() = default;
+    void reserve(size_t capacity);
+    void destroy();
+};
+
+// arrays made on this thread while one is alive charge their bytes to heap (VM::limits.heapBytes)
+// and give them back when they're freed , by whichever thread or VM drops them last
+class ArrayCharge {
+public:
+    explicit ArrayCharge(const std::shared_ptr<std::atomic<size_t>>& heap);
+    ~ArrayCharge(); //the one before it is current again
+    ArrayCharge(const ArrayCharge&) = delete;
+    ArrayCharge& operator=(const ArrayCharge&) = delete;
+
+private:
+    const std::shared_ptr<std::atomic<size_t>>* previous;
+};
+
+// ------ KERNELS ------
+// AVX2 when the CPU has it , otherwise scalar loops. both give the same bits : the element-wise ops
+// are exact per element and the reductions keep 16 running lanes in the same order either way.
+// out may be x or y.
+
+// x[i] op y[i] for op one of OP_ADD , OP_SUBTRACT , OP_MULTIPLY , OP_DIVIDE
+void elementwise(Opcode op, const double* x, const double* y, double* out, size_t length);
+// x[i] op scalar , or scalar op x[i] when scalarFirst
+void elementwiseScalar(Opcode op, const double* x, double scalar, bool scalarFirst, double* out, size_t length);
+double sumElements(const double* x, size_t length);
+double minElement(const double* x, size_t length);  //length > 0
+double maxElement(const double* x, size_t length);  //length > 0
+double dotElements(const double* x, const double* y, size_t length);
+
+bool arraySimdAvailable();
+void setArraySimd(bool enabled); //false forces the scalar loops even on AVX2 hardware (clox-bench arrays)
+bool arraySimdEnabled();
+
+// ------ VALUES ------
+// what the array opcodes do to Values , shared by VM::run and the C++ that --emit-cpp writes.
+// each leaves its result in its first argument and returns nullptr , or returns the runtime error
+
+// + - * / with an array on either side , the other side an array of the same length or a number
+const char* arrayArithmetic(Opcode op, Value& first, Value& second);
+const char* arrayAppend(Value& array, const Value& element);
+// OP_SUM , OP_MIN , OP_MAX , OP_LENGTH , OP_RANGE
+const char* arrayBuiltin(Opcode op, Value& operand);
+const char* arrayDot(Value& first, const Value& second);
+void negateArray(Value& array);
+bool arraysEqual(const NumberArray& first, const NumberArray& second);
+
+// array functions the compiler knows , called like sum(prices) , a name not followed by '(' is
+// still a plain global
+struct Builtin {
+    const char* name;
+    Opcode opcode;
+    int arity;
+};
+
+const Builtin* findBuiltin(std::string_view name); //nullptr if there's no such function
@@ -0,0 +1,354 @@
+#include "batch.hpp"
+#include "chunk.hpp"
+
+// columns only hold doubles , integer constants are widened on the way in
+void Column::setScalar(const Value& value) {
+    this->type = value.type == valueType::INTEGER ? valueType::NUMBER : value.type;
+    this->scalar = true;
+    this->numbers.clear();
+    this->booleans.clear();
+    if (isNumeric(value)) {
+        this->numbers.push_back(asDouble(value));
+    } else if (value.type == valueType::BOOLEAN) {
+        this->booleans.push_back(value.data.boolean);
+    }
+}
+
+Value Column::at(size_t row) const {
+    size_t index = this->scalar ? 0 : row;
+    switch (this->type) {
+        case valueType::NUMBER:  return Value(this->numbers[index]);
+        case valueType::BOOLEAN: return Value(this->booleans[index] != 0);
+        default:                 return Value();
+    }
+}
+
+void Column::appendTo(Column& output, size_t rows) const {
+    output.type = this->type;
+    output.scalar = false;
+    output.rows += rows;
+    if (this->type == valueType::NUMBER) {
+        if (this->scalar) {
+            output.numbers.insert(output.numbers.end(), rows, this->numbers[0]);
+        } else {
+            output.numbers.insert(output.numbers.end(), this->numbers.begin(), this->numbers.begin() + rows);
+        }
+    } else if (this->type == valueType::BOOLEAN) {
+        if (this->scalar) {
+            output.booleans.insert(output.booleans.end(), rows, this->booleans[0]);
+        } else {
+            output.booleans.insert(output.booleans.end(), this->booleans.begin(), this->booleans.begin() + rows);
+        }
+    }
+}
+
+// ------ KERNELS ------
+// plain loops over restrict pointers so the compiler vectorizes them
+
+template <typename Op>
+static void numberKernel(const Column& a, const Column& b, Column& out, size_t rows, Op op) {
+    out.type = valueType::NUMBER;
+    if (a.scalar && b.scalar) {
+        out.scalar = true;
+        out.numbers.assign(1, op(a.numbers[0], b.numbers[0]));
+        return;
+    }
+    out.scalar = false;
+    out.numbers.resize(rows);
+    double* __restrict result = out.numbers.data();
+    const double* __restrict x = a.numbers.data();
+    const double* __restrict y = b.numbers.data();
+    if (a.scalar) {
+        double first = x[0];
+        for (size_t i = 0; i < rows; i++) result[i] = op(first, y[i]);
+    } else if (b.scalar) {
+        double second = y[0];
+        for (size_t i = 0; i < rows; i++) result[i] = op(x[i], second);
+    } else {
+        for (size_t i = 0; i < rows; i++) result[i] = op(x[i], y[i]);
+    }
+}
+
+template <typename T, typename Op>
+static void compareKernel(const std::vector<T>& x, bool xScalar, const std::vector<T>& y, bool yScalar,
+                          Column& out, size_t rows, Op op) {
+    out.type = valueType::BOOLEAN;
+    if (xScalar && yScalar) {
+        out.scalar = true;
+        out.booleans.assign(1, op(x[0], y[0]));
+        return;
+    }
+    out.scalar = false;
+    out.booleans.resize(rows);
+    uint8_t* __restrict result = out.booleans.data();
+    const T* __restrict first = x.data();
+    const T* __restrict second = y.data();
+    if (xScalar) {
+        T value = first[0];
+        for (size_t i = 0; i < rows; i++) result[i] = op(value, second[i]);
+    } else if (yScalar) {
+        T value = second[0];
+        for (size_t i = 0; i < rows; i++) result[i] = op(first[i], value);
+    } else {
+        for (size_t i = 0; i < rows; i++) result[i] = op(first[i], second[i]);
+    }
+}
+
+// ------ BINDINGS ------
+
+void BatchVM::bind(const std::string& name, const double* values) {
+    Binding binding;
+    binding.type = valueType::NUMBER;
+    binding.numbers = values;
+    this->bindings[name] = binding;
+}
+
+void BatchVM::bind(const std::string& name, const bool* values) {
+    Binding binding;
+    binding.type = valueType::BOOLEAN;
+    binding.booleans = values;
+    this->bindings[name] = binding;
+}
+
+void BatchVM::bindScalar(const std::string& name, const Value& value) {
+    Binding binding;
+    binding.type = value.type;
+    binding.scalar = value;
+    this->bindings[name] = binding;
+}
+
+void BatchVM::clearBindings() {
+    this->bindings.clear();
+}
+
+// ------ EXECUTION ------
+
+InterpretResult BatchVM::run(Chunk* chunk, size_t rows) {
+    return run(chunk, 0, rows);
+}
+
+InterpretResult BatchVM::run(Chunk* chunk, size_t firstRow, size_t rows) {
+    const std::vector<Opcode>& code = chunk->code;
+    const std::vector<Value>& constants = chunk->constants.ValueVector;
+
+    // resolve global names to slots once for the whole run
+    std::unordered_map<std::string, int> slotIndex;
+    std::vector<std::string> names;
+    std::vector<int> slotOf(constants.size(), -1);
+    std::vector<bool> assigned;
+    size_t printCount = 0;
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        Opcode opcode = code[i];
+        if (opcode == Opcode::OP_PRINT) printCount++;
+        if (opcode != Opcode::OP_DEFINE_GLOBAL && opcode != Opcode::OP_GET_GLOBAL && opcode != Opcode::OP_SET_GLOBAL) continue;
+        int constant = static_cast<int>(code[i + 1]);
+        const std::string& name = *constants[constant].data.string;
+        auto found = slotIndex.find(name);
+        if (found == slotIndex.end()) {
+            found = slotIndex.emplace(name, static_cast<int>(names.size())).first;
+            names.push_back(name);
+            assigned.push_back(false);
+        }
+        slotOf[constant] = found->second;
+        if (opcode != Opcode::OP_GET_GLOBAL) assigned[found->second] = true;
+    }
+    std::vector<const Binding*> bound(names.size(), nullptr);
+    for (size_t slot = 0; slot < names.size(); slot++) {
+        auto binding = this->bindings.find(names[slot]);
+        if (binding != this->bindings.end()) bound[slot] = &binding->second;
+    }
+
+    this->results.clear();
+    this->printed.assign(printCount, Column());
+    this->globals.resize(names.size());
+    this->defined.assign(names.size(), false);
+
+    for (size_t start = 0; start < rows; start += BLOCK_SIZE) {
+        size_t n = std::min(BLOCK_SIZE, rows - start);
+
+        // every block starts from the bound inputs , rows never see each other's globals
+        for (size_t slot = 0; slot < names.size(); slot++) {
+            const Binding* binding = bound[slot];
+            this->defined[slot] = binding != nullptr;
+            if (binding == nullptr) continue;
+            Column& global = this->globals[slot];
+            if (binding->numbers != nullptr) {
+                global.type = valueType::NUMBER;
+                global.scalar = false;
+                global.numbers.assign(binding->numbers + firstRow + start, binding->numbers + firstRow + start + n);
+            } else if (binding->booleans != nullptr) {
+                global.type = valueType::BOOLEAN;
+                global.scalar = false;
+                global.booleans.assign(binding->booleans + firstRow + start, binding->booleans + firstRow + start + n);
+            } else {
+                global.setScalar(binding->scalar);
+            }
+        }
+
+        size_t sp = 0;
+        size_t printIndex = 0;
+        auto push = [&]() -> Column& {
+            if (sp == this->stack.size()) this->stack.emplace_back();
+            return this->stack[sp++];
+        };
+
+        for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+            int line = chunk->lines[i];
+            switch (code[i]) {
+                case Opcode::OP_CONSTANT: {
+                    const Value& constant = constants[static_cast<int>(code[i + 1])];
+                    if (constant.type == valueType::STRING) {
+                        runtimeError("Strings are not supported in batch mode", line);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    push().setScalar(constant);
+                    break;
+                }
+                case Opcode::OP_NIL:
+                    push().setScalar(Value());
+                    break;
+                case Opcode::OP_TRUE:
+                case Opcode::OP_FALSE:
+                    push().setScalar(Value(code[i] == Opcode::OP_TRUE));
+                    break;
+                case Opcode::OP_GET_GLOBAL: {
+                    int slot = slotOf[static_cast<int>(code[i + 1])];
+                    if (!this->defined[slot]) {
+                        runtimeError("Undefined variable '" + names[slot] + "'", line);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    push() = this->globals[slot];
+                    break;
+                }
+                case Opcode::OP_SET_GLOBAL:
+                case Opcode::OP_DEFINE_GLOBAL: {
+                    int slot = slotOf[static_cast<int>(code[i + 1])];
+                    if (code[i] == Opcode::OP_SET_GLOBAL && !this->defined[slot]) {
+                        runtimeError("Undefined variable '" + names[slot] + "'", line);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    this->globals[slot] = this->stack[sp - 1];
+                    this->defined[slot] = true;
+                    if (code[i] == Opcode::OP_DEFINE_GLOBAL) sp--;
+                    break;
+                }
+                case Opcode::OP_NEGATE:
+                case Opcode::OP_NEGATE_NUM: {
+                    Column& top = this->stack[sp - 1];
+                    if (top.type != valueType::NUMBER) {
+                        runtimeError("You do know only numbers support '-' right?", line);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    double* __restrict values = top.numbers.data();
+                    size_t count = top.scalar ? 1 : n;
+                    for (size_t row = 0; row < count; row++) values[row] = -values[row];
+                    break;
+                }
+                case Opcode::OP_NOT: {
+                    Column& top = this->stack[sp - 1];
+                    if (top.type == valueType::BOOLEAN) {
+                        size_t count = top.scalar ? 1 : n;
+                        uint8_t* __restrict values = top.booleans.data();
+                        for (size_t row = 0; row < count; row++) values[row] = !values[row];
+                    } else {
+                        top.setScalar(Value(top.type == valueType::NIL)); //!nil is true , !number is false
+                    }
+                    break;
+                }
+                case Opcode::OP_ADD:
+                case Opcode::OP_ADD_NUM:
+                case Opcode::OP_SUBTRACT:
+                case Opcode::OP_SUBTRACT_NUM:
+                case Opcode::OP_MULTIPLY:
+                case Opcode::OP_MULTIPLY_NUM:
+                case Opcode::OP_DIVIDE:
+                case Opcode::OP_DIVIDE_NUM:
+                case Opcode::OP_GREATER:
+                case Opcode::OP_GREATER_NUM:
+                case Opcode::OP_LESSER:
+                case Opcode::OP_LESSER_NUM: {
+                    Column& first = this->stack[sp - 2];
+                    Column& second = this->stack[sp - 1];
+                    if (first.type != valueType::NUMBER || second.type != valueType::NUMBER) {
+                        runtimeError("Invalid operation for given operands", line);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    switch (code[i]) {
+                        case Opcode::OP_ADD:
+                        case Opcode::OP_ADD_NUM:
+                            numberKernel(first, second, this->scratch, n, [](double x, double y) { return x + y; });
+                            break;
+                        case Opcode::OP_SUBTRACT:
+                        case Opcode::OP_SUBTRACT_NUM:
+                            numberKernel(first, second, this->scratch, n, [](double x, double y) { return x - y; });
+                            break;
+                        case Opcode::OP_MULTIPLY:
+                        case Opcode::OP_MULTIPLY_NUM:
+                            numberKernel(first, second, this->scratch, n, [](double x, double y) { return x * y; });
+                            break;
+                        case Opcode::OP_DIVIDE:
+                        case Opcode::OP_DIVIDE_NUM:
+                            numberKernel(first, second, this->scratch, n, [](double x, double y) { return x / y; });
+                            break;
+                        case Opcode::OP_GREATER:
+                        case Opcode::OP_GREATER_NUM:
+                            compareKernel(first.numbers, first.scalar, second.numbers, second.scalar, this->scratch, n,
+                                          [](double x, double y) -> uint8_t { return x > y; });
+                            break;
+                        default:
+                            compareKernel(first.numbers, first.scalar, second.numbers, second.scalar, this->scratch, n,
+                                          [](double x, double y) -> uint8_t { return x < y; });
+                            break;
+                    }
+                    std::swap(first, this->scratch);
+                    sp--;
+                    break;
+                }
+                case Opcode::OP_EQUAL: {
+                    Column& first = this->stack[sp - 2];
+                    Column& second = this->stack[sp - 1];
+                    if (first.type != second.type) {
+                        this->scratch.setScalar(Value(false));
+                    } else if (first.type == valueType::NUMBER) {
+                        compareKernel(first.numbers, first.scalar, second.numbers, second.scalar, this->scratch, n,
+                                      [](double x, double y) -> uint8_t { return x == y; });
+                    } else if (first.type == valueType::BOOLEAN) {
+                        compareKernel(first.booleans, first.scalar, second.booleans, second.scalar, this->scratch, n,
+                                      [](uint8_t x, uint8_t y) -> uint8_t { return x == y; });
+                    } else {
+                        this->scratch.setScalar(Value(first.type == valueType::NIL));
+                    }
+                    std::swap(first, this->scratch);
+                    sp--;
+                    break;
+                }
+                case Opcode::OP_PRINT:
+                    this->stack[sp - 1].appendTo(this->printed[printIndex++], n);
+                    sp--;
+                    break;
+                case Opcode::OP_POP:
+                    sp--;
+                    break;
+                case Opcode::OP_YIELD:
+                    break; //rows run to completion
+                case Opcode::OP_RETURN:
+                    i = code.size();
+                    break;
+                default:
+                    runtimeError("Opcode not supported in batch mode", line);
+                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+            }
+        }
+
+        for (size_t slot = 0; slot < names.size(); slot++) {
+            if (assigned[slot] && this->defined[slot]) {
+                this->globals[slot].appendTo(this->results[names[slot]], n);
+            }
+        }
+    }
+    return InterpretResult::INTERPRET_OK;
+}
+
+void BatchVM::runtimeError(std::string message, int line) {
+    *this->errorOutput << "Runtime Error: " << message << " at line " << line << std::endl;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "common.hpp"
+#include "result.hpp"
+#include "value.hpp"
+
+class Chunk;
+
+// one value per row. constants and scalar bindings are stored once and broadcast.
+class Column {
+public:
+    valueType type = valueType::NIL;
+    bool scalar = true;
+    size_t rows = 0;                //only tracked for results / printed columns
+    std::vector<double> numbers;    //NUMBER columns
+    std::vector<uint8_t> booleans;  //BOOLEAN columns
+
+    void setScalar(const Value& value);
+    Value at(size_t row) const;
+    void appendTo(Column& output, size_t rows) const; //expands scalars
+};
+
+// runs one compiled chunk over many independent rows at once. named globals are bound to
+// input columns , every opcode then works on whole columns (blocks of BLOCK_SIZE rows) so
+// dispatch and type checks are paid once per block instead of once per row.
+// the code has no jumps , so a stack slot has the same type on every row of a block.
+class BatchVM {
+public:
+    static constexpr size_t BLOCK_SIZE = 1024;
+
+    std::unordered_map<std::string, Column> results; //final value of every global the chunk assigns , one row per input row
+    std::vector<Column> printed;                     //one column per print statement , in program order
+    std::ostream* errorOutput = &std::cout;          //where runtime errors go
+
+    void bind(const std::string& name, const double* values);
+    void bind(const std::string& name, const bool* values);
+    void bindScalar(const std::string& name, const Value& value);
+    void clearBindings();
+
+    InterpretResult run(Chunk* chunk, size_t rows);
+    InterpretResult run(Chunk* chunk, size_t firstRow, size_t rows); //rows [firstRow , firstRow + rows) of the bound inputs
+
+private:
+    struct Binding {
+        valueType type;
+        const double* numbers = nullptr;
+        const bool* booleans = nullptr;
+        Value scalar;
+    };
+    std::unordered_map<std::string, Binding> bindings;
+    std::vector<Column> stack;
+    std::vector<Column> globals;
+    std::vector<bool> defined;
+    Column scratch;
+
+    void runtimeError(std::string message, int line);
+};
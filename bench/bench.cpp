@@ -0,0 +1,1449 @@
+// clox-bench : benchmarks for the interpreter engines
+//
+// build from the repository root (everything except main.cpp) :
+//   g++ -std=c++17 -O2 -I. bench/bench.cpp $(ls *.cpp | grep -v main.cpp) -o clox-bench
+//
+// usage :
+//   clox-bench regvm [path] [iterations]    stack VM vs register VM on the same program
+//   clox-bench jit [programs] [iterations]  differential check of the JIT against the interpreter , then timing
+//   clox-bench batch [rows]                 one VM run per row vs columnar BatchVM over all rows
+//   clox-bench parallel [rows] [threads]    ParallelBatch scaling from 1 thread up to [threads]
+//   clox-bench serve [requests] [clients]   localhost load generator against an in-process --serve server
+//   clox-bench fibers [fibers] [threads]    Scheduler cost for a few quanta vs running each script to the end
+//   clox-bench limits [path] [iterations]   cost of VM::limits that are never hit vs unlimited runs
+//   clox-bench parse [terms] [depth]         compile time of one huge expression and of deep nesting
+//   clox-bench memory [scale]                allocations per compile phase for each suite workload
+//   clox-bench integers [stmts] [iterations] the counters workload on integers vs on doubles
+//   clox-bench arrays [length] [iterations]  array kernels with AVX2 vs the scalar loops , against memcpy
+//   clox-bench shared [threads] [seconds]    VMs reading one SharedGlobals store vs private globals , with and without a writer
+//   clox-bench snapshot [globals] [reads]    cold start of a setup script vs starting from its snapshot
+//   clox-bench modules [count] [statements]  loading imports : compiled on 1 thread , on all of them , from the cache
+//   clox-bench stream [MB]                  peak heap of --stream vs a whole-file compile , as the script doubles
+//   clox-bench generate shape [size]        print a generated workload , see workload.hpp
+//   clox-bench suite [options]              scan / compile / run throughput and peak memory per workload ,
+//                                           compared against bench/baseline.txt
+
+#include "common.hpp"
+#include "chunk.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
+#include "regvm.hpp"
+#include "jit.hpp"
+#include "batch.hpp"
+#include "parallel.hpp"
+#include "server.hpp"
+#include "scheduler.hpp"
+#include "scanner.hpp"
+#include "token.hpp"
+#include "workload.hpp"
+#include "array.hpp"
+#include "globals.hpp"
+#include "snapshot.hpp"
+#include "modules.hpp"
+#include "stream.hpp"
+#include <fcntl.h>
+#include <malloc.h>
+#include <atomic>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+#include <random>
+#include <functional>
+#include <chrono>
+#include <cmath>
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static std::string readSource(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Could not open file \"" << path << "\".\n";
+        std::exit(74);
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+// a few globals shuffled through arithmetic
+static std::string arithmeticWorkload(int statements) {
+    const char* names[] = {"a", "b", "c", "d"};
+    const char* ops[] = {"+", "-", "*", "+"};
+    std::ostringstream source;
+    source << "var a = 1.5;\nvar b = 2.25;\nvar c = 0.5;\nvar d = 3.0;\n";
+    for (int i = 0; i < statements; i++) {
+        source << names[i % 4] << " = " << names[(i + 1) % 4] << " " << ops[i % 4] << " "
+               << names[(i + 2) % 4] << ";\n";
+    }
+    return source.str();
+}
+
+// swallows whatever a script prints while it's being timed
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+static int countInstructions(Chunk& chunk) {
+    int count = 0;
+    for (size_t i = 0; i < chunk.code.size(); i += opcodeLength(chunk.code[i])) {
+        count++;
+    }
+    return count;
+}
+
+static int benchRegisterVM(int argc, const char* argv[]) {
+    std::string source = argc > 2 ? readSource(argv[2]) : arithmeticWorkload(60);
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 200000;
+
+    Chunk chunk;
+    chunk.initChunk();
+    if (!compile(source, &chunk)) {
+        return 65;
+    }
+    RegVM regvm;
+    regvm.initVM();
+    RegProgram program;
+    if (!regvm.compile(source, program)) {
+        return 65;
+    }
+
+    NullBuffer null;
+    std::streambuf* console = std::cout.rdbuf(&null);
+
+    VM vm;
+    vm.initVM();
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        vm.interpret(&chunk);
+    }
+    double stackSeconds = secondsSince(start);
+
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        regvm.run(program);
+    }
+    double registerSeconds = secondsSince(start);
+
+    std::cout.rdbuf(console);
+
+    int stackInstructions = countInstructions(chunk);
+    int registerInstructions = static_cast<int>(program.code.size());
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "engine     instructions   us/run    ns/instruction\n";
+    std::cout << "stack      " << std::setw(12) << stackInstructions << "   "
+              << std::setw(7) << stackSeconds * 1e6 / iterations << "   "
+              << std::setw(8) << stackSeconds * 1e9 / iterations / stackInstructions << "\n";
+    std::cout << "register   " << std::setw(12) << registerInstructions << "   "
+              << std::setw(7) << registerSeconds * 1e6 / iterations << "   "
+              << std::setw(8) << registerSeconds * 1e9 / iterations / registerInstructions << "\n";
+    std::cout << "speedup    " << stackSeconds / registerSeconds << "x , "
+              << static_cast<double>(stackInstructions) / registerInstructions << "x fewer dispatches\n";
+    return 0;
+}
+
+// random numeric program : defines , assignments , nested arithmetic and prints
+static std::string randomNumericProgram(std::mt19937& rng) {
+    const char* names[] = {"p", "q", "r", "s", "t"};
+    const char* ops[] = {"+", "-", "*", "/"};
+    std::uniform_int_distribution<int> pick(0, 99);
+    std::ostringstream source;
+    source << std::setprecision(17);
+    int defined = 0;
+
+    std::function<void(int)> expression = [&](int depth) {
+        int roll = pick(rng);
+        if (depth == 0 || roll < 30) {
+            if (defined > 0 && roll % 2 == 0) {
+                source << names[pick(rng) % defined];
+            } else {
+                double constant = (pick(rng) - 50) / 4.0;
+                source << constant;
+                if (constant == std::floor(constant)) source << ".0"; //without a point it's an integer , the JIT leaves those alone
+            }
+        } else if (roll < 40) {
+            source << "-(";
+            expression(depth - 1);
+            source << ")";
+        } else {
+            source << "(";
+            expression(depth - 1);
+            source << " " << ops[pick(rng) % 4] << " ";
+            expression(depth - 1);
+            source << ")";
+        }
+    };
+
+    for (int statement = 0; statement < 12; statement++) {
+        int roll = pick(rng);
+        if (defined < 5 && (defined == 0 || roll < 25)) {
+            source << "var " << names[defined] << " = ";
+            expression(2);
+            source << ";\n";
+            defined++;
+        } else if (roll < 60) {
+            source << names[pick(rng) % defined] << " = ";
+            expression(3);
+            source << ";\n";
+        } else {
+            source << "print ";
+            expression(3);
+            source << ";\n";
+        }
+    }
+    return source.str();
+}
+
+// runs a chunk on a fresh VM , returns everything it printed plus its final globals
+static std::string observe(Chunk& chunk, bool jit) {
+    std::ostringstream output;
+    std::streambuf* console = std::cout.rdbuf(output.rdbuf());
+    VM vm;
+    vm.initVM();
+    vm.useJit = jit;
+    InterpretResult result = vm.interpret(&chunk);
+    std::cout.rdbuf(console);
+
+    std::vector<std::string> names;
+    for (auto& global : vm.globals) names.push_back(global.first);
+    std::sort(names.begin(), names.end());
+    output << "result " << static_cast<int>(result) << "\n";
+    for (auto& name : names) {
+        output << name << " = ";
+        vm.globals[name].printValue(output);
+        output << "\n";
+    }
+    // when both operands are NaN , SSE keeps the first one's sign and the C++ compiler is free to
+    // commute + and * in the interpreter , so only NaN-ness is comparable , not its sign
+    std::string observed = output.str();
+    for (size_t at = observed.find("-nan"); at != std::string::npos; at = observed.find("-nan", at)) {
+        observed.erase(at, 1);
+    }
+    return observed;
+}
+
+static int benchJit(int argc, const char* argv[]) {
+    if (!jitSupported()) {
+        std::cerr << "JIT is only available on x86-64 Linux\n";
+        return 1;
+    }
+    int programs = argc > 2 ? std::atoi(argv[2]) : 2000;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 200000;
+
+    std::mt19937 rng(12345);
+    int compiled = 0;
+    for (int i = 0; i < programs; i++) {
+        std::string source = randomNumericProgram(rng);
+        Chunk chunk;
+        chunk.initChunk();
+        if (!compile(source, &chunk)) {
+            continue;
+        }
+        VM probe;
+        probe.initVM();
+        if (JitCode::compile(&chunk, &probe)) compiled++;
+
+        std::string interpreted = observe(chunk, false);
+        std::string jitted = observe(chunk, true);
+        if (interpreted != jitted) {
+            std::cerr << "MISMATCH on program:\n" << source << "\ninterpreter:\n" << interpreted
+                      << "\njit:\n" << jitted;
+            return 1;
+        }
+    }
+    std::cout << programs << " random programs agree (" << compiled << " compiled by the JIT)\n";
+
+    std::string source = arithmeticWorkload(60);
+    Chunk chunk;
+    chunk.initChunk();
+    compile(source, &chunk);
+    VM vm;
+    vm.initVM();
+    vm.interpret(&chunk); //define the globals so the JIT can assume they are numbers
+    std::unique_ptr<JitCode> jit = JitCode::compile(&chunk, &vm);
+    if (!jit) {
+        std::cerr << "the JIT didn't compile the timing workload\n";
+        return 1;
+    }
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        vm.interpret(&chunk);
+    }
+    double interpreterSeconds = secondsSince(start);
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        jit->run(&vm);
+    }
+    double jitSeconds = secondsSince(start);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "interpreter  " << interpreterSeconds * 1e6 / iterations << " us/run\n";
+    std::cout << "jit          " << jitSeconds * 1e6 / iterations << " us/run (" << jit->codeSize()
+              << " bytes of machine code)\n";
+    std::cout << "speedup      " << interpreterSeconds / jitSeconds << "x\n";
+    return 0;
+}
+
+static int benchBatch(int argc, const char* argv[]) {
+    size_t rows = argc > 2 ? static_cast<size_t>(std::atoll(argv[2])) : 1000000;
+    std::string source = "var y = x * 2 + z / 3 - 1;\nvar big = y > 10;\n";
+
+    Chunk chunk;
+    chunk.initChunk();
+    if (!compile(source, &chunk)) {
+        return 65;
+    }
+    std::vector<double> x(rows);
+    std::vector<double> z(rows);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(-100, 100);
+    for (size_t row = 0; row < rows; row++) {
+        x[row] = uniform(rng);
+        z[row] = uniform(rng);
+    }
+
+    VM vm;
+    vm.initVM();
+    std::vector<double> expected(rows);
+    Clock::time_point start = Clock::now();
+    for (size_t row = 0; row < rows; row++) {
+        vm.globals.clear();
+        vm.globals["x"] = Value(x[row]);
+        vm.globals["z"] = Value(z[row]);
+        vm.interpret(&chunk);
+        expected[row] = asDouble(vm.globals["y"]);
+    }
+    double rowSeconds = secondsSince(start);
+
+    BatchVM batch;
+    batch.bind("x", x.data());
+    batch.bind("z", z.data());
+    start = Clock::now();
+    if (batch.run(&chunk, rows) != InterpretResult::INTERPRET_OK) {
+        return 70;
+    }
+    double batchSeconds = secondsSince(start);
+
+    const Column& y = batch.results["y"];
+    for (size_t row = 0; row < rows; row++) {
+        if (y.numbers[row] != expected[row]) {
+            std::cerr << "MISMATCH at row " << row << ": " << y.numbers[row] << " vs " << expected[row] << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "per-row VM   " << rowSeconds * 1e9 / rows << " ns/row\n";
+    std::cout << "batch        " << batchSeconds * 1e9 / rows << " ns/row\n";
+    std::cout << "speedup      " << rowSeconds / batchSeconds << "x over " << rows << " rows\n";
+    return 0;
+}
+
+static int benchParallel(int argc, const char* argv[]) {
+    size_t rows = argc > 2 ? static_cast<size_t>(std::atoll(argv[2])) : 8000000;
+    unsigned maxThreads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : std::thread::hardware_concurrency();
+    maxThreads = std::max(1u, maxThreads);
+    std::string source = "var y = (x * x + z * z) / (x - z + 0.5) * 3 - x / 7;\nvar big = y > 10;\nprint -y;\n";
+
+    Chunk chunk;
+    chunk.initChunk();
+    if (!compile(source, &chunk)) {
+        return 65;
+    }
+    std::vector<double> x(rows);
+    std::vector<double> z(rows);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(-100, 100);
+    for (size_t row = 0; row < rows; row++) {
+        x[row] = uniform(rng);
+        z[row] = uniform(rng);
+    }
+
+    BatchVM reference;
+    reference.bind("x", x.data());
+    reference.bind("z", z.data());
+    reference.run(&chunk, rows);
+
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) counts.push_back(threads);
+    counts.push_back(maxThreads);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "threads   ms        speedup   efficiency   steals\n";
+    double baseline = 0;
+    for (unsigned threads : counts) {
+        ParallelBatch parallel;
+        parallel.initParallel(threads);
+        parallel.bind("x", x.data());
+        parallel.bind("z", z.data());
+        parallel.run(&chunk, rows); //warm up , first touch of the output buffers
+        Clock::time_point start = Clock::now();
+        if (parallel.run(&chunk, rows) != InterpretResult::INTERPRET_OK) {
+            return 70;
+        }
+        double seconds = secondsSince(start);
+        if (parallel.results["y"].numbers != reference.results["y"].numbers
+            || parallel.results["big"].booleans != reference.results["big"].booleans
+            || parallel.printed[0].numbers != reference.printed[0].numbers) {
+            std::cerr << "MISMATCH with " << threads << " threads\n";
+            return 1;
+        }
+        if (threads == 1) baseline = seconds;
+        std::cout << std::setw(7) << threads << "   " << std::setw(7) << seconds * 1e3 << "   "
+                  << std::setw(7) << baseline / seconds << "   " << std::setw(9)
+                  << 100 * baseline / seconds / threads << "%   " << std::setw(6) << parallel.steals << "\n";
+    }
+    return 0;
+}
+
+// every client keeps one connection open and sends its share of the requests back to back
+static int loadServer(const std::string& socketPath, const std::vector<std::string>& scripts, int requests,
+                      int clients, size_t cacheCapacity) {
+    Server server;
+    server.cache.capacity = cacheCapacity;
+    if (!server.initServer(socketPath, static_cast<unsigned>(clients))) {
+        return 74;
+    }
+    std::thread serving(&Server::serve, &server);
+
+    std::vector<std::vector<double>> latencies(clients);
+    std::atomic<int> failures(0);
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int client = 0; client < clients; client++) {
+        threads.emplace_back([&, client] {
+            int fd = connectServer(socketPath);
+            if (fd < 0) {
+                failures++;
+                return;
+            }
+            char status;
+            std::string output;
+            for (int request = client; request < requests; request += clients) {
+                Clock::time_point sent = Clock::now();
+                if (!writeMessage(fd, 'S', scripts[request % scripts.size()]) || !readMessage(fd, status, output)
+                    || status != '0') {
+                    failures++;
+                    break;
+                }
+                latencies[client].push_back(secondsSince(sent));
+            }
+            close(fd);
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    double seconds = secondsSince(start);
+    server.stop();
+    serving.join();
+
+    std::vector<double> all;
+    for (auto& client : latencies) all.insert(all.end(), client.begin(), client.end());
+    if (failures > 0 || all.empty()) {
+        std::cerr << failures << " clients failed\n";
+        return 1;
+    }
+    std::sort(all.begin(), all.end());
+    std::cout << "cache " << std::setw(3) << cacheCapacity << "   " << std::setw(9) << all.size() / seconds
+              << " req/s   p50 " << std::setw(7) << all[all.size() / 2] * 1e6 << " us   p99 " << std::setw(7)
+              << all[all.size() * 99 / 100] * 1e6 << " us   hits " << server.cache.hits << " misses "
+              << server.cache.misses << "\n";
+    return 0;
+}
+
+static int benchServer(int argc, const char* argv[]) {
+    int requests = argc > 2 ? std::atoi(argv[2]) : 20000;
+    int clients = argc > 3 ? std::atoi(argv[3]) : 4;
+    std::string socketPath = "/tmp/clox-bench-" + std::to_string(getpid()) + ".sock";
+
+    // a handful of distinct short scripts , like a service calling the same few formulas
+    std::vector<std::string> scripts;
+    for (int i = 0; i < 8; i++) {
+        scripts.push_back(arithmeticWorkload(20 + i) + "print a + b + c + d;\n");
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    int status = loadServer(socketPath, scripts, requests, clients, 64);
+    if (status != 0) return status;
+    return loadServer(socketPath, scripts, requests, clients, 0); //recompiles every request
+}
+
+static int benchFibers(int argc, const char* argv[]) {
+    int count = argc > 2 ? std::atoi(argv[2]) : 5000;
+    unsigned threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : std::thread::hardware_concurrency();
+
+    std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+    chunk->initChunk();
+    if (!compile(arithmeticWorkload(60) + "print a + b + c + d;\n", chunk.get())) {
+        return 65;
+    }
+    std::ostringstream expected;
+    VM vm;
+    vm.initVM();
+    vm.output = &expected;
+    vm.interpret(chunk.get());
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << chunk->code.size() << " code units per script , " << count << " fibers on " << threads
+              << " threads\n";
+    std::cout << "quantum   ms        slices/fiber   steals\n";
+    for (size_t quantum : {0, 200, 50, 10}) {
+        Scheduler scheduler;
+        scheduler.initScheduler(threads);
+        scheduler.quantum = quantum;
+        for (int i = 0; i < count; i++) scheduler.spawn(chunk);
+        Clock::time_point start = Clock::now();
+        scheduler.run();
+        double seconds = secondsSince(start);
+        size_t slices = 0;
+        for (auto& fiber : scheduler.fibers) {
+            slices += fiber->slices;
+            if (fiber->result != InterpretResult::INTERPRET_OK || fiber->output.str() != expected.str()) {
+                std::cerr << "fiber " << fiber->id << " went wrong\n";
+                return 1;
+            }
+        }
+        std::cout << std::setw(7) << quantum << "   " << std::setw(7) << seconds * 1e3 << "   " << std::setw(12)
+                  << static_cast<double>(slices) / count << "   " << std::setw(6) << scheduler.steals << "\n";
+    }
+    return 0;
+}
+
+static int benchLimits(int argc, const char* argv[]) {
+    std::string source = argc > 2 ? readSource(argv[2]) : arithmeticWorkload(60);
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 200000;
+
+    Chunk chunk;
+    chunk.initChunk();
+    if (!compile(source, &chunk)) {
+        return 65;
+    }
+    NullBuffer null;
+    std::ostream discard(&null);
+    VM unlimited;
+    unlimited.initVM();
+    unlimited.output = &discard;
+    VM limited;
+    limited.initVM();
+    limited.output = &discard;
+    limited.limits.instructions = 1000000;
+    limited.limits.stackDepth = 1024;
+    limited.limits.heapBytes = 1 << 20;
+
+    // interleaved rounds , so frequency scaling and cache effects hit both sides alike
+    double unlimitedSeconds = 0;
+    double limitedSeconds = 0;
+    for (int round = 0; round < 10; round++) {
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < iterations / 10; i++) {
+            unlimited.interpret(&chunk);
+        }
+        unlimitedSeconds += secondsSince(start);
+        start = Clock::now();
+        for (int i = 0; i < iterations / 10; i++) {
+            if (limited.interpret(&chunk) != InterpretResult::INTERPRET_OK) {
+                std::cerr << "limits were hit\n";
+                return 1;
+            }
+        }
+        limitedSeconds += secondsSince(start);
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "unlimited  " << unlimitedSeconds * 1e6 / iterations << " us/run\n";
+    std::cout << "limited    " << limitedSeconds * 1e6 / iterations << " us/run\n";
+    std::cout << "overhead   " << (limitedSeconds / unlimitedSeconds - 1) * 100 << "%\n";
+    return 0;
+}
+
+// ------ SUITE ------
+
+// every allocation in this binary goes through here so the suite can report peak heap use. two
+// relaxed atomics per call , noise next to what the other benchmarks measure
+static std::atomic<size_t> liveBytes{0};
+static std::atomic<size_t> peakBytes{0};
+static std::atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) throw std::bad_alloc();
+    size_t bytes = malloc_usable_size(memory);
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    size_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    if (memory == nullptr) return;
+    liveBytes.fetch_sub(malloc_usable_size(memory), std::memory_order_relaxed);
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    operator delete(memory);
+}
+
+struct SuiteResult {
+    std::string workload;
+    std::vector<std::pair<std::string, double>> metrics; //scanMBs , compileTokens , vmOps , peakKB
+};
+
+// best of three windows of minSeconds / 3 each , runs per second. the best rather than the mean so
+// a noisy neighbour doesn't read as a regression
+static double runsPerSecond(double minSeconds, const std::function<void()>& body) {
+    double best = 0;
+    for (int window = 0; window < 3; window++) {
+        long runs = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed = 0;
+        do {
+            body();
+            runs++;
+            elapsed = secondsSince(start);
+        } while (elapsed < minSeconds / 3);
+        best = std::max(best, runs / elapsed);
+    }
+    return best;
+}
+
+static bool measureWorkload(const std::string& name, const std::string& source, double minSeconds, SuiteResult& result) {
+    result.workload = name;
+    long tokens = 0;
+    Scanner scanner;
+    scanner.initScanner(source);
+    while (scanner.scanToken().type != TokenType::TOKEN_EOF) tokens++;
+
+    NullBuffer null;
+    std::ostream discard(&null);
+    Chunk chunk;
+    chunk.initChunk();
+    if (!compile(source, &chunk, 1, &discard)) {
+        std::cerr << name << " : workload doesn't compile\n";
+        return false;
+    }
+    int instructions = countInstructions(chunk);
+
+    // peak heap of compiling and running it once , above whatever was live before
+    size_t base = liveBytes.load();
+    peakBytes = base;
+    {
+        Chunk fresh;
+        fresh.initChunk();
+        compile(source, &fresh, 1, &discard);
+        VM vm;
+        vm.initVM();
+        vm.output = &discard;
+        vm.interpret(&fresh);
+    }
+    double peakKB = (peakBytes.load() - base) / 1024.0;
+
+    double scans = runsPerSecond(minSeconds, [&] {
+        Scanner timed;
+        timed.initScanner(source);
+        while (timed.scanToken().type != TokenType::TOKEN_EOF) {
+        }
+    });
+    double compiles = runsPerSecond(minSeconds, [&] {
+        Chunk timed;
+        timed.initChunk();
+        compile(source, &timed, 1, &discard);
+    });
+    VM vm;
+    vm.initVM();
+    vm.output = &discard;
+    double runs = runsPerSecond(minSeconds, [&] {
+        if (vm.interpret(&chunk) != InterpretResult::INTERPRET_OK) std::cerr << name << " : runtime error\n";
+    });
+
+    result.metrics = {
+        {"scanMBs", scans * source.size() / 1e6},
+        {"compileTokens", compiles * tokens},
+        {"vmOps", runs * instructions},
+        {"peakKB", peakKB},
+    };
+    return true;
+}
+
+// "workload metric value" per line , # comments
+// false if there's no file to read , an empty table would let every metric through
+static bool readBaseline(const std::string& path, std::vector<std::pair<std::string, double>>& baseline) {
+    baseline.clear();
+    std::ifstream file(path);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string workload, metric;
+        double value;
+        if (fields >> workload >> metric >> value) baseline.emplace_back(workload + " " + metric, value);
+    }
+    return true;
+}
+
+static int benchSuite(int argc, const char* argv[]) {
+    std::string baselinePath = "bench/baseline.txt";
+    double threshold = 25; //percent
+    double scale = 1;
+    double minSeconds = 0.3;
+    bool update = false;
+    for (int i = 2; i < argc; i++) {
+        std::string option = argv[i];
+        if (option.rfind("--baseline=", 0) == 0) {
+            baselinePath = option.substr(std::string("--baseline=").size());
+        } else if (option.rfind("--threshold=", 0) == 0) {
+            threshold = std::atof(option.c_str() + std::string("--threshold=").size());
+        } else if (option.rfind("--scale=", 0) == 0) {
+            scale = std::atof(option.c_str() + std::string("--scale=").size());
+        } else if (option.rfind("--min-time=", 0) == 0) {
+            minSeconds = std::atof(option.c_str() + std::string("--min-time=").size());
+        } else if (option == "--update") {
+            update = true;
+        } else {
+            std::cerr << "Unknown option " << option << "\n";
+            return 64;
+        }
+    }
+
+    std::vector<std::pair<std::string, double>> baseline;
+    if (!update && !readBaseline(baselinePath, baseline)) { //before minutes of measuring
+        std::cerr << "Could not read the baseline " << baselinePath
+                  << " , run from the repository root , pass --baseline=path or write one with --update\n";
+        return 74;
+    }
+
+    std::vector<SuiteResult> results;
+    for (const WorkloadShape& shape : workloadShapes()) {
+        int size = std::max(1, static_cast<int>(shape.defaultSize * scale));
+        SuiteResult result;
+        if (!measureWorkload(shape.name, generateWorkload(shape.name, size), minSeconds, result)) return 65;
+        results.push_back(result);
+    }
+
+    if (update) {
+        std::ofstream out(baselinePath);
+        if (!out) {
+            std::cerr << "Could not open " << baselinePath << " for writing!\n";
+            return 74;
+        }
+        out << "# clox-bench suite baseline , regenerate with clox-bench suite --update\n";
+        out << "# workload metric value (scanMBs , compileTokens and vmOps per second , peakKB of heap)\n";
+        out << std::fixed << std::setprecision(1);
+        for (const SuiteResult& result : results) {
+            for (const auto& metric : result.metrics) {
+                out << result.workload << " " << metric.first << " " << metric.second << "\n";
+            }
+        }
+        std::cout << "baseline written to " << baselinePath << "\n";
+    }
+
+    if (update && !readBaseline(baselinePath, baseline)) {
+        std::cerr << "Could not read back " << baselinePath << "\n";
+        return 74;
+    }
+    auto expectedFor = [&](const SuiteResult& result, const std::string& metric) {
+        for (const auto& entry : baseline) {
+            if (entry.first == result.workload + " " + metric) return entry.second;
+        }
+        return 0.0;
+    };
+    // throughput regresses when it drops , memory when it grows
+    auto regressed = [&](const SuiteResult& result, const std::pair<std::string, double>& metric) {
+        double expected = expectedFor(result, metric.first);
+        if (expected <= 0) return false;
+        double change = (metric.second / expected - 1) * 100;
+        return metric.first == "peakKB" ? change > threshold : change < -threshold;
+    };
+
+    // a workload that looks slower is measured twice more and keeps its best numbers , one noisy
+    // window shouldn't fail the suite
+    if (!update) {
+        for (SuiteResult& result : results) {
+            for (int retry = 0; retry < 2; retry++) {
+                bool suspect = std::any_of(result.metrics.begin(), result.metrics.end(),
+                                           [&](const auto& metric) { return regressed(result, metric); });
+                if (!suspect) break;
+                int size = 0;
+                for (const WorkloadShape& shape : workloadShapes()) {
+                    if (result.workload == shape.name) size = std::max(1, static_cast<int>(shape.defaultSize * scale));
+                }
+                SuiteResult again;
+                if (!measureWorkload(result.workload, generateWorkload(result.workload, size), minSeconds, again)) return 65;
+                for (size_t k = 0; k < result.metrics.size(); k++) {
+                    double& value = result.metrics[k].second;
+                    value = result.metrics[k].first == "peakKB" ? std::min(value, again.metrics[k].second)
+                                                                : std::max(value, again.metrics[k].second);
+                }
+            }
+        }
+    }
+
+    int regressions = 0;
+    int missing = 0; //measured with nothing to compare against , the baseline is out of date
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "workload  metric                    value       baseline    change\n";
+    for (const SuiteResult& result : results) {
+        for (const auto& metric : result.metrics) {
+            std::cout << std::left << std::setw(10) << result.workload << std::setw(16) << metric.first << std::right
+                      << std::setw(15) << metric.second;
+            double expected = expectedFor(result, metric.first);
+            if (expected <= 0) {
+                missing++;
+                std::cout << "             -  NO BASELINE\n";
+                continue;
+            }
+            bool slower = regressed(result, metric);
+            if (slower) regressions++;
+            std::cout << std::setw(15) << expected << std::setw(9) << std::showpos
+                      << (metric.second / expected - 1) * 100 << "%" << std::noshowpos
+                      << (slower ? "  REGRESSION" : "") << "\n";
+        }
+    }
+    if (regressions > 0) {
+        std::cout << regressions << " metric(s) regressed by more than " << threshold << "%\n";
+    }
+    if (missing > 0) {
+        std::cout << missing << " metric(s) have no entry in " << baselinePath << " , regenerate it with --update\n";
+    }
+    return regressions > 0 || missing > 0 ? 1 : 0;
+}
+
+// one expression with [terms] terms and one nested [depth] parentheses deep , compiled at every
+// level. the parser is iterative , so depth only costs heap , never native stack
+static int benchParse(int argc, const char* argv[]) {
+    int terms = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    int depth = argc > 3 ? std::atoi(argv[3]) : 100000;
+    struct Case {
+        const char* name;
+        std::string source;
+    };
+    std::vector<Case> cases = {{"chain", chainShape(terms)}, {"parens", parensShape(depth)}};
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "case     level     tokens      bytes       ms    Mtokens/s\n";
+    for (const Case& test : cases) {
+        long tokens = 0;
+        Scanner scanner;
+        scanner.initScanner(test.source);
+        while (scanner.scanToken().type != TokenType::TOKEN_EOF) tokens++;
+
+        for (int level = 0; level <= 2; level++) {
+            Chunk chunk;
+            chunk.initChunk();
+            Clock::time_point start = Clock::now();
+            if (!compile(test.source, &chunk, level)) {
+                return 65;
+            }
+            double seconds = secondsSince(start);
+            std::cout << std::left << std::setw(9) << test.name << "-O" << level << std::right << std::setw(12)
+                      << tokens << std::setw(11) << chunk.code.size() << std::setw(9) << seconds * 1e3
+                      << std::setw(13) << tokens / seconds / 1e6 << "\n";
+        }
+    }
+    return 0;
+}
+
+// per phase allocations of one compile of every suite workload (see CompileMemory) , next to every
+// heap allocation the whole compile() made , verifier and type pass included
+static int benchMemory(int argc, const char* argv[]) {
+    double scale = argc > 2 ? std::atof(argv[2]) : 1;
+    NullBuffer null;
+    std::ostream discard(&null);
+    std::cout << "workload     scan allocs/KB    parse allocs/KB     emit allocs/KB   arenaKB   est/code   heap allocs\n";
+    for (const WorkloadShape& shape : workloadShapes()) {
+        std::string source = generateWorkload(shape.name, std::max(1, static_cast<int>(shape.defaultSize * scale)));
+        Chunk chunk;
+        chunk.initChunk();
+        size_t before = allocationCount.load();
+        if (!compile(source, &chunk, 1, &discard)) {
+            std::cerr << shape.name << " : workload doesn't compile\n";
+            return 65;
+        }
+        size_t heap = allocationCount.load() - before;
+        const CompileMemory& memory = lastCompileMemory();
+        auto phase = [](const MemoryCount& count) {
+            std::ostringstream cell;
+            cell << count.allocations << "/" << std::fixed << std::setprecision(1) << count.bytes / 1024.0;
+            return cell.str();
+        };
+        std::cout << std::left << std::setw(10) << shape.name << std::right << std::setw(17) << phase(memory.scan)
+                  << std::setw(19) << phase(memory.parse) << std::setw(19) << phase(memory.emit) << std::setw(10)
+                  << memory.arenaBytes / 1024 << std::setw(11) << std::fixed << std::setprecision(2)
+                  << static_cast<double>(memory.estimatedCode) / chunk.code.size() << std::setw(14) << heap << "\n";
+    }
+    return 0;
+}
+
+// the counters workload twice , once with integer literals and once with the same literals written
+// as doubles , run on the stack VM at -O0 and -O1. -O0 has no type pass , so the gap there is the
+// cost of the integer checks in the generic ops , -O1 shows it once the double run gets its _NUM ops
+static int benchIntegers(int argc, const char* argv[]) {
+    int statements = argc > 2 ? std::atoi(argv[2]) : 400;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 5000;
+    NullBuffer null;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "level    integers us/run    doubles us/run    integers/doubles\n";
+    for (int level = 0; level <= 1; level++) {
+        double seconds[2];
+        for (int doubles = 0; doubles <= 1; doubles++) {
+            Chunk chunk;
+            chunk.initChunk();
+            if (!compile(countersShape(statements, doubles == 1), &chunk, level)) {
+                return 65;
+            }
+            VM vm;
+            vm.initVM();
+            std::streambuf* console = std::cout.rdbuf(&null);
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < iterations; i++) {
+                vm.globals.clear();
+                vm.interpret(&chunk);
+            }
+            seconds[doubles] = secondsSince(start);
+            std::cout.rdbuf(console);
+        }
+        std::cout << "-O" << level << std::setw(23) << seconds[0] * 1e6 / iterations << std::setw(18)
+                  << seconds[1] * 1e6 / iterations << std::setw(20) << seconds[0] / seconds[1] << "\n";
+    }
+    return 0;
+}
+
+// one array expression per case over two host arrays x and y , run on the VM with the AVX2 kernels
+// and with the scalar loops. GB/s counts the bytes a case has to move (8 per element read or
+// written) , memcpy of one array is there as the machine's bandwidth
+static int benchArrays(int argc, const char* argv[]) {
+    size_t length = argc > 2 ? static_cast<size_t>(std::atol(argv[2])) : 1 << 20;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 50;
+    struct Case {
+        const char* expression;
+        int arrays; //arrays read plus arrays written
+    };
+    std::vector<Case> cases = {{"x + y", 3}, {"x * 2.5", 2}, {"x * y + x", 3}, {"-x", 2},
+                               {"sum(x)", 1}, {"min(x)", 1}, {"max(x)", 1}, {"dot(x, y)", 2}};
+
+    std::vector<double> x(length);
+    std::vector<double> y(length);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> uniform(-100, 100);
+    for (size_t k = 0; k < length; k++) {
+        x[k] = uniform(rng);
+        y[k] = uniform(rng) + 200; //never 0 , for the divide kernels
+    }
+    double gigabytes = length * sizeof(double) / 1e9;
+
+    std::vector<double> copy(length);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        std::memcpy(copy.data(), x.data(), length * sizeof(double));
+    }
+    double copySeconds = secondsSince(start);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "avx2 " << (arraySimdAvailable() ? "available" : "not available") << " , " << length
+              << " elements , memcpy " << 2 * gigabytes * iterations / copySeconds << " GB/s\n";
+    std::cout << "case          avx2 GB/s   scalar GB/s   avx2 ns/element   speedup\n";
+    for (const Case& test : cases) {
+        Chunk chunk;
+        chunk.initChunk();
+        if (!compile(std::string("r = ") + test.expression + ";", &chunk)) {
+            return 65;
+        }
+        // the two take turns and keep their best round , on arrays bigger than the cache whichever
+        // ran first would otherwise pay for the page faults of the result buffers
+        double seconds[2] = {1e300, 1e300};
+        for (int round = 0; round < 3; round++) {
+            for (int scalar = 0; scalar <= 1; scalar++) {
+                setArraySimd(scalar == 0);
+                VM vm;
+                vm.initVM();
+                vm.globals["x"] = Value(NumberArray::copyOf(x.data(), length));
+                vm.globals["y"] = Value(NumberArray::copyOf(y.data(), length));
+                vm.globals["r"] = Value();
+                vm.interpret(&chunk); //warm up
+                start = Clock::now();
+                for (int i = 0; i < iterations; i++) {
+                    vm.interpret(&chunk);
+                }
+                seconds[scalar] = std::min(seconds[scalar], secondsSince(start));
+            }
+        }
+        setArraySimd(true);
+        std::cout << std::left << std::setw(12) << test.expression << std::right << std::setw(11)
+                  << test.arrays * gigabytes * iterations / seconds[0] << std::setw(14)
+                  << test.arrays * gigabytes * iterations / seconds[1] << std::setw(18)
+                  << seconds[0] * 1e9 / iterations / length << std::setw(10) << seconds[1] / seconds[0] << "x\n";
+    }
+    return 0;
+}
+
+// reader threads each run a script of global reads over and over on their own VM for a fixed
+// time. private : every VM has its own copy of the globals , the most sharing could hope for.
+// shared : every VM reads one SharedGlobals store. shared + writer : one more thread keeps
+// replacing a global the script reads , so readers keep seeing new boxes and old ones get reclaimed
+static int benchShared(int argc, const char* argv[]) {
+    unsigned maxThreads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : std::thread::hardware_concurrency();
+    maxThreads = std::max(1u, maxThreads);
+    double duration = argc > 3 ? std::atof(argv[3]) : 0.25; //seconds per measurement
+    const int GLOBALS = 64;
+    const int STATEMENTS = 16;
+
+    SharedGlobals store;
+    std::unordered_map<std::string, Value> copy;
+    for (int k = 0; k < GLOBALS; k++) {
+        store.define("c" + std::to_string(k), Value(k + 0.5));
+        copy["c" + std::to_string(k)] = Value(k + 0.5);
+    }
+    std::ostringstream source;
+    for (int k = 0; k < STATEMENTS; k++) {
+        source << "c" << k * 7 % GLOBALS << " * c" << (k * 13 + 1) % GLOBALS << " + c" << (k * 29 + 2) % GLOBALS << ";\n";
+    }
+    int readsPerRun = 3 * STATEMENTS;
+    Chunk chunk;
+    chunk.initChunk();
+    if (!compile(source.str(), &chunk, 1, nullptr, true)) {
+        return 65;
+    }
+
+    enum Mode { PRIVATE, SHARED, WRITER };
+    auto measure = [&](Mode mode, unsigned threads, uint64_t& writes) {
+        std::atomic<bool> stop(false);
+        std::atomic<uint64_t> runs(0);
+        std::atomic<int> failures(0);
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back([&] {
+                VM vm;
+                vm.initVM();
+                if (mode == PRIVATE) {
+                    vm.globals = copy;
+                } else {
+                    vm.share(&store);
+                }
+                uint64_t done = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    if (vm.interpret(&chunk) != InterpretResult::INTERPRET_OK) failures++;
+                    done++;
+                }
+                runs += done;
+            });
+        }
+        std::thread writer;
+        writes = 0;
+        if (mode == WRITER) {
+            writer = std::thread([&] {
+                while (!stop.load(std::memory_order_relaxed)) {
+                    store.set("c0", Value(writes % 2 == 0 ? 0.5 : 1.5));
+                    writes++;
+                }
+            });
+        }
+        Clock::time_point start = Clock::now();
+        std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+        stop = true;
+        for (std::thread& thread : pool) thread.join();
+        if (writer.joinable()) writer.join();
+        double seconds = secondsSince(start);
+        return failures > 0 ? -1.0 : runs * readsPerRun / seconds;
+    };
+
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) counts.push_back(threads);
+    counts.push_back(maxThreads);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << GLOBALS << " globals , " << readsPerRun << " reads a run , " << duration << " s per point\n";
+    std::cout << "threads   private Mreads/s   shared Mreads/s   vs private   scaling   + writer Mreads/s   Mwrites/s\n";
+    double sharedOne = 0;
+    for (unsigned threads : counts) {
+        uint64_t writes = 0;
+        double privateRate = measure(PRIVATE, threads, writes);
+        double sharedRate = measure(SHARED, threads, writes);
+        double writerRate = measure(WRITER, threads, writes);
+        if (privateRate < 0 || sharedRate < 0 || writerRate < 0) {
+            std::cerr << "a run failed with " << threads << " threads\n";
+            return 1;
+        }
+        if (threads == 1) sharedOne = sharedRate;
+        std::cout << std::setw(7) << threads << std::setw(19) << privateRate / 1e6 << std::setw(18) << sharedRate / 1e6
+                  << std::setw(12) << sharedRate / privateRate << "x" << std::setw(9)
+                  << 100 * sharedRate / sharedOne / threads << "%" << std::setw(20) << writerRate / 1e6
+                  << std::setw(12) << writes / duration / 1e6 << "\n";
+    }
+    std::cout << "retired boxes waiting at the end : " << store.retiredCount() << "\n";
+    return 0;
+}
+
+// a process that needs the globals of a setup script , started cold (compile and run the setup ,
+// compile the main script) and from a snapshot of the same state (map it , load the main chunk ,
+// run it). the main script reads reads globals spread over the whole table , page faults count
+// the pages of the snapshot it actually touched
+static int benchSnapshot(int argc, const char* argv[]) {
+    int globals = argc > 2 ? std::atoi(argv[2]) : 20000;
+    int reads = argc > 3 ? std::atoi(argv[3]) : 8;
+    int rounds = 20;
+    std::string setupSource = setupShape(globals);
+    std::ostringstream mainSource;
+    mainSource << "var total = 0";
+    for (int k = 0; k < reads; k++) {
+        int i = static_cast<int>((k * 7919LL) % globals);
+        if (i % 8 == 7) i--; //a config value , not a table
+        mainSource << " + config" << i;
+    }
+    mainSource << ";\n";
+    std::string path = "/tmp/clox-bench-" + std::to_string(getpid()) + ".snap";
+
+    auto minorFaults = [] {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_minflt;
+    };
+
+    double cold = 1e300;
+    Value coldTotal;
+    for (int round = 0; round < rounds; round++) {
+        Clock::time_point start = Clock::now();
+        Chunk setup, main;
+        setup.initChunk();
+        main.initChunk();
+        VM vm;
+        vm.initVM();
+        if (!compile(setupSource, &setup) || vm.interpret(&setup) != InterpretResult::INTERPRET_OK
+            || !compile(mainSource.str(), &main) || vm.interpret(&main) != InterpretResult::INTERPRET_OK) {
+            return 65;
+        }
+        cold = std::min(cold, secondsSince(start));
+        coldTotal = vm.globals["total"];
+    }
+
+    double writing;
+    {
+        Chunk setup, main;
+        setup.initChunk();
+        main.initChunk();
+        VM vm;
+        vm.initVM();
+        compile(setupSource, &setup);
+        compile(mainSource.str(), &main);
+        vm.interpret(&setup);
+        std::string error;
+        Clock::time_point start = Clock::now();
+        if (!writeSnapshot(path, vm, {&main}, error)) {
+            std::cerr << error << "\n";
+            return 74;
+        }
+        writing = secondsSince(start);
+    }
+
+    double warm = 1e300;
+    long faults = 0;
+    size_t fileSize = 0;
+    for (int round = 0; round < rounds; round++) {
+        long before = minorFaults();
+        Clock::time_point start = Clock::now();
+        Snapshot snapshot;
+        std::string error;
+        Chunk main;
+        VM vm;
+        vm.initVM();
+        if (!snapshot.open(path, error) || !snapshot.loadChunk(0, &main, error)) {
+            std::cerr << error << "\n";
+            return 74;
+        }
+        snapshot.restore(vm);
+        if (vm.interpret(&main) != InterpretResult::INTERPRET_OK) {
+            return 70;
+        }
+        double seconds = secondsSince(start);
+        if (seconds < warm) {
+            warm = seconds;
+            faults = minorFaults() - before;
+        }
+        if (!valuesEqual(vm.globals["total"], coldTotal)) {
+            std::cerr << "MISMATCH between the snapshot and a cold start\n";
+            return 1;
+        }
+    }
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) fileSize = info.st_size;
+    std::remove(path.c_str());
+
+    long pages = static_cast<long>((fileSize + 4095) / 4096);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << globals << " globals , main script reads " << reads << "\n";
+    std::cout << "cold start (compile + run setup , compile main)   " << std::setw(9) << cold * 1e3 << " ms\n";
+    std::cout << "from snapshot (map , load main , run)             " << std::setw(9) << warm * 1e3 << " ms   "
+              << cold / warm << "x faster\n";
+    std::cout << "writing the snapshot                              " << std::setw(9) << writing * 1e3 << " ms\n";
+    std::cout << "snapshot " << fileSize / 1024 << " KB (" << pages << " pages) , " << faults
+              << " page faults starting from it\n";
+    return 0;
+}
+
+// a script importing count modules of the arith shape , loaded (found , compiled or read back ,
+// verified) with a fresh Modules each round and then run to check the result : compiled on one thread , compiled on every
+// hardware thread , and read back from the cache the compiles left behind. first it checks that
+// --max-instructions charges an import like the module's source written in its place
+static int benchModules(int argc, const char* argv[]) {
+    int count = argc > 2 ? std::atoi(argv[2]) : 64;
+    int statements = argc > 3 ? std::atoi(argv[3]) : 2000;
+    int rounds = 5;
+    std::string directory = "/tmp/clox-bench-" + std::to_string(getpid()) + "-modules";
+    std::string cache = directory + "/cache";
+    mkdir(directory.c_str(), 0755);
+    std::ostringstream mainSource;
+    for (int k = 0; k < count; k++) {
+        std::ofstream module(directory + "/m" + std::to_string(k) + ".lol");
+        module << "var module" << k << " = " << k << ";\n" << arithShape(statements);
+        mainSource << "import \"m" << k << "\";\n";
+    }
+    mainSource << "var total = a + b + c + d;\n";
+    Chunk main;
+    main.initChunk();
+    if (!compile(mainSource.str(), &main)) return 65;
+
+    Value expected;
+    auto measure = [&](unsigned threads, bool cached, Value& total) {
+        double best = 1e300;
+        for (int round = 0; round < rounds; round++) {
+            if (!cached) std::system(("rm -rf " + cache).c_str());
+            Modules modules;
+            modules.initModules(threads);
+            modules.searchPaths = {directory};
+            modules.cacheDirectory = cache;
+            VM vm;
+            vm.initVM();
+            vm.modules = &modules;
+            Clock::time_point start = Clock::now();
+            if (!modules.load(main, std::cerr)) return -1.0;
+            best = std::min(best, secondsSince(start));
+            if (vm.interpret(&main) != InterpretResult::INTERPRET_OK) return -1.0;
+            total = vm.globals["total"];
+            if (cached && modules.cacheHits != static_cast<size_t>(count)) {
+                std::cerr << "only " << modules.cacheHits << " of " << count << " modules came from the cache\n";
+                return -1.0;
+            }
+        }
+        return best;
+    };
+    // the smallest --max-instructions a chunk runs to the end under , importing m0 vs m0's source
+    // inlined : the import should cost its own OP_IMPORT and nothing more
+    auto smallestBudget = [&](Chunk& chunk) {
+        Modules modules;
+        modules.initModules(1);
+        modules.searchPaths = {directory};
+        modules.cacheDirectory.clear();
+        if (!modules.load(chunk, std::cerr)) return size_t(0);
+        NullBuffer null;
+        std::ostream discard(&null);
+        size_t low = 1, high = chunk.code.size() + 64 * static_cast<size_t>(statements) + 64;
+        while (low < high) {
+            VM vm;
+            vm.initVM();
+            vm.modules = &modules;
+            vm.output = &discard;
+            vm.limits.instructions = (low + high) / 2;
+            if (vm.interpret(&chunk) == InterpretResult::INTERPRET_OK) high = vm.limits.instructions;
+            else low = vm.limits.instructions + 1;
+        }
+        return low;
+    };
+    Chunk imports, inlined;
+    imports.initChunk();
+    inlined.initChunk();
+    std::string tail = "var total = a + b + c + d;\n";
+    if (!compile("import \"m0\";\n" + tail, &imports) || !compile(readSource((directory + "/m0.lol").c_str()) + tail, &inlined)) {
+        return 65;
+    }
+    size_t importBudget = smallestBudget(imports);
+    size_t inlineBudget = smallestBudget(inlined);
+    if (importBudget != inlineBudget + 1) {
+        std::cerr << "MISMATCH : an import needs an instruction budget of " << importBudget << " , inlined "
+                  << inlineBudget << "\n";
+        std::system(("rm -rf " + directory).c_str());
+        return 1;
+    }
+
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    Value parallelTotal, cachedTotal;
+    double serial = measure(1, false, expected);
+    double parallel = measure(hardware, false, parallelTotal);
+    double cached = measure(hardware, true, cachedTotal);
+    std::system(("rm -rf " + directory).c_str());
+    if (serial < 0 || parallel < 0 || cached < 0) return 70;
+    if (!valuesEqual(parallelTotal, expected) || !valuesEqual(cachedTotal, expected)) {
+        std::cerr << "MISMATCH between compiled and cached modules\n";
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << count << " modules of " << statements << " statements , Modules::load\n";
+    std::cout << "instruction budget , import m0 " << importBudget << " , inlined " << inlineBudget << "\n";
+    std::cout << "compiled , 1 thread       " << std::setw(9) << serial * 1e3 << " ms\n";
+    std::cout << "compiled , " << std::setw(2) << hardware << " threads     " << std::setw(9) << parallel * 1e3 << " ms   "
+              << serial / parallel << "x\n";
+    std::cout << "from the cache            " << std::setw(9) << cached * 1e3 << " ms   " << serial / cached << "x\n";
+    return 0;
+}
+
+// the arith shape over and over in a file of 1/4 , 1/2 and all of MB , run as a whole (read , one
+// compile , one run) and through a SourceStream. peak is the most heap live at once above what was
+// live before , the stream's should stay put while the whole-file run's doubles with the file
+static int benchStream(int argc, const char* argv[]) {
+    int megabytes = argc > 2 ? std::atoi(argv[2]) : 64;
+    std::string path = "/tmp/clox-bench-" + std::to_string(getpid()) + ".lol";
+    std::string block = arithShape(2000);
+    auto peakSince = [](size_t before) {
+        return peakBytes.load() - before;
+    };
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "      MB   whole peak MB     whole s   stream peak MB    stream s   segments\n";
+    for (int size : {megabytes / 4, megabytes / 2, megabytes}) {
+        {
+            std::ofstream file(path, std::ios::binary);
+            for (size_t written = 0; written < static_cast<size_t>(std::max(size, 1)) << 20; written += block.size()) {
+                file << block;
+            }
+        }
+
+        size_t before = liveBytes.load();
+        peakBytes.store(before);
+        Clock::time_point start = Clock::now();
+        Value wholeTotal;
+        {
+            std::string source = readSource(path.c_str());
+            Chunk chunk;
+            chunk.initChunk();
+            VM vm;
+            vm.initVM();
+            if (!compile(source, &chunk) || vm.interpret(&chunk) != InterpretResult::INTERPRET_OK) return 65;
+            wholeTotal = vm.globals["a"];
+        }
+        double whole = secondsSince(start);
+        size_t wholePeak = peakSince(before);
+
+        before = liveBytes.load();
+        peakBytes.store(before);
+        start = Clock::now();
+        SourceStream stream;
+        Value streamTotal;
+        {
+            VM vm;
+            vm.initVM();
+            int fd = open(path.c_str(), O_RDONLY);
+            InterpretResult result = stream.run(fd, &vm);
+            close(fd);
+            if (result != InterpretResult::INTERPRET_OK) return 65;
+            streamTotal = vm.globals["a"];
+        }
+        double streamed = secondsSince(start);
+        size_t streamPeak = peakSince(before);
+        if (!valuesEqual(wholeTotal, streamTotal)) {
+            std::cerr << "MISMATCH between the whole-file run and the stream\n";
+            std::remove(path.c_str());
+            return 1;
+        }
+        std::cout << std::setw(8) << stream.bytes / 1048576.0 << std::setw(16) << wholePeak / 1048576.0
+                  << std::setw(12) << whole << std::setw(17) << streamPeak / 1048576.0 << std::setw(12) << streamed
+                  << std::setw(11) << stream.segments << "\n";
+    }
+    std::remove(path.c_str());
+    return 0;
+}
+
+static int benchGenerate(int argc, const char* argv[]) {
+    std::string shape = argc > 2 ? argv[2] : "";
+    int size = argc > 3 ? std::atoi(argv[3]) : 0;
+    int defaultSize = 10000; //chain isn't part of the suite
+    for (const WorkloadShape& known : workloadShapes()) {
+        if (shape == known.name) defaultSize = known.defaultSize;
+    }
+    std::string source = generateWorkload(shape, size > 0 ? size : defaultSize);
+    if (!source.empty()) {
+        std::cout << source;
+        return 0;
+    }
+    std::cerr << "Unknown shape '" << shape << "' , one of : arith globals parens print literals chain counters setup\n";
+    return 64;
+}
+
+int main(int argc, const char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "regvm") {
+        return benchRegisterVM(argc, argv);
+    }
+    if (command == "jit") {
+        return benchJit(argc, argv);
+    }
+    if (command == "batch") {
+        return benchBatch(argc, argv);
+    }
+    if (command == "limits") {
+        return benchLimits(argc, argv);
+    }
+    if (command == "fibers") {
+        return benchFibers(argc, argv);
+    }
+    if (command == "serve") {
+        return benchServer(argc, argv);
+    }
+    if (command == "parallel") {
+        return benchParallel(argc, argv);
+    }
+    if (command == "suite") {
+        return benchSuite(argc, argv);
+    }
+    if (command == "parse") {
+        return benchParse(argc, argv);
+    }
+    if (command == "memory") {
+        return benchMemory(argc, argv);
+    }
+    if (command == "arrays") {
+        return benchArrays(argc, argv);
+    }
+    if (command == "integers") {
+        return benchIntegers(argc, argv);
+    }
+    if (command == "snapshot") {
+        return benchSnapshot(argc, argv);
+    }
+    if (command == "modules") {
+        return benchModules(argc, argv);
+    }
+    if (command == "stream") {
+        return benchStream(argc, argv);
+    }
+    if (command == "shared") {
+        return benchShared(argc, argv);
+    }
+    if (command == "generate") {
+        return benchGenerate(argc, argv);
+    }
+    std::cerr << "Usage: clox-bench regvm [path] [iterations]\n";
+    std::cerr << "       clox-bench jit [programs] [iterations]\n";
+    std::cerr << "       clox-bench batch [rows]\n";
+    std::cerr << "       clox-bench parallel [rows] [threads]\n";
+    std::cerr << "       clox-bench serve [requests] [clients]\n";
+    std::cerr << "       clox-bench fibers [fibers] [threads]\n";
+    std::cerr << "       clox-bench limits [path] [iterations]\n";
+    std::cerr << "       clox-bench parse [terms] [depth]\n";
+    std::cerr << "       clox-bench memory [scale]\n";
+    std::cerr << "       clox-bench integers [statements] [iterations]\n";
+    std::cerr << "       clox-bench arrays [length] [iterations]\n";
+    std::cerr << "       clox-bench shared [threads] [seconds]\n";
+    std::cerr << "       clox-bench snapshot [globals] [reads]\n";
+    std::cerr << "       clox-bench modules [count] [statements]\n";
+    std::cerr << "       clox-bench stream [MB]\n";
+    std::cerr << "       clox-bench generate arith|globals|parens|print|literals|chain|counters|setup [size]\n";
+    std::cerr << "       clox-bench suite [--baseline=path] [--threshold=pct] [--scale=x] [--min-time=s] [--update]\n";
+    return 64;
+}
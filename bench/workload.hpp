@@ -0,0 +1,154 @@
+#pragma once
+// generated scripts for clox-bench suite (and clox-bench generate) , each shape stresses one part
+// of the pipeline :
+//   arith     long arithmetic chains over a few globals          (dispatch , constant loads)
+//   globals   many distinct globals defined and read back         (global table , identifiers)
+//   parens    deeply nested parentheses                           (parser recursion)
+//   print     print-heavy code                                    (output path)
+//   literals  huge pools of distinct number literals               (scanner , constant pool)
+//   chain     one expression with size terms                     (long operator chains , not in the suite)
+//   counters  whole number counters and sums                      (integer fast paths , not in the suite)
+//   setup     a startup phase : many constants and lookup tables   (snapshots , not in the suite)
+// size is the number of statements , except for parens where it's the nesting depth.
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct WorkloadShape {
+    const char* name;
+    int defaultSize;
+};
+
+inline const std::vector<WorkloadShape>& workloadShapes() {
+    static const std::vector<WorkloadShape> shapes = {
+        {"arith", 2000}, {"globals", 2000}, {"parens", 2000}, {"print", 2000}, {"literals", 4000},
+    };
+    return shapes;
+}
+
+inline std::string arithShape(int statements) {
+    const char* names[] = {"a", "b", "c", "d"};
+    const char* ops[] = {"+", "-", "*", "/"};
+    std::ostringstream source;
+    source << "var a = 1.5;\nvar b = 2.25;\nvar c = 0.5;\nvar d = 3;\n";
+    for (int i = 0; i < statements; i++) {
+        source << names[i % 4] << " = ";
+        for (int term = 0; term < 8; term++) { //a chain of 8 terms , alternating globals and literals
+            if (term > 0) source << " " << ops[(i + term) % 4] << " ";
+            if (term % 2 == 0) {
+                source << names[(i + term) % 4];
+            } else {
+                source << (term + i % 7) << ".5";
+            }
+        }
+        source << ";\n";
+    }
+    return source.str();
+}
+
+inline std::string globalsShape(int statements) {
+    std::ostringstream source;
+    int defined = statements / 2 + 1;
+    for (int i = 0; i < defined; i++) {
+        source << "var global" << i << " = " << i << ";\n";
+    }
+    for (int i = defined; i < statements; i++) {
+        int k = i - defined;
+        source << "global" << k << " = global" << (k + 1) % defined << " + global" << (k * 7) % defined << ";\n";
+    }
+    return source.str();
+}
+
+inline std::string parensShape(int depth) {
+    std::ostringstream source;
+    source << "var nested = ";
+    for (int i = 0; i < depth; i++) source << "(";
+    source << "1";
+    for (int i = 0; i < depth; i++) source << " + " << (i % 9) << ")";
+    source << ";\n";
+    return source.str();
+}
+
+inline std::string printShape(int statements) {
+    std::ostringstream source;
+    source << "var x = 0.5;\nvar y = 2;\n";
+    for (int i = 0; i < statements; i++) {
+        switch (i % 3) {
+            case 0: source << "print x + y * " << i % 10 << ";\n"; break;
+            case 1: source << "print x > y;\n"; break;
+            default: source << "print !(x == " << i << ");\n"; break;
+        }
+    }
+    return source.str();
+}
+
+inline std::string literalsShape(int statements) {
+    std::ostringstream source;
+    for (int i = 0; i < statements; i++) { //string literals aren't expressions in the language yet
+        source << "var n" << i << " = " << i << "." << (i * 37) % 1000 << " + " << (i * 7919) % 100003 << ";\n";
+    }
+    return source.str();
+}
+
+inline std::string chainShape(int terms) {
+    const char* ops[] = {" + ", " * ", " - ", " / "};
+    std::ostringstream source;
+    source << "var a = 2;\nvar chain = ";
+    for (int i = 0; i < terms; i++) {
+        if (i > 0) source << ops[i % 4];
+        if (i % 3 == 0) {
+            source << "a";
+        } else {
+            source << (i % 97 + 1);
+        }
+    }
+    source << ";\n";
+    return source.str();
+}
+
+// the same program written with or without a ".0" on every literal , so one runs on integers and
+// the other on doubles
+inline std::string countersShape(int statements, bool doubles = false) {
+    const char* suffix = doubles ? ".0" : "";
+    const char* names[] = {"i", "sum", "step", "product"};
+    std::ostringstream source;
+    source << "var i = 0" << suffix << ";\nvar sum = 0" << suffix << ";\nvar step = 3" << suffix
+           << ";\nvar product = 1" << suffix << ";\n";
+    for (int k = 0; k < statements; k++) {
+        switch (k % 4) {
+            case 0: source << "i = i + 1" << suffix << ";\n"; break;
+            case 1: source << "sum = sum + i * step - " << k % 11 << suffix << ";\n"; break;
+            case 2: source << "product = product * 2" << suffix << " - product;\n"; break;
+            default: source << "step = step + " << k % 5 << suffix << " - " << names[k % 3] << " + " << names[k % 3] << " - " << k % 5 << suffix << ";\n"; break;
+        }
+    }
+    source << "print sum;\nprint sum > product;\n";
+    return source.str();
+}
+
+// size globals , every eighth one a small lookup table , the way a script's setup phase looks
+inline std::string setupShape(int globals) {
+    std::ostringstream source;
+    for (int i = 0; i < globals; i++) {
+        if (i % 8 == 7) {
+            source << "var table" << i << " = range(16) * " << i % 13 << ".5 + " << i << ";\n";
+        } else {
+            source << "var config" << i << " = " << i * 3 << "." << i % 10 << " * 2 - " << i % 7 << ";\n";
+        }
+    }
+    return source.str();
+}
+
+// empty string for an unknown shape
+inline std::string generateWorkload(const std::string& shape, int size) {
+    if (shape == "arith") return arithShape(size);
+    if (shape == "globals") return globalsShape(size);
+    if (shape == "parens") return parensShape(size);
+    if (shape == "print") return printShape(size);
+    if (shape == "literals") return literalsShape(size);
+    if (shape == "chain") return chainShape(size);
+    if (shape == "counters") return countersShape(size);
+    if (shape == "setup") return setupShape(size);
+    return "";
+}
@@ -1,26 +1,47 @@
 #include "chunk.hpp"
+#include <atomic>
+
+uint64_t nextRevision()
+{
+    static std::atomic<uint64_t> threads{0};
+    thread_local uint64_t range = ++threads << 40; //every thread counts in its own range , no shared counter per write
+    thread_local uint64_t last = 0;
+    return range | ++last;
+}
 
 void Chunk::initChunk()
 {
     this->code = {};
+    this->lines = {};
     this->constants.initValueVector();
+    this->verified = false;
+    this->revision = nextRevision();
+    this->sharedGlobals = false;
 }
 
 void Chunk::writeChunk(Opcode byte, int line)
 {
     this->lines.push_back(line);
     this->code.push_back(byte);
+    this->verified = false;
+    this->revision = nextRevision();
 }
 
 void Chunk::freeChunk()
 {
     this->code.clear();
+    this->lines.clear();
     this->constants.freeValueVector();
+    this->verified = false;
+    this->revision = nextRevision();
+    this->sharedGlobals = false;
 }
 
 int Chunk::addConstant(Value value)
 {
-    this->constants.ValueVector.push_back(value);
+    this->constants.ValueVector.push_back(std::move(value));
+    this->verified = false;
+    this->revision = nextRevision();
     return constants.ValueVector.size() - 1;
 }
 
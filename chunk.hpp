@@ -4,11 +4,20 @@
 #include "opcode.hpp"
 #include "valuearray.hpp"
 
+// operands take a whole code slot , so the constant pool is only capped to keep indices sane
+const int MAX_CONSTANTS = 1 << 24;
+
+uint64_t nextRevision(); //never the same twice , from any thread
+
 class Chunk {
 public:
     std::vector <Opcode> code; //vector of bytecode
     std::vector <int> lines; //we store lines in this , line number of where the opcode was passed into it
     valueArray constants; //vector of constants
+    bool verified = false; //passed verifyChunk , see verifier.hpp. writing code or constants clears it
+    size_t maxStack = 0;   //deepest the stack gets running it , once verified
+    bool sharedGlobals = false; //verified as well without trusting a global's type , see VM::share()
+    uint64_t revision = nextRevision(); //a new one whenever the chunk is written , keys VM::jitCache
 
     void initChunk();
     void writeChunk(Opcode byte, int line);
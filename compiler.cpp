@@ -5,19 +5,37 @@
 #include "chunk.hpp"
 #include "parser.hpp"
 #include "value.hpp"
+#include "typeinfer.hpp"
+#include "ir.hpp"
+#include "timing.hpp"
+#include "verifier.hpp"
+#include "arena.hpp"
+#include "array.hpp"
 #include <cstdlib>
-
-// Globals for the compiler state
-Scanner scanner;
-Parser parser;
-bool hadError;
-bool panicMode;
-Chunk* currentChunk;
-
+#include <charconv>
+
+// Globals for the compiler state , one set per thread so the server can compile concurrently
+thread_local Scanner scanner;
+thread_local Parser parser;
+thread_local bool hadError;
+thread_local bool panicMode;
+thread_local Chunk* currentChunk;
+thread_local std::ostream* errorOutput;
+// scanning is interleaved with parsing , so while the timeline is on advance() times it token by token
+thread_local bool timingScan;
+thread_local uint64_t scanTime;
+thread_local uint64_t scanTokens;
+// compile temporaries (the pending stack , the identifier table) live in the arena and go in one
+// release() once parsing is done. memory counts what each phase allocated
+thread_local Arena arena;
+thread_local CompileMemory memory;
+
+void frontEnd();
+void reserveChunk(Chunk* chunk, std::string_view source);
 void advance();
-void error(std::string message);
-void consume(TokenType type, std::string message);
-void throwError(Token* token, std::string message);
+void error(std::string_view message);
+void consume(TokenType type, const char* message);
+void throwError(Token* token, std::string_view message);
 void emitByte(Opcode opcode);
 void endCompiler();
 void emitBytes(Opcode byte1, Opcode byte2);
@@ -26,6 +44,8 @@ void statement();
 void declaration();
 void varDeclaration();
 void printStatement();
+void yieldStatement();
+void importStatement();
 void expressionStatement();
 void parsePrecedence(Precedence precedence);
 ParseRule* getRule(TokenType type);
@@ -33,14 +53,18 @@ void number(bool canAssign);
 void grouping(bool canAssign);
 void unary(bool canAssign);
 void binary(bool canAssign);
+void emitUnary(TokenType operatorType);
+void emitBinary(TokenType operatorType);
 void literal(bool canAssign);
 void variable(bool canAssign);
+void arrayLiteral(bool canAssign);
+void builtinCall();
 void emitConstant(Value value);
 int makeConstant(Value value);
 int identifierConstant(Token* name);
 void namedVariable(Token name, bool canAssign);
 bool match(TokenType type);
-int parseVariable(std::string errorMessage);
+int parseVariable(const char* errorMessage);
 void defineVariable(int global);
 void synchronize();
 
@@ -49,6 +73,8 @@ ParseRule rules[] = {
     [static_cast<int>(TokenType::TOKEN_RIGHT_PAREN)]   = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_LEFT_BRACE)]    = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_RIGHT_BRACE)]   = {NULL,     NULL,   Precedence::PREC_NONE},
+    [static_cast<int>(TokenType::TOKEN_LEFT_BRACKET)]  = {arrayLiteral, NULL, Precedence::PREC_NONE},
+    [static_cast<int>(TokenType::TOKEN_RIGHT_BRACKET)] = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_COMMA)]         = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_DOT)]           = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_MINUS)]         = {unary,    binary, Precedence::PREC_TERM},
@@ -56,7 +82,7 @@ ParseRule rules[] = {
     [static_cast<int>(TokenType::TOKEN_SEMICOLON)]     = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_SLASH)]         = {NULL,     binary, Precedence::PREC_FACTOR},
     [static_cast<int>(TokenType::TOKEN_STAR)]          = {NULL,     binary, Precedence::PREC_FACTOR},
-    [static_cast<int>(TokenType::TOKEN_BANG)]          = {unary,    NULL,   Precedence::PREC_UNARY},
+    [static_cast<int>(TokenType::TOKEN_BANG)]          = {unary,    NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_BANG_EQUAL)]    = {NULL,     binary, Precedence::PREC_EQUALITY},
     [static_cast<int>(TokenType::TOKEN_EQUAL)]         = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_EQUAL_EQUAL)]   = {NULL,     binary, Precedence::PREC_EQUALITY},
@@ -83,46 +109,98 @@ ParseRule rules[] = {
     [static_cast<int>(TokenType::TOKEN_TRUE)]          = {literal,  NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_VAR)]           = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_WHILE)]         = {NULL,     NULL,   Precedence::PREC_NONE},
+    [static_cast<int>(TokenType::TOKEN_YIELD)]         = {NULL,     NULL,   Precedence::PREC_NONE},
+    [static_cast<int>(TokenType::TOKEN_IMPORT)]        = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_ERROR)]         = {NULL,     NULL,   Precedence::PREC_NONE},
     [static_cast<int>(TokenType::TOKEN_EOF)]           = {NULL,     NULL,   Precedence::PREC_NONE},
 };
 
-bool compile(std::string source, Chunk* chunk) {
-    scanner.initScanner(source);
+bool compile(std::string_view source, Chunk* chunk, int optimizationLevel, std::ostream* errors, bool sharedGlobals,
+             int firstLine) {
+    PhaseTimer phase("compile");
+    errorOutput = errors != nullptr ? errors : &std::cerr;
+    scanner.initScanner(source, firstLine);
     currentChunk = chunk;
     hadError = false;
     panicMode = false;
-    advance();
-
-    while (!match(TokenType::TOKEN_EOF)) {
-        declaration();
+    timingScan = timeline.enabled.load(std::memory_order_relaxed);
+    scanTime = 0;
+    scanTokens = 0;
+    memory = CompileMemory();
+    reserveChunk(chunk, source);
+    uint64_t parseStart = timingScan ? timeline.now() : 0;
+    frontEnd();
+    memory.arenaBytes = arena.reserved();
+    arena.release(); //everything the front end kept in it , in one go
+    if (timingScan) {
+        uint64_t parseTime = timeline.now() - parseStart - scanTime;
+        PhaseTimer::add("scan", parseStart, scanTime,
+                        {{"tokens", scanTokens}, {"sourceBytes", source.size()},
+                         {"allocBytes", memory.scan.bytes}, {"allocs", memory.scan.allocations}});
+        PhaseTimer::add("parse/emit", parseStart + scanTime, parseTime,
+                        {{"bytes", chunk->code.size()}, {"constants", chunk->constants.ValueVector.size()},
+                         {"parseAllocBytes", memory.parse.bytes}, {"parseAllocs", memory.parse.allocations},
+                         {"emitAllocBytes", memory.emit.bytes}, {"emitAllocs", memory.emit.allocations},
+                         {"arenaBytes", memory.arenaBytes}});
     }
-
-    endCompiler();
+    if (!hadError && optimizationLevel >= 2) {
+        PhaseTimer optimize("optimize");
+        optimizeChunk(chunk);
+        optimize.count("bytes", chunk->code.size());
+    }
+    if (!hadError && optimizationLevel >= 1) {
+        PhaseTimer types("typeinfer");
+        inferTypes(chunk, sharedGlobals);
+    }
+    if (!hadError) {
+        Verification verification;
+        if (!verifyChunk(chunk, &verification, sharedGlobals)) { //a compiler bug , not the script's fault
+            size_t at = static_cast<size_t>(verification.offset);
+            *errorOutput << "Line " << (at < chunk->lines.size() ? chunk->lines[at] : 0)
+                         << ": internal error , emitted bad bytecode: " << verification.message << "\n";
+            hadError = true;
+        }
+    }
+    phase.count("tokens", scanTokens);
+    phase.count("bytes", chunk->code.size());
+    phase.count("constants", chunk->constants.ValueVector.size());
     return !hadError;
 }
 
+const CompileMemory& lastCompileMemory() {
+    return memory;
+}
+
 void advance() {
     parser.previous = parser.current;
+    arena.charge = &memory.scan;
     while (true) {
-        parser.current = scanner.scanToken();
+        if (timingScan) {
+            uint64_t start = timeline.now();
+            parser.current = scanner.scanToken();
+            scanTime += timeline.now() - start;
+            scanTokens++;
+        } else {
+            parser.current = scanner.scanToken();
+        }
         if (parser.current.type != TokenType::TOKEN_ERROR) break;
         error(parser.current.lexeme);
     }
+    arena.charge = &memory.parse;
 }
 
-void error(std::string message) {
+void error(std::string_view message) {
     if (panicMode) return;
     panicMode = true;
     throwError(&parser.current, message);
 }
 
-void throwError(Token* token, std::string message) {
-    std::cerr << "Line " << token->line << ": " << message << std::endl;
+void throwError(Token* token, std::string_view message) {
+    *errorOutput << "Line " << token->line << ": " << message << std::endl;
     hadError = true;
 }
 
-void consume(TokenType type, std::string message) {
+void consume(TokenType type, const char* message) {
     if (parser.current.type == type) {
         advance();
         return;
@@ -159,7 +237,7 @@ void varDeclaration() {
     defineVariable(global);
 }
 
-int parseVariable(std::string errorMessage) {
+int parseVariable(const char* errorMessage) {
     consume(TokenType::TOKEN_IDENTIFIER, errorMessage);
     return identifierConstant(&parser.previous);
 }
@@ -181,6 +259,7 @@ void synchronize() {
             case TokenType::TOKEN_WHILE:
             case TokenType::TOKEN_PRINT:
             case TokenType::TOKEN_RETURN:
+            case TokenType::TOKEN_IMPORT:
                 return;
             default:
                 break;
@@ -192,6 +271,10 @@ void synchronize() {
 void statement() {
     if (match(TokenType::TOKEN_PRINT)) {
         printStatement();
+    } else if (match(TokenType::TOKEN_YIELD)) {
+        yieldStatement();
+    } else if (match(TokenType::TOKEN_IMPORT)) {
+        importStatement();
     } else {
         expressionStatement();
     }
@@ -203,14 +286,44 @@ void printStatement() {
     emitByte(Opcode::OP_PRINT);
 }
 
+void yieldStatement() {
+    consume(TokenType::TOKEN_SEMICOLON, "Expect ';' after 'yield'.");
+    emitByte(Opcode::OP_YIELD);
+}
+
+// import "name"; , the module itself is found and compiled by Modules::load , see modules.hpp
+void importStatement() {
+    consume(TokenType::TOKEN_STRING, "Expect module name string after 'import'.");
+    Token name = parser.previous;
+    name.lexeme = name.lexeme.substr(1, name.lexeme.size() - 2); //without the quotes
+    if (name.lexeme.empty()) {
+        error("Expect a module name.");
+    }
+    int module = identifierConstant(&name);
+    consume(TokenType::TOKEN_SEMICOLON, "Expect ';' after import.");
+    emitBytes(Opcode::OP_IMPORT, static_cast<Opcode>(module));
+}
+
 void expressionStatement() {
     expression();
     consume(TokenType::TOKEN_SEMICOLON, "Expect ';' after expression.");
     emitByte(Opcode::OP_POP);
 }
 
+// the chunk outlives the compile so it isn't in the arena , its growth is counted here instead
+static void countGrowth(size_t capacity, size_t grown, size_t element) {
+    if (grown != capacity) {
+        memory.emit.bytes += grown * element;
+        memory.emit.allocations++;
+    }
+}
+
 void emitByte(Opcode opcode) {
-    currentChunk->writeChunk(opcode, parser.current.line);
+    size_t codeCapacity = currentChunk->code.capacity();
+    size_t linesCapacity = currentChunk->lines.capacity();
+    currentChunk->writeChunk(opcode, parser.previous.line);
+    countGrowth(codeCapacity, currentChunk->code.capacity(), sizeof(Opcode));
+    countGrowth(linesCapacity, currentChunk->lines.capacity(), sizeof(int));
 }
 
 void endCompiler() {
@@ -222,49 +335,190 @@ void emitBytes(Opcode byte1, Opcode byte2) {
     emitByte(byte2);
 }
 
-void expression() {
-    parsePrecedence(Precedence::PREC_ASSIGNMENT);
-}
+// ------ EXPRESSIONS ------
+
+// expressions are parsed without recursion. a rule that needs a sub-expression pushes the rest of
+// its work (the operator to emit , the ')' to close) and the sub-expression onto pending and
+// returns , expression() runs pending until it's back where it started. the work happens in the
+// same order as the recursive Pratt parser did it , relative to every advance() , so the bytecode
+// and line numbers come out the same. operands go straight into the chunk , the VM stack is the
+// operand stack , so pending only ever holds operators.
+enum class PendingKind {
+    PRECEDENCE,  //parse an operand and every infix operator binding at least as tight as precedence
+    INFIX,       //the infix loop of a PRECEDENCE whose operand has been parsed
+    EMIT_UNARY,
+    EMIT_BINARY,
+    CLOSE_GROUP,
+    EMIT_SET,
+    ARRAY_ELEMENT,  //append the element just parsed , then the next one or the ']'
+    CALL_ARGUMENT,  //an argument of builtin was parsed , then the next one or the ')'
+};
 
-void parsePrecedence(Precedence precedence) {
+struct Pending {
+    PendingKind kind;
+    Precedence precedence;
+    bool canAssign;
+    TokenType operatorType;
+    int constant;            //EMIT_SET , arguments parsed so far for CALL_ARGUMENT
+    const Builtin* builtin;  //CALL_ARGUMENT
+};
+
+using PendingStack = std::vector<Pending, ArenaAllocator<Pending>>;
+// identifier -> its constant , so a name used on every line is one constant and one string.
+// keyed by lexemes , which point into the source
+using NameTable = std::unordered_map<std::string_view, int, std::hash<std::string_view>, std::equal_to<std::string_view>,
+                                     ArenaAllocator<std::pair<const std::string_view, int>>>;
+
+// both only exist while frontEnd() runs
+thread_local PendingStack* pending;
+thread_local NameTable* names;
+
+void frontEnd() {
+    PendingStack pendingStack{ArenaAllocator<Pending>(&arena)};
+    pendingStack.reserve(64);
+    NameTable nameTable(64, std::hash<std::string_view>(), std::equal_to<std::string_view>(),
+                        ArenaAllocator<std::pair<const std::string_view, int>>(&arena));
+    pending = &pendingStack;
+    names = &nameTable;
+    arena.charge = &memory.parse;
     advance();
-    ParseFn prefixRule = getRule(parser.previous.type)->prefix;
-    if (prefixRule == NULL) {
-        error("Expect expression.");
-        return;
+
+    while (!match(TokenType::TOKEN_EOF)) {
+        declaration();
     }
-    bool canAssign = precedence <= Precedence::PREC_ASSIGNMENT;
-    prefixRule(canAssign);
 
-    while (precedence <= getRule(parser.current.type)->precedence) {
-        advance();
-        ParseFn infixRule = getRule(parser.previous.type)->infix;
-        infixRule(canAssign);
+    endCompiler();
+    // the pool was sized for every name being new , give back what interning saved
+    std::vector<Value>& constants = currentChunk->constants.ValueVector;
+    if (constants.capacity() > 2 * constants.size() + 64) {
+        constants.shrink_to_fit();
+        countGrowth(0, constants.capacity(), sizeof(Value));
     }
+    pending = nullptr;
+    names = nullptr;
+    arena.charge = nullptr;
+}
 
-    if (canAssign && match(TokenType::TOKEN_EQUAL)) {
-        error("Invalid assignment target.");
+void pushPending(PendingKind kind, Precedence precedence = Precedence::PREC_NONE, bool canAssign = false,
+                 TokenType operatorType = TokenType::TOKEN_EOF, int constant = 0, const Builtin* builtin = nullptr) {
+    pending->push_back(Pending{kind, precedence, canAssign, operatorType, constant, builtin});
+}
+
+void expression() {
+    PendingStack& pending = *::pending; //one thread_local lookup , not one per step
+    size_t base = pending.size();
+    parsePrecedence(Precedence::PREC_ASSIGNMENT);
+    while (pending.size() > base) {
+        Pending work = pending.back();
+        switch (work.kind) {
+            case PendingKind::PRECEDENCE: {
+                advance();
+                ParseFn prefixRule = getRule(parser.previous.type)->prefix;
+                if (prefixRule == NULL) {
+                    pending.pop_back();
+                    error("Expect expression.");
+                    break;
+                }
+                bool canAssign = work.precedence <= Precedence::PREC_ASSIGNMENT;
+                pending.back().kind = PendingKind::INFIX; //the operand comes first , then its infix loop
+                pending.back().canAssign = canAssign;
+                prefixRule(canAssign);
+                break;
+            }
+            case PendingKind::INFIX:
+                if (work.precedence <= getRule(parser.current.type)->precedence) {
+                    advance(); //stays pending , the loop goes on once the right operand is done
+                    getRule(parser.previous.type)->infix(work.canAssign);
+                    break;
+                }
+                pending.pop_back();
+                if (work.canAssign && match(TokenType::TOKEN_EQUAL)) {
+                    error("Invalid assignment target.");
+                }
+                break;
+            case PendingKind::EMIT_UNARY:
+                pending.pop_back();
+                emitUnary(work.operatorType);
+                break;
+            case PendingKind::EMIT_BINARY:
+                pending.pop_back();
+                emitBinary(work.operatorType);
+                break;
+            case PendingKind::CLOSE_GROUP:
+                pending.pop_back();
+                consume(TokenType::TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+                break;
+            case PendingKind::EMIT_SET:
+                pending.pop_back();
+                emitBytes(Opcode::OP_SET_GLOBAL, static_cast<Opcode>(work.constant));
+                break;
+            case PendingKind::ARRAY_ELEMENT:
+                pending.pop_back();
+                emitByte(Opcode::OP_APPEND);
+                if (match(TokenType::TOKEN_COMMA)) {
+                    pushPending(PendingKind::ARRAY_ELEMENT);
+                    parsePrecedence(Precedence::PREC_ASSIGNMENT);
+                    break;
+                }
+                consume(TokenType::TOKEN_RIGHT_BRACKET, "Expect ']' after array elements.");
+                break;
+            case PendingKind::CALL_ARGUMENT:
+                pending.pop_back();
+                if (work.constant < work.builtin->arity) {
+                    consume(TokenType::TOKEN_COMMA, "Expect ',' between arguments.");
+                    pushPending(PendingKind::CALL_ARGUMENT, Precedence::PREC_NONE, false, TokenType::TOKEN_EOF,
+                                work.constant + 1, work.builtin);
+                    parsePrecedence(Precedence::PREC_ASSIGNMENT);
+                    break;
+                }
+                consume(TokenType::TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+                emitByte(work.builtin->opcode);
+                break;
+        }
     }
 }
 
+// schedules an operand at precedence or tighter , run by expression()
+void parsePrecedence(Precedence precedence) {
+    pushPending(PendingKind::PRECEDENCE, precedence);
+}
+
 ParseRule* getRule(TokenType type) {
     return &rules[static_cast<int>(type)];
 }
 
+// digits alone are an INTEGER , with a fraction a NUMBER. an integer literal too big for 64 bits
+// becomes the nearest double , the same thing arithmetic does when it overflows
 void number(bool) {
-    double value = std::stod(parser.previous.lexeme);
+    std::string_view lexeme = parser.previous.lexeme;
+    const char* first = lexeme.data();
+    const char* last = first + lexeme.size();
+    if (lexeme.find('.') == std::string_view::npos) {
+        int64_t integer = 0;
+        if (std::from_chars(first, last, integer).ec == std::errc()) {
+            emitConstant(Value(integer));
+            return;
+        }
+    }
+    double value = 0;
+    if (std::from_chars(first, last, value).ec == std::errc::result_out_of_range) {
+        //from_chars leaves value alone then , strtod gives HUGE_VAL (or 0 for a fraction too small)
+        value = std::strtod(std::string(lexeme).c_str(), nullptr);
+    }
     emitConstant(Value(value));
 }
 
 void grouping(bool) {
-    expression();
-    consume(TokenType::TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+    pushPending(PendingKind::CLOSE_GROUP);
+    parsePrecedence(Precedence::PREC_ASSIGNMENT);
 }
 
 void unary(bool) {
-    TokenType operatorType = parser.previous.type;
+    pushPending(PendingKind::EMIT_UNARY, Precedence::PREC_NONE, false, parser.previous.type);
     parsePrecedence(Precedence::PREC_UNARY);
+}
 
+void emitUnary(TokenType operatorType) {
     switch (operatorType) {
         case TokenType::TOKEN_MINUS:
             emitByte(Opcode::OP_NEGATE);
@@ -280,8 +534,11 @@ void unary(bool) {
 void binary(bool) {
     TokenType operatorType = parser.previous.type;
     ParseRule* rule = getRule(operatorType);
+    pushPending(PendingKind::EMIT_BINARY, Precedence::PREC_NONE, false, operatorType);
     parsePrecedence(static_cast<Precedence>(static_cast<int>(rule->precedence) + 1));
+}
 
+void emitBinary(TokenType operatorType) {
     switch (operatorType) {
         case TokenType::TOKEN_PLUS:
             emitByte(Opcode::OP_ADD);
@@ -337,22 +594,57 @@ void literal(bool) {
 // ------ IDENTIFIER AND VARIABLE HANDLING ------
 
 void variable(bool canAssign) {
+    if (parser.current.type == TokenType::TOKEN_LEFT_PAREN) {
+        builtinCall();
+        return;
+    }
     namedVariable(parser.previous, canAssign);
 }
 
+// a name followed by '(' , only the array builtins exist so far (see array.hpp)
+void builtinCall() {
+    const Builtin* builtin = findBuiltin(parser.previous.lexeme);
+    if (builtin == nullptr) {
+        error("Unknown function.");
+        return;
+    }
+    advance(); //the '('
+    pushPending(PendingKind::CALL_ARGUMENT, Precedence::PREC_NONE, false, TokenType::TOKEN_EOF, 1, builtin);
+    parsePrecedence(Precedence::PREC_ASSIGNMENT);
+}
+
+// [a , b , c] is OP_ARRAY and then an OP_APPEND after each element
+void arrayLiteral(bool) {
+    emitByte(Opcode::OP_ARRAY);
+    if (match(TokenType::TOKEN_RIGHT_BRACKET)) return;
+    pushPending(PendingKind::ARRAY_ELEMENT);
+    parsePrecedence(Precedence::PREC_ASSIGNMENT);
+}
+
 void namedVariable(Token name, bool canAssign) {
     int arg = identifierConstant(&name);
 
     if (canAssign && match(TokenType::TOKEN_EQUAL)) {
-        expression();
-        emitBytes(Opcode::OP_SET_GLOBAL, static_cast<Opcode>(arg));
+        pushPending(PendingKind::EMIT_SET, Precedence::PREC_NONE, false, TokenType::TOKEN_EOF, arg);
+        parsePrecedence(Precedence::PREC_ASSIGNMENT);
     } else {
         emitBytes(Opcode::OP_GET_GLOBAL, static_cast<Opcode>(arg));
     }
 }
 
 int identifierConstant(Token* name) {
-    return makeConstant(Value(name->lexeme));
+    auto found = names->find(name->lexeme);
+    if (found != names->end()) return found->second;
+    int constant = makeConstant(Value(std::string(name->lexeme)));
+    const std::string& stored = *currentChunk->constants.ValueVector.back().data.string;
+    memory.emit.bytes += sizeof(std::string);
+    memory.emit.allocations++;
+    if (stored.capacity() > std::string().capacity()) { //longer than the small string buffer
+        memory.emit.bytes += stored.capacity() + 1;
+        memory.emit.allocations++;
+    }
+    names->emplace(name->lexeme, constant);
+    return constant;
 }
 
 void emitConstant(Value value) {
@@ -360,10 +652,48 @@ void emitConstant(Value value) {
 }
 
 int makeConstant(Value value) {
-    int constant = currentChunk->addConstant(value);
-    if (constant > 255) {
+    size_t capacity = currentChunk->constants.ValueVector.capacity();
+    int constant = currentChunk->addConstant(std::move(value));
+    countGrowth(capacity, currentChunk->constants.ValueVector.capacity(), sizeof(Value));
+    if (constant >= MAX_CONSTANTS) {
         error("Too many constants in one chunk.");
         return 0;
     }
     return constant;
+}
+// one pass over the characters , no tokens , to size the chunk once instead of letting it double
+// its way up. a name or a number is at most two code slots (a load with its operand) and an
+// operator character at most one , so this overshoots by the keywords , '=' and declarations.
+// the pool gets room for every number and every name , frontEnd() trims it once names are interned
+void reserveChunk(Chunk* chunk, std::string_view source) {
+    size_t words = 0, operators = 0;
+    const char* at = source.data();
+    const char* end = at + source.size();
+    while (at < end) {
+        char c = *at;
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
+            words++;
+            while (at < end && (std::isalnum(static_cast<unsigned char>(*at)) || *at == '_' || *at == '.')) at++;
+            continue;
+        }
+        switch (c) {
+            case '+': case '-': case '*': case '/': case '!': case '<': case '>': case '=': case ';':
+            case '[': case ']': case ',':
+                operators++;
+                break;
+        }
+        at++;
+    }
+    size_t code = chunk->code.size() + 2 * words + operators + 1; //+1 , OP_RETURN
+    std::vector<Value>& constants = chunk->constants.ValueVector;
+    size_t codeCapacity = chunk->code.capacity();
+    size_t linesCapacity = chunk->lines.capacity();
+    size_t constantsCapacity = constants.capacity();
+    chunk->code.reserve(code);
+    chunk->lines.reserve(code);
+    constants.reserve(constants.size() + words);
+    countGrowth(codeCapacity, chunk->code.capacity(), sizeof(Opcode));
+    countGrowth(linesCapacity, chunk->lines.capacity(), sizeof(int));
+    countGrowth(constantsCapacity, constants.capacity(), sizeof(Value));
+    memory.estimatedCode = code;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "common.hpp"
 #include "tokentype.hpp"
+#include "arena.hpp"
 
 class Chunk;
 
@@ -26,4 +27,24 @@ struct ParseRule {
     Precedence precedence;
 };
 
-bool compile(std::string source, Chunk* chunk);
\ No newline at end of file
+// optimizationLevel : 0 = plain bytecode , 1 = type specialization , 2 = IR optimizations + type specialization
+// errors : where "Line N: message" diagnostics go , std::cerr when null
+// sharedGlobals : for a VM on a SharedGlobals store , see VM::share()
+// firstLine : the line source starts on , for a piece of a bigger file (see stream.hpp)
+// source isn't copied , the byte after it is read like Scanner::initScanner says
+bool compile(std::string_view source, Chunk* chunk, int optimizationLevel = 1, std::ostream* errors = nullptr,
+             bool sharedGlobals = false, int firstLine = 1);
+
+// what the last compile() on this thread allocated , by phase. scan and parse are temporaries taken
+// from the compiler's arena (tokens point into the source , so scanning takes nothing) , emit is the
+// chunk itself : code and line table growth , the constant pool and the strings of its names.
+// optimize and typeinfer aren't counted. --timings shows it with the phases
+struct CompileMemory {
+    MemoryCount scan;
+    MemoryCount parse;
+    MemoryCount emit;
+    size_t arenaBytes = 0;    //the arena's blocks at the end of parsing , released right after
+    size_t estimatedCode = 0; //code slots the pre-pass reserved , to compare with what was emitted
+};
+
+const CompileMemory& lastCompileMemory();
\ No newline at end of file
@@ -2,24 +2,50 @@
 #include "chunk.hpp"
 #include "debug.hpp"
 
-void disassembleChunk(Chunk chunk, std::string name)
+std::string getString(Opcode opcode); //vm.cpp
+
+void disassembleChunk(const Chunk& chunk, const std::string& name, std::ostream& out)
+{
+    out << "== " << name << " ==" << std::endl;
+    for (size_t offset = 0; offset < chunk.code.size();) {
+        offset = disassembleInstruction(chunk, offset, out);
+    }
+}
+
+size_t disassembleInstruction(const Chunk& chunk, size_t offset, std::ostream& out)
+{
+    return disassembleInstruction(chunk, offset, chunk.code[offset], out);
+}
+
+size_t disassembleInstruction(const Chunk& chunk, size_t offset, Opcode opcode, std::ostream& out)
 {
-    std::cout << name << std::endl;
-    std::vector <Opcode> instructions = chunk.getCode();
-    for (int i = 0; i < instructions.size(); i++) {
-        std::cout << std::setfill('0') << std::setw(4) << i << "    ";
-        switch (instructions[i]) {
-            case Opcode::OP_RETURN:
-                std::cout << "OP_RETURN" << std::endl;
-                break;  //break statements are needed after cases!!!
-            case Opcode::OP_CONSTANT:
-            {
-                //constantIndex is the index of the constant stores in the chunk.constants array
-                int constantIndex = static_cast<int>(instructions[i + 1]);
-                std::cout << "OP_CONSTANT" << " " << chunk.constants.ValueVector[constantIndex].getDouble() << std::endl;
-                i++; //as op_constant is a 2 byte OPCODE
-                break;  // FIX: Add break statement!
-            }
-        }
+    out << std::setfill('0') << std::setw(4) << offset << std::setfill(' ') << " ";
+    if (offset > 0 && offset < chunk.lines.size() && chunk.lines[offset] == chunk.lines[offset - 1]) {
+        out << "   | ";
+    } else {
+        out << std::setw(4) << (offset < chunk.lines.size() ? chunk.lines[offset] : 0) << " ";
+    }
+    if (opcodeLength(opcode) == 1) {
+        out << getString(opcode) << std::endl;
+        return offset + 1;
+    }
+
+    //two slot instructions : the operand is an index into the constant pool
+    out << std::left << std::setw(16) << getString(opcode) << std::right;
+    if (offset + 1 >= chunk.code.size()) {
+        out << " <missing operand>" << std::endl;
+        return chunk.code.size();
+    }
+    int constant = static_cast<int>(chunk.code[offset + 1]);
+    out << " " << std::setw(4) << constant;
+    if (constant >= 0 && static_cast<size_t>(constant) < chunk.constants.ValueVector.size()) {
+        Value value = chunk.constants.ValueVector[constant];
+        out << " '";
+        value.printValue(out);
+        out << "'";
+    } else {
+        out << " <bad constant>";
     }
+    out << std::endl;
+    return offset + 2;
 }
\ No newline at end of file
@@ -2,4 +2,10 @@
 #include "common.hpp"
 #include "chunk.hpp"
 
-void disassembleChunk(Chunk chunk, std::string name);
\ No newline at end of file
+// every instruction of chunk , one per line : offset , source line ("|" when it's the same as the
+// one above) , opcode , and for two slot instructions the operand and the constant it names
+void disassembleChunk(const Chunk& chunk, const std::string& name, std::ostream& out = std::cout);
+// the instruction at offset , returns where the next one starts
+size_t disassembleInstruction(const Chunk& chunk, size_t offset, std::ostream& out = std::cout);
+// the same with opcode shown in place of the one in the code , for a chunk with traps patched in
+size_t disassembleInstruction(const Chunk& chunk, size_t offset, Opcode opcode, std::ostream& out);
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "debugger.hpp"
+#include "debug.hpp"
+#include "value.hpp"
+#include "verifier.hpp"
+#include "vm.hpp"
+
+bool Debugger::attach(VM* vm, const Chunk& chunk, std::string& error) {
+    this->chunk = chunk;
+    this->saved.clear();
+    this->breakpoints.clear();
+    this->stepTrap = SIZE_MAX;
+    this->done = false;
+    Verification verification;
+    if (!this->chunk.verified && !verifyChunk(&this->chunk, &verification)) { //a trap would fail it later
+        error = "Invalid bytecode: " + verification.message + " at offset " + std::to_string(verification.offset);
+        return false;
+    }
+    this->vm = vm;
+    vm->start(&this->chunk);
+    return true;
+}
+
+// ------ TRAPS ------
+
+Opcode Debugger::original(size_t offset) const {
+    auto found = this->saved.find(offset);
+    return found == this->saved.end() ? this->chunk.code[offset] : found->second;
+}
+
+void Debugger::patch(size_t offset) {
+    if (this->saved.count(offset) == 0) {
+        this->saved[offset] = this->chunk.code[offset];
+        this->chunk.code[offset] = Opcode::OP_BREAK;
+        this->chunk.revision = nextRevision(); //written in place , JIT code for it is stale
+    }
+}
+
+void Debugger::unpatch(size_t offset) {
+    auto found = this->saved.find(offset);
+    if (found != this->saved.end()) {
+        this->chunk.code[offset] = found->second;
+        this->saved.erase(found);
+        this->chunk.revision = nextRevision();
+    }
+}
+
+bool Debugger::isBreakpoint(size_t offset) const {
+    for (auto& breakpoint : this->breakpoints) {
+        if (breakpoint.second == offset) return true;
+    }
+    return false;
+}
+
+size_t Debugger::firstOnLine(int line) const {
+    const std::vector<Opcode>& code = this->chunk.code;
+    size_t next = code.size(); //first instruction of the closest line after it
+    for (size_t i = 0; i < code.size(); i += opcodeLength(original(i))) {
+        if (this->chunk.lines[i] == line) return i;
+        if (this->chunk.lines[i] > line && (next == code.size() || this->chunk.lines[i] < this->chunk.lines[next])) {
+            next = i;
+        }
+    }
+    return next;
+}
+
+int Debugger::setBreakpoint(int line) {
+    size_t offset = firstOnLine(line);
+    if (offset == this->chunk.code.size()) return 0;
+    int at = this->chunk.lines[offset];
+    patch(offset); //step()'s trap may be there already , it stays
+    this->breakpoints[at] = offset;
+    return at;
+}
+
+bool Debugger::clearBreakpoint(int line) {
+    auto found = this->breakpoints.find(line);
+    if (found == this->breakpoints.end()) return false;
+    if (found->second != this->stepTrap) unpatch(found->second);
+    this->breakpoints.erase(found);
+    return true;
+}
+
+std::vector<int> Debugger::breakpointLines() const {
+    std::vector<int> lines;
+    for (auto& breakpoint : this->breakpoints) lines.push_back(breakpoint.first);
+    return lines;
+}
+
+// ------ RUNNING ------
+
+size_t Debugger::offset() const {
+    return this->vm->ip;
+}
+
+int Debugger::line() const {
+    return this->done || this->vm->ip >= this->chunk.lines.size() ? 0 : this->chunk.lines[this->vm->ip];
+}
+
+// wherever the run stopped , step()'s trap has done its job
+InterpretResult Debugger::stopped(InterpretResult result) {
+    if (this->stepTrap != SIZE_MAX) {
+        if (!isBreakpoint(this->stepTrap)) unpatch(this->stepTrap);
+        this->stepTrap = SIZE_MAX;
+    }
+    this->done = result != InterpretResult::INTERPRET_BREAK;
+    return result;
+}
+
+InterpretResult Debugger::resume() {
+    if (this->done) return InterpretResult::INTERPRET_OK;
+    InterpretResult result;
+    size_t at = this->vm->ip;
+    if (at < this->chunk.code.size() && this->chunk.code[at] == Opcode::OP_BREAK) {
+        // paused on a trap : the instruction under it runs once with the trap out of the way
+        this->chunk.code[at] = this->saved.at(at);
+        result = this->vm->run(1);
+        this->chunk.code[at] = Opcode::OP_BREAK;
+        if (result != InterpretResult::INTERPRET_YIELD) return stopped(result);
+    }
+    do {
+        result = this->vm->run();
+    } while (result == InterpretResult::INTERPRET_YIELD); //a yield statement , nobody to hand control to
+    return stopped(result);
+}
+
+InterpretResult Debugger::step() {
+    if (this->done) return InterpretResult::INTERPRET_OK;
+    size_t at = this->vm->ip;
+    const std::vector<Opcode>& code = this->chunk.code;
+    size_t next = at + opcodeLength(original(at));
+    while (next < code.size() && this->chunk.lines[next] == this->chunk.lines[at]) {
+        next += opcodeLength(original(next));
+    }
+    if (next < code.size() && this->saved.count(next) == 0) {
+        this->stepTrap = next;
+        patch(next);
+    }
+    return resume();
+}
+
+// ------ PROMPT ------
+
+void Debugger::where(std::ostream& out) const {
+    if (this->done) {
+        out << "The program has finished\n";
+        return;
+    }
+    out << "Line " << line() << ": ";
+    disassembleInstruction(this->chunk, this->vm->ip, original(this->vm->ip), out);
+}
+
+bool Debugger::command(const std::string& input, std::ostream& out) {
+    std::string text = input.empty() ? this->lastCommand : input;
+    this->lastCommand = text;
+    std::istringstream words(text);
+    std::string verb, argument;
+    words >> verb >> argument;
+
+    auto report = [&](InterpretResult result) {
+        if (result == InterpretResult::INTERPRET_BREAK) {
+            where(out);
+        } else if (result == InterpretResult::INTERPRET_OK) {
+            out << "The program has finished\n";
+        } else {
+            out << "The program stopped with an error\n"; //the VM has printed it
+        }
+    };
+    if (verb.empty()) {
+        return true;
+    } else if (verb == "b" || verb == "break") {
+        int at = setBreakpoint(std::atoi(argument.c_str()));
+        if (at == 0) out << "No code on or after line " << argument << "\n";
+        else out << "Breakpoint at line " << at << "\n";
+    } else if (verb == "d" || verb == "delete") {
+        if (!clearBreakpoint(std::atoi(argument.c_str()))) out << "No breakpoint at line " << argument << "\n";
+    } else if (verb == "i" || verb == "info") {
+        for (int at : breakpointLines()) out << "Breakpoint at line " << at << "\n";
+    } else if (verb == "c" || verb == "continue") {
+        if (this->done) out << "The program has finished\n";
+        else report(resume());
+    } else if (verb == "s" || verb == "step") {
+        if (this->done) out << "The program has finished\n";
+        else report(step());
+    } else if (verb == "p" || verb == "print") {
+        auto found = this->vm->globals.find(argument);
+        if (found == this->vm->globals.end()) found = this->vm->faultGlobal(argument);
+        if (found == this->vm->globals.end()) {
+            out << "No global '" << argument << "'\n";
+        } else {
+            out << argument << " = ";
+            found->second.printValue(out);
+            out << "\n";
+        }
+    } else if (verb == "stack") {
+        for (size_t k = this->vm->stack.size(); k-- > 0;) { //top first
+            out << "[" << k << "] ";
+            this->vm->stack[k].printValue(out);
+            out << "\n";
+        }
+    } else if (verb == "w" || verb == "where") {
+        where(out);
+    } else if (verb == "l" || verb == "list") {
+        //the instructions of the line it's paused on , or of the line asked for
+        int wanted = argument.empty() ? line() : std::atoi(argument.c_str());
+        for (size_t i = 0; i < this->chunk.code.size(); i += opcodeLength(original(i))) {
+            if (this->chunk.lines[i] != wanted) continue;
+            out << (!this->done && i == this->vm->ip ? "=> " : "   ");
+            disassembleInstruction(this->chunk, i, original(i), out);
+        }
+    } else if (verb == "q" || verb == "quit") {
+        return false;
+    } else {
+        out << "Commands : break N , delete N , info , continue , step , print name , stack , where , list [N] , quit\n";
+    }
+    return true;
+}
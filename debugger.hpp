@@ -0,0 +1,65 @@
+#pragma once
+#include "common.hpp"
+#include "chunk.hpp"
+#include "result.hpp"
+#include <map>
+
+class VM;
+
+// source level breakpoints and stepping for the stack VM , without a hook in its dispatch loop.
+// the debugger runs its own copy of the chunk and patches OP_BREAK over the first instruction of
+// every line with a breakpoint , keeping the opcode it replaced in a side table. VM::run stops on
+// the trap like on any other instruction (INTERPRET_BREAK) , and to go on the debugger puts the
+// original back for one instruction (run with a budget of 1) and patches the trap in again.
+// nothing in VM::run looks for a debugger , so code without traps runs exactly as it did.
+//
+// stepping goes by Chunk::lines : the code has no jumps , so the next line starts at the first
+// instruction after this one that has another line , and step() puts a one-off trap there. an
+// import statement is stepped over , the module's top level runs in one go.
+// limits walk the code without knowing about traps , don't set any on a VM being debugged.
+class Debugger {
+public:
+    Debugger() = default;
+    Debugger(const Debugger&) = delete; //the VM runs our chunk
+    Debugger& operator=(const Debugger&) = delete;
+
+    // copies chunk (verified first if it isn't) and loads the copy into vm , paused before its
+    // first instruction. false with the reason if it doesn't verify
+    bool attach(VM* vm, const Chunk& chunk, std::string& error);
+
+    // on the first instruction of line , or of the next line that has code. returns the line it
+    // went on , 0 if there's no code from line on
+    int setBreakpoint(int line);
+    bool clearBreakpoint(int line);
+    std::vector<int> breakpointLines() const;
+
+    // run until a breakpoint , the end or an error. INTERPRET_BREAK means paused again
+    InterpretResult resume();
+    // run to the start of the next line , or to a breakpoint or the end if that comes first
+    InterpretResult step();
+
+    bool finished() const { return this->done; }
+    size_t offset() const; //where it's paused
+    int line() const;      //the source line it's paused on , 0 once finished
+    Opcode original(size_t offset) const; //the opcode at offset , under any trap
+    const Chunk& code() const { return this->chunk; }
+
+    // one command of the --debug prompt , eg. "break 12" , "step" , "print total". false on quit
+    bool command(const std::string& line, std::ostream& out);
+
+private:
+    VM* vm = nullptr;
+    Chunk chunk;                              //the copy traps are patched into
+    std::unordered_map<size_t, Opcode> saved; //offset -> the opcode its trap replaced
+    std::map<int, size_t> breakpoints;        //line -> offset of its trap
+    size_t stepTrap = SIZE_MAX;               //step()'s one-off trap , SIZE_MAX when there's none
+    bool done = false;
+    std::string lastCommand;                  //an empty line repeats it
+
+    size_t firstOnLine(int line) const;       //code.size() if no line from there on has code
+    bool isBreakpoint(size_t offset) const;
+    void patch(size_t offset);
+    void unpatch(size_t offset);
+    InterpretResult stopped(InterpretResult result);
+    void where(std::ostream& out) const;
+};
@@ -0,0 +1,116 @@
+#include "globals.hpp"
+
+SharedGlobals::SharedGlobals() : table(new Table()) {}
+
+SharedGlobals::~SharedGlobals() {
+    for (Retired& old : this->retired) {
+        delete old.box;
+        delete old.table;
+    }
+    for (Slot& slot : this->slots) {
+        delete slot.box.load(std::memory_order_relaxed);
+    }
+    delete this->table.load(std::memory_order_relaxed);
+}
+
+// ------ READERS ------
+
+SharedGlobals::Reader* SharedGlobals::attach() {
+    std::lock_guard<std::mutex> lock(this->writer);
+    this->readers.push_back(new Reader());
+    return this->readers.back();
+}
+
+void SharedGlobals::detach(Reader* reader) {
+    std::lock_guard<std::mutex> lock(this->writer);
+    this->readers.erase(std::find(this->readers.begin(), this->readers.end(), reader));
+    delete reader;
+    reclaim(); //it may have been the one holding things back
+}
+
+// the epoch store , the loads in get() , the writers' swaps and their scan of the readers are all
+// seq_cst : a writer scanning the readers either sees this epoch or has its swap seen by our loads.
+// on x86 only the store costs anything (an xchg) , the loads are plain moves
+void SharedGlobals::enter(Reader* reader) {
+    reader->epoch.store(this->epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+}
+
+void SharedGlobals::leave(Reader* reader) {
+    reader->epoch.store(0, std::memory_order_release); //after every load of the section
+}
+
+bool SharedGlobals::get(const std::string& name, Value& value) const {
+    const Table* names = this->table.load(std::memory_order_seq_cst);
+    auto found = names->find(name);
+    if (found == names->end()) {
+        return false;
+    }
+    value = found->second->box.load(std::memory_order_seq_cst)->value;
+    return true;
+}
+
+// ------ WRITERS ------
+
+void SharedGlobals::define(const std::string& name, const Value& value) {
+    std::lock_guard<std::mutex> lock(this->writer);
+    const Table* names = this->table.load(std::memory_order_relaxed);
+    auto found = names->find(name);
+    if (found != names->end()) {
+        retire(found->second->box.exchange(new Box{value}, std::memory_order_seq_cst), nullptr);
+        return;
+    }
+    this->slots.emplace_back();
+    Slot* slot = &this->slots.back();
+    slot->box.store(new Box{value}, std::memory_order_relaxed);
+    Table* grown = new Table(*names); //published before anyone can find the slot
+    (*grown)[name] = slot;
+    retire(nullptr, this->table.exchange(grown, std::memory_order_seq_cst));
+}
+
+bool SharedGlobals::set(const std::string& name, const Value& value) {
+    std::lock_guard<std::mutex> lock(this->writer);
+    const Table* names = this->table.load(std::memory_order_relaxed);
+    auto found = names->find(name);
+    if (found == names->end()) {
+        return false;
+    }
+    retire(found->second->box.exchange(new Box{value}, std::memory_order_seq_cst), nullptr);
+    return true;
+}
+
+std::unordered_map<std::string, Value> SharedGlobals::copy() const {
+    std::lock_guard<std::mutex> lock(this->writer); //nothing is freed while we hold it
+    std::unordered_map<std::string, Value> globals;
+    for (auto& entry : *this->table.load(std::memory_order_relaxed)) {
+        globals.emplace(entry.first, entry.second->box.load(std::memory_order_relaxed)->value);
+    }
+    return globals;
+}
+
+size_t SharedGlobals::retiredCount() const {
+    std::lock_guard<std::mutex> lock(this->writer);
+    return this->retired.size();
+}
+
+// stamped with the epoch it was replaced in , which then moves on : a reader that enters from now
+// on reads a later epoch and can only find what replaced it
+void SharedGlobals::retire(Box* box, const Table* table) {
+    this->retired.push_back({this->epoch.fetch_add(1, std::memory_order_acq_rel), box, table});
+    if (this->retired.size() >= RECLAIM_BATCH) {
+        reclaim();
+    }
+}
+
+// frees everything replaced before the oldest read section still open , the list is in epoch order
+void SharedGlobals::reclaim() {
+    uint64_t oldest = UINT64_MAX;
+    for (Reader* reader : this->readers) {
+        uint64_t entered = reader->epoch.load(std::memory_order_seq_cst);
+        if (entered != 0) oldest = std::min(oldest, entered);
+    }
+    while (!this->retired.empty() && this->retired.front().epoch < oldest) {
+        delete this->retired.front().box;
+        delete this->retired.front().table;
+        this->retired.pop_front();
+    }
+}
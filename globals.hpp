@@ -0,0 +1,89 @@
+#pragma once
+#include "common.hpp"
+#include "value.hpp"
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+// one global namespace for many VMs on many threads , eg. configuration or lookup tables loaded
+// once and read by every worker. VM::share() sends a VM's global opcodes here instead of to
+// VM::globals.
+//
+// reads take no lock and write nothing shared. the names are an immutable table published
+// through one atomic pointer and every name's value is an immutable box behind another one , a
+// read is a hash lookup and a copy. a write makes a new box and swaps it in , defining a new name
+// publishes a copy of the table , both under one writer mutex , so readers see either the old or
+// the new value and never a torn one.
+// what a write replaces is freed once every reader has been quiescent since (QSBR) : a VM is only
+// inside a read section while it's in VM::run , so a replaced box waits at most for the runs
+// that were in flight when it was replaced , never for readers to do anything.
+class SharedGlobals {
+public:
+    // one per VM reading the store , on its own cache line so readers entering and leaving don't
+    // bounce each other's
+    struct alignas(64) Reader {
+        std::atomic<uint64_t> epoch{0}; //the write epoch when it entered its read section , 0 outside one
+    };
+
+    SharedGlobals();
+    ~SharedGlobals(); //every reader has to be detached by now
+    SharedGlobals(const SharedGlobals&) = delete;
+    SharedGlobals& operator=(const SharedGlobals&) = delete;
+
+    Reader* attach();
+    void detach(Reader* reader);
+    void enter(Reader* reader); //a read section , get() is only safe between these two
+    void leave(Reader* reader);
+
+    // lock free , copies the value out. false if the name isn't defined
+    bool get(const std::string& name, Value& value) const;
+    // writers , one at a time. set() is false and changes nothing when the name isn't defined
+    void define(const std::string& name, const Value& value);
+    bool set(const std::string& name, const Value& value);
+
+    // every global as it is right now , for a host that isn't a reader
+    std::unordered_map<std::string, Value> copy() const;
+    size_t retiredCount() const; //replaced boxes and tables still waiting for readers
+
+private:
+    struct Box {
+        Value value;
+    };
+    struct Slot {
+        std::atomic<Box*> box{nullptr};
+    };
+    using Table = std::unordered_map<std::string, Slot*>;
+    struct Retired {
+        uint64_t epoch; //write epoch it was replaced in
+        Box* box;
+        const Table* table;
+    };
+    static constexpr size_t RECLAIM_BATCH = 64; //retirements between scans of the readers
+
+    std::atomic<const Table*> table;
+    std::atomic<uint64_t> epoch{1};
+    mutable std::mutex writer; //everything below
+    std::deque<Slot> slots;    //never move , the tables point into it
+    std::deque<Retired> retired;
+    std::vector<Reader*> readers;
+
+    void retire(Box* box, const Table* table);
+    void reclaim();
+};
+
+// enter() and leave() around a scope , does nothing without a reader
+class SharedReadSection {
+public:
+    SharedReadSection(SharedGlobals* globals, SharedGlobals::Reader* reader) : globals(globals), reader(reader) {
+        if (reader != nullptr) globals->enter(reader);
+    }
+    ~SharedReadSection() {
+        if (reader != nullptr) globals->leave(reader);
+    }
+    SharedReadSection(const SharedReadSection&) = delete;
+    SharedReadSection& operator=(const SharedReadSection&) = delete;
+
+private:
+    SharedGlobals* globals;
+    SharedGlobals::Reader* reader;
+};
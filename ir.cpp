@@ -0,0 +1,564 @@
+#include "ir.hpp"
+#include "chunk.hpp"
+
+static bool isBinary(IrOp op) {
+    switch (op) {
+        case IrOp::ADD:
+        case IrOp::SUBTRACT:
+        case IrOp::MULTIPLY:
+        case IrOp::DIVIDE:
+        case IrOp::EQUAL:
+        case IrOp::GREATER:
+        case IrOp::LESSER:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool isEffect(IrOp op) {
+    return op == IrOp::STORE || op == IrOp::PRINT || op == IrOp::DISCARD;
+}
+
+int IrBlock::add(IrInstr instr) {
+    this->instrs.push_back(instr);
+    this->replacement.push_back(static_cast<int>(this->instrs.size()) - 1);
+    return static_cast<int>(this->instrs.size()) - 1;
+}
+
+int IrBlock::resolve(int id) {
+    while (id >= 0 && this->replacement[id] != id) {
+        this->replacement[id] = this->replacement[this->replacement[id]]; //path halving
+        id = this->replacement[id];
+    }
+    return id;
+}
+
+void IrBlock::replace(int id, int with) {
+    this->replacement[id] = with;
+    this->instrs[id].removed = true;
+}
+
+bool IrBlock::isValue(int id) {
+    return !isEffect(this->instrs[id].op);
+}
+
+// ------ LIFTING : stack code -> SSA ------
+
+bool IrBlock::lift(Chunk* chunk, bool dropYields) {
+    std::vector<int> stack; //value ids standing in for the VM stack
+    const std::vector<Opcode>& code = chunk->code;
+
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        IrInstr instr;
+        instr.line = chunk->lines[i];
+        switch (code[i]) {
+            case Opcode::OP_CONSTANT:
+                instr.op = IrOp::CONSTANT;
+                instr.constant = chunk->constants.ValueVector[static_cast<int>(code[i + 1])];
+                stack.push_back(add(instr));
+                break;
+            case Opcode::OP_NIL:
+                instr.op = IrOp::CONSTANT;
+                stack.push_back(add(instr));
+                break;
+            case Opcode::OP_TRUE:
+            case Opcode::OP_FALSE:
+                instr.op = IrOp::CONSTANT;
+                instr.constant = Value(code[i] == Opcode::OP_TRUE);
+                stack.push_back(add(instr));
+                break;
+            case Opcode::OP_NEGATE:
+            case Opcode::OP_NOT:
+                instr.op = code[i] == Opcode::OP_NEGATE ? IrOp::NEGATE : IrOp::NOT;
+                instr.a = stack.back();
+                stack.back() = add(instr);
+                break;
+            case Opcode::OP_ADD:      instr.op = IrOp::ADD;      goto binary;
+            case Opcode::OP_SUBTRACT: instr.op = IrOp::SUBTRACT; goto binary;
+            case Opcode::OP_MULTIPLY: instr.op = IrOp::MULTIPLY; goto binary;
+            case Opcode::OP_DIVIDE:   instr.op = IrOp::DIVIDE;   goto binary;
+            case Opcode::OP_EQUAL:    instr.op = IrOp::EQUAL;    goto binary;
+            case Opcode::OP_GREATER:  instr.op = IrOp::GREATER;  goto binary;
+            case Opcode::OP_LESSER:   instr.op = IrOp::LESSER;   goto binary;
+            binary:
+                instr.b = stack.back();
+                stack.pop_back();
+                instr.a = stack.back();
+                stack.back() = add(instr);
+                break;
+            case Opcode::OP_GET_GLOBAL:
+                instr.op = IrOp::LOAD;
+                instr.global = chunk->constants.ValueVector[static_cast<int>(code[i + 1])].getString();
+                stack.push_back(add(instr));
+                break;
+            case Opcode::OP_SET_GLOBAL:
+            case Opcode::OP_DEFINE_GLOBAL:
+                instr.op = IrOp::STORE;
+                instr.global = chunk->constants.ValueVector[static_cast<int>(code[i + 1])].getString();
+                instr.define = code[i] == Opcode::OP_DEFINE_GLOBAL;
+                instr.a = stack.back();
+                if (instr.define) {
+                    stack.pop_back(); //OP_SET_GLOBAL leaves the value on the stack , it's an expression
+                }
+                add(instr);
+                break;
+            case Opcode::OP_POP:
+            case Opcode::OP_PRINT:
+                instr.op = code[i] == Opcode::OP_POP ? IrOp::DISCARD : IrOp::PRINT;
+                instr.a = stack.back();
+                stack.pop_back();
+                add(instr);
+                break;
+            case Opcode::OP_YIELD:
+                if (!dropYields) return false; //globals must be observable there , don't move stores across it
+                break;
+            case Opcode::OP_RETURN:
+                this->returnLine = instr.line;
+                return true;
+            default:
+                return false;
+        }
+    }
+    return false; //compile() always ends the chunk with OP_RETURN
+}
+
+// ------ ANALYSIS ------
+
+void IrBlock::analyze() {
+    std::unordered_map<std::string, bool> defined; //globals that exist once execution gets here
+    for (size_t id = 0; id < this->instrs.size(); id++) {
+        IrInstr& instr = this->instrs[id];
+        if (instr.removed) continue;
+        instr.a = resolve(instr.a);
+        instr.b = resolve(instr.b);
+        InferredType a = instr.a >= 0 ? this->instrs[instr.a].type : InferredType::UNKNOWN;
+        InferredType b = instr.b >= 0 ? this->instrs[instr.b].type : InferredType::UNKNOWN;
+
+        switch (instr.op) {
+            case IrOp::CONSTANT:
+                instr.type = typeOfConstant(instr.constant);
+                instr.mayFault = false;
+                break;
+            case IrOp::LOAD:
+                instr.type = InferredType::UNKNOWN;
+                instr.mayFault = defined.count(instr.global) == 0;
+                defined[instr.global] = true;
+                break;
+            case IrOp::NEGATE:
+                instr.type = negateType(a);
+                instr.mayFault = !isNumericType(a);
+                break;
+            case IrOp::NOT:
+            case IrOp::EQUAL:
+                instr.type = InferredType::BOOLEAN;
+                instr.mayFault = false;
+                break;
+            case IrOp::ADD:
+            case IrOp::SUBTRACT:
+            case IrOp::MULTIPLY:
+            case IrOp::DIVIDE:
+                instr.type = arithmeticType(instr.op == IrOp::DIVIDE, a, b);
+                instr.mayFault = !isNumericType(a) || !isNumericType(b);
+                break;
+            case IrOp::GREATER:
+            case IrOp::LESSER:
+                instr.type = InferredType::BOOLEAN;
+                instr.mayFault = !isNumericType(a) || !isNumericType(b);
+                break;
+            case IrOp::STORE:
+                instr.mayFault = !instr.define && defined.count(instr.global) == 0;
+                defined[instr.global] = true;
+                break;
+            case IrOp::PRINT:
+            case IrOp::DISCARD:
+                instr.mayFault = false;
+                break;
+        }
+    }
+}
+
+// ------ PASSES ------
+
+void IrBlock::forwardGlobals() {
+    // straight line code , so the last value stored into (or loaded from) a global
+    // is exactly what the next OP_GET_GLOBAL would read
+    std::unordered_map<std::string, int> contents;
+    for (size_t id = 0; id < this->instrs.size(); id++) {
+        IrInstr& instr = this->instrs[id];
+        if (instr.removed) continue;
+        instr.a = resolve(instr.a);
+        instr.b = resolve(instr.b);
+
+        if (instr.op == IrOp::LOAD) {
+            auto found = contents.find(instr.global);
+            if (found != contents.end()) {
+                replace(id, found->second);
+            } else {
+                contents[instr.global] = id;
+            }
+        } else if (instr.op == IrOp::STORE) {
+            contents[instr.global] = instr.a;
+        }
+    }
+}
+
+// same semantics as the handlers in VM::run , folding only happens when they can't fail
+static bool fold(IrOp op, const Value& a, const Value& b, Value& result) {
+    bool numbers = isNumeric(a) && isNumeric(b);
+    switch (op) {
+        case IrOp::ADD:      if (!numbers) return false; result = a + b; return true;
+        case IrOp::SUBTRACT: if (!numbers) return false; result = a - b; return true;
+        case IrOp::MULTIPLY: if (!numbers) return false; result = a * b; return true;
+        case IrOp::DIVIDE:   if (!numbers) return false; result = a / b; return true;
+        case IrOp::GREATER:  if (!numbers) return false; result = Value(greaterThan(a, b)); return true;
+        case IrOp::LESSER:   if (!numbers) return false; result = Value(lessThan(a, b)); return true;
+        case IrOp::EQUAL:    result = Value(valuesEqual(a, b)); return true;
+        default:
+            return false;
+    }
+}
+
+void IrBlock::foldConstants() {
+    for (size_t id = 0; id < this->instrs.size(); id++) {
+        IrInstr& instr = this->instrs[id];
+        if (instr.removed) continue;
+        instr.a = resolve(instr.a);
+        instr.b = resolve(instr.b);
+
+        Value result;
+        bool folded = false;
+        if (instr.op == IrOp::NEGATE && this->instrs[instr.a].op == IrOp::CONSTANT) {
+            Value operand = this->instrs[instr.a].constant;
+            if (isNumeric(operand)) {
+                operand.negate();
+                result = operand;
+                folded = true;
+            }
+        } else if (instr.op == IrOp::NOT && this->instrs[instr.a].op == IrOp::CONSTANT) {
+            Value operand = this->instrs[instr.a].constant;
+            result = Value(operand.isFalsey());
+            folded = true;
+        } else if (isBinary(instr.op) && this->instrs[instr.a].op == IrOp::CONSTANT
+                   && this->instrs[instr.b].op == IrOp::CONSTANT) {
+            folded = fold(instr.op, this->instrs[instr.a].constant, this->instrs[instr.b].constant, result);
+        }
+
+        if (folded) {
+            instr.op = IrOp::CONSTANT;
+            instr.constant = result;
+            instr.a = -1;
+            instr.b = -1;
+        }
+    }
+}
+
+void IrBlock::eliminateCommonSubexpressions() {
+    // every value op is pure. if the first copy failed at runtime we never reach the second ,
+    // so reusing the first result is safe even for checked arithmetic
+    std::unordered_map<std::string, int> seen;
+    for (size_t id = 0; id < this->instrs.size(); id++) {
+        IrInstr& instr = this->instrs[id];
+        if (instr.removed) continue;
+        instr.a = resolve(instr.a);
+        instr.b = resolve(instr.b);
+        if (!isValue(id) || instr.op == IrOp::LOAD) continue; //loads were already merged by forwardGlobals
+
+        std::string key = std::to_string(static_cast<int>(instr.op));
+        if (instr.op == IrOp::CONSTANT) {
+            uint64_t bits = 0;
+            if (instr.constant.type == valueType::NUMBER) {
+                std::memcpy(&bits, &instr.constant.data.number, sizeof(bits));
+            } else if (instr.constant.type == valueType::INTEGER) {
+                bits = static_cast<uint64_t>(instr.constant.data.integer);
+            } else if (instr.constant.type == valueType::BOOLEAN) {
+                bits = instr.constant.data.boolean;
+            }
+            key += ":" + std::to_string(static_cast<int>(instr.constant.type)) + ":" + std::to_string(bits);
+        } else {
+            key += ":" + std::to_string(instr.a) + ":" + std::to_string(instr.b);
+        }
+
+        auto found = seen.find(key);
+        if (found != seen.end()) {
+            replace(id, found->second);
+        } else {
+            seen[key] = id;
+        }
+    }
+}
+
+void IrBlock::eliminateDeadStores() {
+    // a store is dead if the same global is stored again before anything reads it.
+    // we only drop it when nothing in between can raise a runtime error , otherwise
+    // the REPL (whose globals outlive the chunk) could observe the difference.
+    analyze();
+    std::unordered_map<std::string, int> lastStore;
+    std::unordered_map<std::string, int> lastLoad;
+    int lastFault = -1;
+
+    for (size_t id = 0; id < this->instrs.size(); id++) {
+        IrInstr& instr = this->instrs[id];
+        if (instr.removed) continue;
+
+        if (instr.op == IrOp::LOAD) {
+            lastLoad[instr.global] = id;
+        } else if (instr.op == IrOp::STORE) {
+            auto previous = lastStore.find(instr.global);
+            if (previous != lastStore.end()) {
+                int earlier = previous->second;
+                auto load = lastLoad.find(instr.global);
+                bool read = load != lastLoad.end() && load->second > earlier;
+                if (!read && lastFault < earlier && !this->instrs[earlier].mayFault) {
+                    IrInstr& dead = this->instrs[earlier];
+                    if (dead.define) {
+                        instr.define = true; //the global may not exist yet without the earlier define
+                    }
+                    dead.op = IrOp::DISCARD; //the stored value still has to be computed if that can fail
+                    dead.define = false;
+                    dead.global.clear();
+                }
+            }
+            lastStore[instr.global] = id;
+        }
+
+        if (instr.mayFault) {
+            lastFault = id;
+        }
+    }
+}
+
+// ------ LOWERING : SSA -> stack code ------
+
+namespace {
+
+class Lowering {
+public:
+    IrBlock& block;
+    Chunk out;
+    std::vector<bool> evaluated;                    //computed at least once in the new code
+    std::unordered_map<std::string, int> contents;  //global -> value it holds in the new code
+    std::unordered_map<int, std::string> homes;     //value -> a global currently holding it
+    std::unordered_map<std::string, int> names;     //interned identifier constants
+    std::unordered_map<std::string, int> numbers;   //interned number constants
+    int pending = -1;                               //value an OP_SET_GLOBAL left on top of the stack
+
+    explicit Lowering(IrBlock& block) : block(block) {
+        out.initChunk();
+        evaluated.assign(block.instrs.size(), false);
+    }
+
+    int nameConstant(const std::string& name) {
+        auto found = names.find(name);
+        if (found != names.end()) return found->second;
+        int index = out.addConstant(Value(name));
+        names[name] = index;
+        return index;
+    }
+
+    void emitConstant(const Value& value, int line) {
+        if (value.type == valueType::NIL) {
+            out.writeChunk(Opcode::OP_NIL, line);
+            return;
+        }
+        if (value.type == valueType::BOOLEAN) {
+            out.writeChunk(value.data.boolean ? Opcode::OP_TRUE : Opcode::OP_FALSE, line);
+            return;
+        }
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value.data, sizeof(bits)); //the double or the integer , the type keeps them apart
+        std::string key = std::to_string(static_cast<int>(value.type)) + ":" + std::to_string(bits);
+        auto found = numbers.find(key);
+        int index;
+        if (found != numbers.end()) {
+            index = found->second;
+        } else {
+            index = out.addConstant(value);
+            numbers[key] = index;
+        }
+        out.writeChunk(Opcode::OP_CONSTANT, line);
+        out.writeChunk(static_cast<Opcode>(index), line);
+    }
+
+    void emitGlobal(Opcode opcode, const std::string& name, int line) {
+        out.writeChunk(opcode, line);
+        out.writeChunk(static_cast<Opcode>(nameConstant(name)), line);
+    }
+
+    void flush(int line) {
+        if (pending >= 0) {
+            out.writeChunk(Opcode::OP_POP, line);
+            pending = -1;
+        }
+    }
+
+    void stored(const std::string& name, int value) {
+        auto old = contents.find(name);
+        if (old != contents.end()) {
+            auto home = homes.find(old->second);
+            if (home != homes.end() && home->second == name) {
+                homes.erase(home);
+            }
+        }
+        contents[name] = value;
+        homes[value] = name;
+    }
+
+    // does computing this value (again) risk a runtime error we haven't hit yet.
+    // walks a work list , an expression can nest deeper than the native stack goes
+    bool needsEvaluation(int id) {
+        std::vector<int> work{id};
+        while (!work.empty()) {
+            int next = work.back();
+            work.pop_back();
+            IrInstr& instr = block.instrs[next];
+            if (evaluated[next]) continue;
+            if (instr.mayFault) return true;
+            if (instr.a >= 0) work.push_back(instr.a);
+            if (instr.b >= 0) work.push_back(instr.b);
+        }
+        return false;
+    }
+
+    // push value id onto the stack. operands go first , a then b , the order the stack machine
+    // computed them in. kept on an explicit stack for the same reason as needsEvaluation
+    bool materialize(int id) {
+        struct Frame {
+            int id;
+            int operands; //of its operands , how many have been pushed
+        };
+        std::vector<Frame> work{{id, 0}};
+        while (!work.empty()) {
+            int next = work.back().id;
+            int pushed = work.back().operands;
+            IrInstr& instr = block.instrs[next];
+            if (pushed == 0) {
+                if (instr.op == IrOp::CONSTANT) {
+                    emitConstant(instr.constant, instr.line);
+                    work.pop_back();
+                    continue;
+                }
+                auto home = homes.find(next);
+                if (home != homes.end()) {
+                    emitGlobal(Opcode::OP_GET_GLOBAL, home->second, instr.line);
+                    work.pop_back();
+                    continue;
+                }
+                if (instr.op == IrOp::LOAD) {
+                    auto current = contents.find(instr.global);
+                    if (current != contents.end() && current->second != next) {
+                        return false; //the global was overwritten before this read got lowered
+                    }
+                    emitGlobal(Opcode::OP_GET_GLOBAL, instr.global, instr.line);
+                    if (current == contents.end()) {
+                        stored(instr.global, next);
+                    }
+                    evaluated[next] = true;
+                    work.pop_back();
+                    continue;
+                }
+            }
+
+            int needed = instr.op == IrOp::NEGATE || instr.op == IrOp::NOT ? 1 : 2;
+            if (pushed < needed) {
+                work.back().operands++;
+                work.push_back({pushed == 0 ? instr.a : instr.b, 0});
+                continue;
+            }
+            switch (instr.op) {
+                case IrOp::NEGATE:   out.writeChunk(Opcode::OP_NEGATE, instr.line); break;
+                case IrOp::NOT:      out.writeChunk(Opcode::OP_NOT, instr.line); break;
+                case IrOp::ADD:      out.writeChunk(Opcode::OP_ADD, instr.line); break;
+                case IrOp::SUBTRACT: out.writeChunk(Opcode::OP_SUBTRACT, instr.line); break;
+                case IrOp::MULTIPLY: out.writeChunk(Opcode::OP_MULTIPLY, instr.line); break;
+                case IrOp::DIVIDE:   out.writeChunk(Opcode::OP_DIVIDE, instr.line); break;
+                case IrOp::EQUAL:    out.writeChunk(Opcode::OP_EQUAL, instr.line); break;
+                case IrOp::GREATER:  out.writeChunk(Opcode::OP_GREATER, instr.line); break;
+                case IrOp::LESSER:   out.writeChunk(Opcode::OP_LESSER, instr.line); break;
+                default: return false;
+            }
+            evaluated[next] = true;
+            work.pop_back();
+        }
+        return true;
+    }
+
+    bool run() {
+        std::vector<bool> live(block.instrs.size(), false);
+        for (size_t id = block.instrs.size(); id-- > 0;) {
+            IrInstr& instr = block.instrs[id];
+            if (instr.removed) continue;
+            if (isEffect(instr.op)) live[id] = true;
+            if (live[id]) {
+                if (instr.a >= 0) live[instr.a] = true;
+                if (instr.b >= 0) live[instr.b] = true;
+            }
+        }
+
+        size_t checked = 0;
+        for (size_t id = 0; id < block.instrs.size(); id++) {
+            IrInstr& instr = block.instrs[id];
+            if (instr.removed || !isEffect(instr.op)) continue;
+
+            int value = instr.a;
+            if (instr.op == IrOp::DISCARD) {
+                if (needsEvaluation(value)) {
+                    flush(instr.line);
+                    if (!materialize(value)) return false;
+                    out.writeChunk(Opcode::OP_POP, instr.line);
+                }
+            } else {
+                if (pending != value) {
+                    flush(instr.line);
+                    if (!materialize(value)) return false;
+                }
+                if (instr.op == IrOp::PRINT) {
+                    out.writeChunk(Opcode::OP_PRINT, instr.line);
+                    pending = -1;
+                } else {
+                    emitGlobal(instr.define ? Opcode::OP_DEFINE_GLOBAL : Opcode::OP_SET_GLOBAL, instr.global, instr.line);
+                    stored(instr.global, value);
+                    pending = instr.define ? -1 : value;
+                }
+            }
+
+            // every failing computation that ran before this effect in the original code
+            // must also have run by now , or errors would surface in a different order
+            for (; checked < id; checked++) {
+                IrInstr& earlier = block.instrs[checked];
+                if (!earlier.removed && live[checked] && earlier.mayFault && !evaluated[checked] && !isEffect(earlier.op)) {
+                    return false;
+                }
+            }
+        }
+        flush(block.returnLine);
+        out.writeChunk(Opcode::OP_RETURN, block.returnLine);
+        return out.constants.ValueVector.size() <= MAX_CONSTANTS;
+    }
+};
+
+}
+
+bool IrBlock::lower(Chunk* chunk) {
+    analyze();
+    Lowering lowering(*this);
+    if (!lowering.run()) {
+        return false;
+    }
+    chunk->code = lowering.out.code;
+    chunk->lines = lowering.out.lines;
+    chunk->constants = lowering.out.constants;
+    return true;
+}
+
+bool optimizeChunk(Chunk* chunk) {
+    IrBlock block;
+    if (!block.lift(chunk)) {
+        return false;
+    }
+    block.forwardGlobals();
+    block.foldConstants();
+    block.eliminateCommonSubexpressions();
+    block.eliminateDeadStores();
+    return block.lower(chunk);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "common.hpp"
+#include "value.hpp"
+#include "typeinfer.hpp"
+
+class Chunk;
+
+enum class IrOp {
+    CONSTANT,
+    LOAD,      //read a global
+    NEGATE,
+    NOT,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    EQUAL,
+    GREATER,
+    LESSER,
+    // effects , these don't produce a value
+    STORE,     //write a global (OP_DEFINE_GLOBAL or OP_SET_GLOBAL)
+    PRINT,
+    DISCARD,   //value of an expression statement , only kept if computing it can fail
+};
+
+// one SSA instruction , its id is its index in IrBlock::instrs
+class IrInstr {
+public:
+    IrOp op;
+    int a = -1;                 //operand value ids
+    int b = -1;
+    Value constant;             //for CONSTANT
+    std::string global;         //for LOAD / STORE
+    bool define = false;        //STORE came from OP_DEFINE_GLOBAL (never fails , pops the value)
+    int line = 0;
+    InferredType type = InferredType::UNKNOWN;
+    bool mayFault = false;      //can raise a runtime error
+    bool removed = false;       //replaced by another value or deleted by a pass
+};
+
+// the whole chunk as a single basic block , the language has no jumps yet.
+// instructions stay in the order the stack machine would execute them , so
+// runtime errors and prints keep their relative order through every pass.
+class IrBlock {
+public:
+    std::vector<IrInstr> instrs;
+    std::vector<int> replacement; //replacement[id] is the value that stands in for id
+    int returnLine = 0;
+
+    bool lift(Chunk* chunk, bool dropYields = false); //false if the chunk has opcodes the IR doesn't model
+    void analyze();               //types + which instructions can fail at runtime
+    void forwardGlobals();        //copy/constant propagation through globals (store -> load forwarding)
+    void foldConstants();
+    void eliminateCommonSubexpressions();
+    void eliminateDeadStores();   //stores overwritten before anyone could observe them
+    bool lower(Chunk* chunk);     //false if the block can't be lowered without changing behavior
+
+    int resolve(int id);
+    bool isValue(int id);
+
+private:
+    int add(IrInstr instr);
+    void replace(int id, int with);
+};
+
+// runs the -O2 pipeline on a freshly compiled chunk , leaves the chunk untouched if it can't be optimized safely
+bool optimizeChunk(Chunk* chunk);
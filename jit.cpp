@@ -0,0 +1,257 @@
+#include "jit.hpp"
+#include "chunk.hpp"
+#include "value.hpp"
+#include "vm.hpp"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define CLOX_JIT 1
+#endif
+
+#ifdef CLOX_JIT
+
+bool jitSupported() {
+    return true;
+}
+
+// where jitPrint writes , the running VM's output
+static thread_local std::ostream* printTarget = &std::cout;
+
+// same output as OP_PRINT in VM::run
+static void jitPrint(double number) {
+    Value(number).printValue(*printTarget);
+    *printTarget << '\n';
+}
+
+namespace {
+
+// stack slot k lives at [rbx + 8k] , global slot g at [r12 + 8g].
+// stack depth is known at every instruction (no jumps) so nothing moves a stack pointer at runtime.
+class Assembler {
+public:
+    std::vector<uint8_t> bytes;
+
+    void byte(uint8_t b) { bytes.push_back(b); }
+    void bytes3(uint8_t a, uint8_t b, uint8_t c) { byte(a); byte(b); byte(c); }
+    void imm32(int32_t value) {
+        for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    void imm64(uint64_t value) {
+        for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void prologue() {
+        byte(0x53);                     // push rbx
+        byte(0x41); byte(0x54);         // push r12
+        byte(0x41); byte(0x55);         // push r13 (keeps rsp 16 byte aligned for calls)
+        bytes3(0x48, 0x89, 0xFB);       // mov rbx, rdi   (stack)
+        bytes3(0x49, 0x89, 0xF4);       // mov r12, rsi   (globals)
+    }
+    void epilogue() {
+        byte(0x41); byte(0x5D);         // pop r13
+        byte(0x41); byte(0x5C);         // pop r12
+        byte(0x5B);                     // pop rbx
+        byte(0xC3);                     // ret
+    }
+    void movRaxImm(uint64_t value) {    // mov rax, imm64
+        byte(0x48); byte(0xB8); imm64(value);
+    }
+    void storeStack(int slot) {         // mov [rbx + 8*slot], rax
+        bytes3(0x48, 0x89, 0x83); imm32(8 * slot);
+    }
+    void loadStack(int slot) {          // mov rax, [rbx + 8*slot]
+        bytes3(0x48, 0x8B, 0x83); imm32(8 * slot);
+    }
+    void loadGlobal(int slot) {         // mov rax, [r12 + 8*slot]
+        bytes3(0x49, 0x8B, 0x84); byte(0x24); imm32(8 * slot);
+    }
+    void storeGlobal(int slot) {        // mov [r12 + 8*slot], rax
+        bytes3(0x49, 0x89, 0x84); byte(0x24); imm32(8 * slot);
+    }
+    void sse(uint8_t opcode, int slot) { // <op>sd xmm0, [rbx + 8*slot]
+        byte(0xF2); byte(0x0F); byte(opcode); byte(0x83); imm32(8 * slot);
+    }
+    void flipSign() {                   // btc rax, 63
+        byte(0x48); byte(0x0F); byte(0xBA); byte(0xF8); byte(0x3F);
+    }
+    void callRax() {                    // call rax
+        byte(0xFF); byte(0xD0);
+    }
+};
+
+const uint8_t MOVSD_LOAD = 0x10;
+const uint8_t MOVSD_STORE = 0x11;
+const uint8_t ADDSD = 0x58;
+const uint8_t MULSD = 0x59;
+const uint8_t SUBSD = 0x5C;
+const uint8_t DIVSD = 0x5E;
+
+}
+
+std::unique_ptr<JitCode> JitCode::compile(Chunk* chunk, VM* vm) {
+    std::unique_ptr<JitCode> jit(new JitCode());
+    std::unordered_map<std::string, int> slots;
+    std::unordered_map<std::string, bool> written;
+    Assembler assembler;
+    assembler.prologue();
+
+    // every global the chunk touches must hold a number , either from earlier runs or defined here.
+    // then no instruction in the chunk can fail and the machine code needs no checks at all.
+    auto slotOf = [&](int constant, bool store) {
+        const Value& name = chunk->constants.ValueVector[constant];
+        if (name.type != valueType::STRING) return -1;
+        auto found = slots.find(*name.data.string);
+        int slot;
+        if (found != slots.end()) {
+            slot = found->second;
+        } else {
+            slot = static_cast<int>(jit->globals.size());
+            slots[*name.data.string] = slot;
+            jit->globals.push_back(*name.data.string);
+            jit->inputs.push_back(false);
+            jit->outputs.push_back(false);
+        }
+        if (!store && !jit->outputs[slot] && !jit->inputs[slot]) {
+            auto existing = vm->globals.find(*name.data.string);
+            if (existing == vm->globals.end() || existing->second.type != valueType::NUMBER) return -1;
+            jit->inputs[slot] = true;
+        }
+        return slot;
+    };
+
+    int depth = 0;
+    const std::vector<Opcode>& code = chunk->code;
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        switch (code[i]) {
+            case Opcode::OP_CONSTANT: {
+                const Value& constant = chunk->constants.ValueVector[static_cast<int>(code[i + 1])];
+                if (constant.type != valueType::NUMBER) return nullptr;
+                uint64_t bits;
+                std::memcpy(&bits, &constant.data.number, sizeof(bits));
+                assembler.movRaxImm(bits);
+                assembler.storeStack(depth++);
+                break;
+            }
+            case Opcode::OP_GET_GLOBAL: {
+                int slot = slotOf(static_cast<int>(code[i + 1]), false);
+                if (slot < 0) return nullptr;
+                assembler.loadGlobal(slot);
+                assembler.storeStack(depth++);
+                break;
+            }
+            case Opcode::OP_SET_GLOBAL:
+            case Opcode::OP_DEFINE_GLOBAL: {
+                bool define = code[i] == Opcode::OP_DEFINE_GLOBAL;
+                int slot = slotOf(static_cast<int>(code[i + 1]), define);
+                if (slot < 0) return nullptr; //OP_SET_GLOBAL on a global that doesn't exist
+                assembler.loadStack(depth - 1);
+                assembler.storeGlobal(slot);
+                jit->outputs[slot] = true;
+                if (define) depth--;
+                break;
+            }
+            case Opcode::OP_NEGATE:
+            case Opcode::OP_NEGATE_NUM:
+                assembler.loadStack(depth - 1);
+                assembler.flipSign();
+                assembler.storeStack(depth - 1);
+                break;
+            case Opcode::OP_ADD:
+            case Opcode::OP_ADD_NUM:
+            case Opcode::OP_SUBTRACT:
+            case Opcode::OP_SUBTRACT_NUM:
+            case Opcode::OP_MULTIPLY:
+            case Opcode::OP_MULTIPLY_NUM:
+            case Opcode::OP_DIVIDE:
+            case Opcode::OP_DIVIDE_NUM: {
+                uint8_t operation;
+                switch (code[i]) {
+                    case Opcode::OP_ADD: case Opcode::OP_ADD_NUM:           operation = ADDSD; break;
+                    case Opcode::OP_SUBTRACT: case Opcode::OP_SUBTRACT_NUM: operation = SUBSD; break;
+                    case Opcode::OP_MULTIPLY: case Opcode::OP_MULTIPLY_NUM: operation = MULSD; break;
+                    default:                                                operation = DIVSD; break;
+                }
+                assembler.sse(MOVSD_LOAD, depth - 2);
+                assembler.sse(operation, depth - 1);
+                assembler.sse(MOVSD_STORE, depth - 2);
+                depth--;
+                break;
+            }
+            case Opcode::OP_POP:
+                depth--;
+                break;
+            case Opcode::OP_PRINT:
+                assembler.sse(MOVSD_LOAD, depth - 1);
+                assembler.movRaxImm(reinterpret_cast<uint64_t>(&jitPrint));
+                assembler.callRax();
+                depth--;
+                break;
+            case Opcode::OP_RETURN:
+                i = code.size();
+                break;
+            default:
+                return nullptr; //booleans , nil , comparisons : leave those to the interpreter
+        }
+        jit->stackSize = std::max(jit->stackSize, depth);
+    }
+    assembler.epilogue();
+
+    jit->size = assembler.bytes.size();
+    void* memory = mmap(nullptr, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, assembler.bytes.data(), jit->size);
+    if (mprotect(memory, jit->size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, jit->size);
+        return nullptr;
+    }
+    jit->memory = memory;
+    return jit;
+}
+
+bool JitCode::run(VM* vm) {
+    std::vector<double> slots(this->globals.size());
+    for (size_t slot = 0; slot < this->globals.size(); slot++) {
+        if (!this->inputs[slot]) continue;
+        auto found = vm->globals.find(this->globals[slot]);
+        if (found == vm->globals.end() || found->second.type != valueType::NUMBER) {
+            return false;
+        }
+        slots[slot] = found->second.data.number;
+    }
+    std::vector<double> stack(this->stackSize + 1);
+
+    printTarget = vm->output;
+    auto function = reinterpret_cast<void (*)(double*, double*)>(this->memory);
+    function(stack.data(), slots.data());
+
+    for (size_t slot = 0; slot < this->globals.size(); slot++) {
+        if (this->outputs[slot]) {
+            vm->globals[this->globals[slot]] = Value(slots[slot]);
+        }
+    }
+    return true;
+}
+
+JitCode::~JitCode() {
+    if (this->memory != nullptr) {
+        munmap(this->memory, this->size);
+    }
+}
+
+#else
+
+bool jitSupported() {
+    return false;
+}
+
+std::unique_ptr<JitCode> JitCode::compile(Chunk*, VM*) {
+    return nullptr;
+}
+
+bool JitCode::run(VM*) {
+    return false;
+}
+
+JitCode::~JitCode() {}
+
+#endif
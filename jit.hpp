@@ -0,0 +1,29 @@
+#pragma once
+#include "common.hpp"
+
+class Chunk;
+class VM;
+
+// baseline JIT : every opcode handler is a fixed x86-64 template , pasted one after another
+// into an mmap'd buffer. only numeric chunks are handled (numbers , globals holding numbers ,
+// arithmetic , print) , anything else makes compile() return nullptr and the VM interprets instead.
+// only built on x86-64 Linux , everywhere else jitSupported() is false.
+class JitCode {
+public:
+    ~JitCode();
+
+    static std::unique_ptr<JitCode> compile(Chunk* chunk, VM* vm);
+    bool run(VM* vm); //false if the globals it was compiled against changed type , caller should interpret
+
+    size_t codeSize() const { return this->size; }
+
+private:
+    void* memory = nullptr;
+    size_t size = 0;
+    int stackSize = 0;
+    std::vector<std::string> globals;  //slot -> name
+    std::vector<bool> inputs;          //slot is read before the chunk writes it , loaded from VM::globals
+    std::vector<bool> outputs;         //slot is written , stored back into VM::globals afterwards
+};
+
+bool jitSupported();
@@ -4,15 +4,41 @@
 #include "value.hpp"
 #include "vm.hpp"
 #include "result.hpp"
+#include "regvm.hpp"
+#include "compiler.hpp"
+#include "aot.hpp"
+#include "records.hpp"
+#include "server.hpp"
+#include "profiler.hpp"
+#include "timing.hpp"
+#include "session.hpp"
+#include "snapshot.hpp"
+#include "modules.hpp"
+#include "debugger.hpp"
+#include "stream.hpp"
+#include <fcntl.h>
+#include <unistd.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 
 VM vm;
+RegVM regvm;
+Modules modules; //what import statements find , see modules.hpp
+bool useRegisterEngine = false;
+std::string profileJsonPath = "clox-profile.json";
+bool printTimings = false;
+std::string tracePath;
+
+static InterpretResult interpret(const std::string& source) {
+    return useRegisterEngine ? regvm.interpret(source) : vm.interpret(source);
+}
 
 static void repl() {
     std::string line;
+    Session session; //the stack engine keeps one growing chunk , see session.hpp
+    session.initSession(&vm);
 
     for (;;) {
         std::cout << "> ";
@@ -22,7 +48,11 @@ static void repl() {
             break;
         }
 
-        vm.interpret(line);
+        if (useRegisterEngine) {
+            interpret(line);
+        } else {
+            session.execute(line);
+        }
     }
 
 }
@@ -39,7 +69,8 @@ static void writeChunkToFile(Chunk& chunk, std::string& filename) {
         out << i << ": " << static_cast<int>(code[i]);
         // Print constant index if this is a two-byte opcode
         if (code[i] == Opcode::OP_CONSTANT || code[i] == Opcode::OP_DEFINE_GLOBAL ||
-            code[i] == Opcode::OP_GET_GLOBAL || code[i] == Opcode::OP_SET_GLOBAL) {
+            code[i] == Opcode::OP_GET_GLOBAL || code[i] == Opcode::OP_SET_GLOBAL ||
+            code[i] == Opcode::OP_IMPORT) {
             out << " [" << static_cast<int>(code[i+1]) << "]";
             ++i;
             }
@@ -56,22 +87,38 @@ static void writeChunkToFile(Chunk& chunk, std::string& filename) {
 }
 
 static std::string readFile(const char* path) {
+    PhaseTimer phase("readFile");
     std::ifstream file(path, std::ios::binary);
     if (!file) {
         std::cerr << "Could not open file \"" << path << "\".\n";
         std::exit(74);
     }
 
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    // straight into the string , sized up front. a pipe can't tell its size , it's read through a
+    // stream buffer instead
+    std::string source;
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if (size >= 0) {
+        source.resize(static_cast<size_t>(size));
+        file.seekg(0, std::ios::beg);
+        file.read(source.data(), static_cast<std::streamsize>(size));
+        source.resize(static_cast<size_t>(file.gcount()));
+    } else {
+        file.clear();
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+        source = std::move(buffer).str();
+    }
+    phase.count("bytes", source.size());
+    return source;
 }
 
 static void runFile(const char* path) {
     std::string source = readFile(path);
     std::cout << "Source code read successfully, length: " << source.length() << "\n";
 
-    InterpretResult result = vm.interpret(source);
+    InterpretResult result = interpret(source);
     std::cout << "Interpretation result: " << static_cast<int>(result) << "\n";
 
     if (result == InterpretResult::INTERPRET_COMPILE_ERROR) {
@@ -82,12 +129,414 @@ static void runFile(const char* path) {
         std::cout << "Runtime error occurred\n";
         std::exit(70);
     }
+    if (result == InterpretResult::INTERPRET_BUDGET_EXCEEDED) {
+        std::cout << "Budget exceeded\n";
+        std::exit(70);
+    }
 
     std::cout << "Execution completed successfully\n";
 }
 
+// clox --emit-cpp=out.cpp script.lol : compile once and write the chunk out as C++ , see aot.hpp
+static void emitFile(const char* path, const std::string& outputPath) {
+    std::string source = readFile(path);
+    Chunk chunk;
+    chunk.initChunk();
+    if (!compile(source, &chunk, vm.optimizationLevel)) {
+        std::exit(65);
+    }
+    std::ofstream out(outputPath);
+    if (!out) {
+        std::cerr << "Could not open " << outputPath << " for writing!\n";
+        std::exit(74);
+    }
+    if (!emitCpp(&chunk, out, "clox_script", path)) {
+        std::cerr << "Can't emit C++ for a chunk with breakpoint traps\n";
+        std::exit(65);
+    }
+    std::cout << "Wrote " << outputPath << "\n";
+}
+
+static void compileOrExit(const char* path, Chunk& chunk) {
+    chunk.initChunk();
+    if (!compile(readFile(path), &chunk, vm.optimizationLevel) || !modules.load(chunk, std::cerr)) {
+        std::exit(65);
+    }
+}
+
+// clox --stream script.lol : run it a window of source at a time , see stream.hpp
+static void runStreamFile(const char* path, size_t window) {
+    int fd = open(path, O_RDONLY); //it needn't be a regular file , eg. /dev/stdin
+    if (fd < 0) {
+        std::cerr << "Could not open file \"" << path << "\".\n";
+        std::exit(74);
+    }
+    SourceStream stream;
+    if (window != 0) stream.window = window;
+    InterpretResult result = stream.run(fd, &vm);
+    close(fd);
+    std::cout.flush();
+    if (result == InterpretResult::INTERPRET_COMPILE_ERROR) std::exit(65);
+    if (result != InterpretResult::INTERPRET_OK) std::exit(70);
+}
+
+// clox --records script.lol < input : compile once , run once per line of stdin , see records.hpp
+static void runRecordsFile(const char* path, const std::string& beginPath, const std::string& endPath, char separator) {
+    static char outputBuffer[1 << 20];
+    std::setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer)); //prints are flushed in big batches
+
+    Chunk begin, script, end;
+    if (!beginPath.empty()) compileOrExit(beginPath.c_str(), begin);
+    compileOrExit(path, script);
+    if (!endPath.empty()) compileOrExit(endPath.c_str(), end);
+
+    InterpretResult result = InterpretResult::INTERPRET_OK;
+    if (!beginPath.empty()) result = vm.interpret(&begin);
+    if (result == InterpretResult::INTERPRET_OK) {
+        RecordReader input;
+        input.open(0);
+        result = runRecords(vm, &script, input, separator);
+    }
+    if (result == InterpretResult::INTERPRET_OK && !endPath.empty()) {
+        vm.stack.clear();
+        result = vm.interpret(&end);
+    }
+    std::cout.flush();
+    if (result != InterpretResult::INTERPRET_OK) {
+        std::exit(70);
+    }
+}
+
+// clox --serve=socket : keep compiled chunks and VMs around between requests , see server.hpp
+static void serveSocket(const std::string& socketPath, unsigned workers, size_t cacheCapacity) {
+    Server server;
+    server.optimizationLevel = vm.optimizationLevel;
+    server.cache.capacity = cacheCapacity;
+    server.limits = vm.limits;
+    if (!server.initServer(socketPath, workers)) {
+        std::exit(74);
+    }
+    std::cout << "Listening on " << socketPath << std::endl;
+    server.serve();
+}
+
+// clox --client=socket script.lol : run a script on a server and relay its output
+static void runOnServer(const std::string& socketPath, const char* path) {
+    std::string source = readFile(path);
+    int fd = connectServer(socketPath);
+    if (fd < 0) {
+        std::cerr << "Could not connect to " << socketPath << "\n";
+        std::exit(74);
+    }
+    char status;
+    std::string output;
+    if (!writeMessage(fd, 'S', source) || !readMessage(fd, status, output)) {
+        std::cerr << "Lost connection to " << socketPath << "\n";
+        close(fd);
+        std::exit(74);
+    }
+    close(fd);
+    std::cout << output;
+    if (status == '0' + static_cast<int>(InterpretResult::INTERPRET_COMPILE_ERROR)) std::exit(65);
+    if (status == '0' + static_cast<int>(InterpretResult::INTERPRET_RUNTIME_ERROR)) std::exit(70);
+    if (status == '0' + static_cast<int>(InterpretResult::INTERPRET_BUDGET_EXCEEDED)) std::exit(70);
+}
+
+// clox --save-snapshot=app.snap setup.lol [main.lol] : run the setup script , then write the globals
+// it left (and main.lol compiled , not run) to a snapshot , see snapshot.hpp
+static void saveSnapshot(const std::string& snapshotPath, const char* setupPath, const char* mainPath) {
+    Chunk setup, main;
+    compileOrExit(setupPath, setup);
+    if (mainPath != nullptr) compileOrExit(mainPath, main);
+    InterpretResult result = vm.interpret(&setup);
+    if (result != InterpretResult::INTERPRET_OK) {
+        std::exit(70);
+    }
+    std::vector<const Chunk*> chunks;
+    if (mainPath != nullptr) chunks.push_back(&main);
+    std::string error;
+    if (!writeSnapshot(snapshotPath, vm, chunks, error)) {
+        std::cerr << error << "\n";
+        std::exit(74);
+    }
+    std::cout << "Wrote " << snapshotPath << " (" << vm.globals.size() << " globals , " << chunks.size()
+              << " chunks)\n";
+}
+
+// clox --snapshot=app.snap : start from a snapshot's globals and run the chunk it was saved with
+static void runSnapshotChunk(const Snapshot& snapshot) {
+    Chunk chunk;
+    std::string error;
+    if (!snapshot.loadChunk(0, &chunk, error)) {
+        std::cerr << error << "\n";
+        std::exit(74);
+    }
+    if (!modules.load(chunk, std::cerr)) {
+        std::exit(65);
+    }
+    InterpretResult result = vm.interpret(&chunk);
+    if (result != InterpretResult::INTERPRET_OK) {
+        std::exit(70);
+    }
+}
+
+// clox --disassemble script.lol : the compiled chunk , one instruction per line , see debug.hpp
+static void disassembleFile(const char* path) {
+    Chunk chunk;
+    compileOrExit(path, chunk);
+    disassembleChunk(chunk, path);
+}
+
+// clox --debug script.lol : run under the debugger's prompt , paused before the first line
+static void debugFile(const char* path) {
+    Chunk chunk;
+    compileOrExit(path, chunk);
+    Debugger debugger;
+    std::string error;
+    if (!debugger.attach(&vm, chunk, error)) {
+        std::cerr << error << "\n";
+        std::exit(70);
+    }
+    std::cout << "Debugging " << path << " , 'help' lists the commands\n";
+    debugger.command("where", std::cout);
+    std::string line;
+    for (;;) {
+        std::cout << "(clox) " << std::flush;
+        if (!std::getline(std::cin, line) || !debugger.command(line, std::cout)) break;
+    }
+}
+
+// --timings / --trace , run at exit so the phases of failed runs are reported too
+static void reportTimings() {
+    std::cout.flush();
+    if (printTimings) timeline.writeSummary(std::cerr);
+    if (!tracePath.empty() && timeline.writeTrace(tracePath)) {
+        std::cerr << "trace written to " << tracePath << "\n";
+    }
+}
+
+#ifdef CLOX_PROFILE
+// a profiling build prints its report when the process ends , whichever exit() that comes from
+static void reportProfile() {
+    std::cout.flush();
+    writeProfileReport(std::cerr);
+    if (!profileJsonPath.empty() && writeProfileJson(profileJsonPath)) {
+        std::cerr << "profile written to " << profileJsonPath << "\n";
+    }
+}
+#endif
+
 int main(int argc, const char* argv[]) {
+#ifdef CLOX_PROFILE
+    std::atexit(reportProfile);
+#endif
     vm.initVM();
+    regvm.initVM();
+    modules.initModules();
+    vm.modules = &modules;
+
+    // options come before the path , eg. clox -O2 script.lol
+    std::string emitPath;
+    bool records = false;
+    std::string beginPath, endPath;
+    char separator = ' ';
+    std::string servePath, clientPath;
+    unsigned workers = 0;
+    size_t cacheCapacity = 64;
+    std::string saveSnapshotPath, snapshotPath;
+    std::vector<std::string> modulePaths;
+    bool debug = false, disassemble = false;
+    bool stream = false;
+    size_t window = 0;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        std::string option = argv[argi];
+        if (option == "-O0" || option == "-O1" || option == "-O2") {
+            vm.optimizationLevel = option[2] - '0';
+            regvm.optimizationLevel = vm.optimizationLevel;
+        } else if (option.rfind("--emit-cpp=", 0) == 0) {
+            emitPath = option.substr(std::string("--emit-cpp=").size());
+        } else if (option == "--records") {
+            records = true;
+        } else if (option.rfind("--begin=", 0) == 0) {
+            beginPath = option.substr(std::string("--begin=").size());
+        } else if (option.rfind("--end=", 0) == 0) {
+            endPath = option.substr(std::string("--end=").size());
+        } else if (option.rfind("--fs=", 0) == 0 && option.size() == 6) {
+            separator = option[5];
+        } else if (option.rfind("--serve=", 0) == 0) {
+            servePath = option.substr(std::string("--serve=").size());
+        } else if (option.rfind("--workers=", 0) == 0) {
+            workers = static_cast<unsigned>(std::atoi(option.c_str() + std::string("--workers=").size()));
+        } else if (option.rfind("--cache=", 0) == 0) {
+            cacheCapacity = static_cast<size_t>(std::atol(option.c_str() + std::string("--cache=").size()));
+        } else if (option.rfind("--client=", 0) == 0) {
+            clientPath = option.substr(std::string("--client=").size());
+        } else if (option.rfind("--max-instructions=", 0) == 0) {
+            vm.limits.instructions = std::strtoull(option.c_str() + std::string("--max-instructions=").size(), nullptr, 10);
+        } else if (option.rfind("--max-stack=", 0) == 0) {
+            vm.limits.stackDepth = std::strtoull(option.c_str() + std::string("--max-stack=").size(), nullptr, 10);
+        } else if (option.rfind("--max-heap=", 0) == 0) {
+            vm.limits.heapBytes = std::strtoull(option.c_str() + std::string("--max-heap=").size(), nullptr, 10);
+        } else if (option == "--timings") {
+            printTimings = true;
+        } else if (option.rfind("--trace=", 0) == 0) {
+            tracePath = option.substr(std::string("--trace=").size());
+        } else if (option.rfind("--profile-json=", 0) == 0) {
+            profileJsonPath = option.substr(std::string("--profile-json=").size()); //empty = no JSON
+#ifndef CLOX_PROFILE
+            std::cerr << "Warning: built without -DCLOX_PROFILE , no profile will be written\n";
+#endif
+        } else if (option.rfind("--save-snapshot=", 0) == 0) {
+            saveSnapshotPath = option.substr(std::string("--save-snapshot=").size());
+        } else if (option.rfind("--snapshot=", 0) == 0) {
+            snapshotPath = option.substr(std::string("--snapshot=").size());
+        } else if (option.rfind("--module-path=", 0) == 0) {
+            modulePaths.push_back(option.substr(std::string("--module-path=").size()));
+        } else if (option.rfind("--module-cache=", 0) == 0) {
+            modules.cacheDirectory = option.substr(std::string("--module-cache=").size()); //empty = no cache
+        } else if (option == "--stream" || option.rfind("--stream=", 0) == 0) {
+            stream = true;
+            if (option.size() > 8) window = std::strtoull(option.c_str() + std::string("--stream=").size(), nullptr, 10);
+        } else if (option == "--debug") {
+            debug = true;
+        } else if (option == "--disassemble") {
+            disassemble = true;
+        } else if (option == "--jit") {
+            vm.useJit = true;
+        } else if (option == "--engine=stack" || option == "--engine=reg") {
+            useRegisterEngine = option == "--engine=reg";
+        } else {
+            std::cerr << "Unknown option " << option << "\n";
+            std::cerr << "Usage: clox [-O0|-O1|-O2] [--engine=stack|reg] [--jit] [--emit-cpp=out.cpp] [path]\n";
+            std::cerr << "       clox [-O0|-O1|-O2] --records [--begin=path] [--end=path] [--fs=c] path < input\n";
+            std::cerr << "       clox [-O0|-O1|-O2] --serve=socket [--workers=N] [--cache=N]\n";
+            std::cerr << "       clox --client=socket path\n";
+            std::cerr << "       clox [-O0|-O1|-O2] --save-snapshot=out.snap setup [main]\n";
+            std::cerr << "       clox [-O0|-O1|-O2] --snapshot=app.snap [path]\n";
+            std::cerr << "       clox [-O0|-O1|-O2] --debug path\n";
+            std::cerr << "       clox [-O0|-O1|-O2] --disassemble path\n";
+            std::cerr << "       clox [-O0|-O1|-O2] --stream[=window bytes] path\n";
+            std::cerr << "limits (stack engine) : [--max-instructions=N] [--max-stack=N] [--max-heap=bytes]\n";
+            std::cerr << "imports : [--module-path=dir]... [--module-cache=dir] , CLOX_PATH=dir:dir\n";
+            std::cerr << "phase timings : [--timings] [--trace=trace.json]\n";
+            std::cerr << "profiling builds (-DCLOX_PROFILE) : [--profile-json=path]\n";
+            std::exit(64);
+        }
+    }
+    int positional = argc - argi;
+    // modules are looked for next to the script (or in the working directory) , then in
+    // --module-path directories , then in CLOX_PATH
+    std::string script = positional > 0 ? argv[argi] : "";
+    size_t slash = script.rfind('/');
+    modules.searchPaths.push_back(slash == std::string::npos ? "." : script.substr(0, slash == 0 ? 1 : slash));
+    modules.searchPaths.insert(modules.searchPaths.end(), modulePaths.begin(), modulePaths.end());
+    if (const char* path = std::getenv("CLOX_PATH")) {
+        std::stringstream directories(path);
+        for (std::string directory; std::getline(directories, directory, ':');) {
+            if (!directory.empty()) modules.searchPaths.push_back(directory);
+        }
+    }
+    modules.optimizationLevel = vm.optimizationLevel;
+    if (printTimings || !tracePath.empty()) {
+        timeline.enable();
+        std::atexit(reportTimings);
+    }
+    bool limited = vm.limits.instructions != 0 || vm.limits.stackDepth != 0 || vm.limits.heapBytes != 0;
+    if (limited && useRegisterEngine) {
+        std::cerr << "Limits are only supported by the stack engine\n";
+        std::exit(64);
+    }
+
+    if (!emitPath.empty()) {
+        if (positional != 1) {
+            std::cerr << "Usage: clox [-O0|-O1|-O2] --emit-cpp=out.cpp path\n";
+            std::exit(64);
+        }
+        emitFile(argv[argi], emitPath);
+        return 0;
+    }
+
+    if (!servePath.empty()) {
+        serveSocket(servePath, workers, cacheCapacity);
+        return 0;
+    }
+
+    if (!clientPath.empty()) {
+        if (positional != 1) {
+            std::cerr << "Usage: clox --client=socket path\n";
+            std::exit(64);
+        }
+        runOnServer(clientPath, argv[argi]);
+        return 0;
+    }
+
+    if (!saveSnapshotPath.empty() || !snapshotPath.empty()) {
+        if (useRegisterEngine) {
+            std::cerr << "Snapshots are only supported by the stack engine\n";
+            std::exit(64);
+        }
+    }
+
+    if (disassemble) {
+        if (positional != 1) {
+            std::cerr << "Usage: clox [-O0|-O1|-O2] --disassemble path\n";
+            std::exit(64);
+        }
+        disassembleFile(argv[argi]);
+        return 0;
+    }
+
+    if (debug) {
+        if (positional != 1 || useRegisterEngine || limited) {
+            std::cerr << "Usage: clox [-O0|-O1|-O2] --debug path , on the stack engine without limits\n";
+            std::exit(64);
+        }
+        debugFile(argv[argi]);
+        return 0;
+    }
+
+    if (!saveSnapshotPath.empty()) {
+        if (positional != 1 && positional != 2) {
+            std::cerr << "Usage: clox [-O0|-O1|-O2] --save-snapshot=out.snap setup [main]\n";
+            std::exit(64);
+        }
+        saveSnapshot(saveSnapshotPath, argv[argi], positional == 2 ? argv[argi + 1] : nullptr);
+        return 0;
+    }
+
+    // lives until exit , the VM keeps reading globals out of it
+    static Snapshot snapshot;
+    if (!snapshotPath.empty()) {
+        std::string error;
+        if (!snapshot.open(snapshotPath, error)) {
+            std::cerr << error << "\n";
+            std::exit(74);
+        }
+        snapshot.restore(vm);
+        if (positional == 0 && snapshot.chunkCount() > 0) {
+            runSnapshotChunk(snapshot);
+            return 0;
+        }
+    }
+
+    if (stream) {
+        if (positional != 1 || useRegisterEngine) {
+            std::cerr << "Usage: clox [-O0|-O1|-O2] --stream[=window bytes] path , on the stack engine\n";
+            std::exit(64);
+        }
+        runStreamFile(argv[argi], window);
+        return 0;
+    }
+
+    if (records) {
+        if (positional != 1) {
+            std::cerr << "Usage: clox [-O0|-O1|-O2] --records [--begin=path] [--end=path] [--fs=c] path < input\n";
+            std::exit(64);
+        }
+        runRecordsFile(argv[argi], beginPath, endPath, separator);
+        return 0;
+    }
 
     // Always try to run code.lol first
     const char* defaultFile = "C:\\Users\\samar\\CLionProjects\\cppcompiler\\code.lol" ;
@@ -101,14 +550,15 @@ int main(int argc, const char* argv[]) {
     } else {
         std::cout << "code.lol not found at specified path, checking command line arguments...\n";
 
-        if (argc == 1) {
+        if (positional == 0) {
             std::cout << "No arguments provided, starting REPL...\n";
             repl();
-        } else if (argc == 2) {
-            std::cout << "Running file: " << argv[1] << "\n";
-            runFile(argv[1]);
+        } else if (positional == 1) {
+            std::cout << "Running file: " << argv[argi] << "\n";
+            runFile(argv[argi]);
         } else {
-            std::cerr << "Usage: clox [path]\n";
+            std::cerr << "Usage: clox [-O0|-O1|-O2] [--engine=stack|reg] [--jit] [--emit-cpp=out.cpp] [path]\n";
+            std::cerr << "       clox [-O0|-O1|-O2] --records [--begin=path] [--end=path] [--fs=c] path < input\n";
             std::exit(64);
         }
     }
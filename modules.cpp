@@ -0,0 +1,193 @@
+#include "modules.hpp"
+#include "compiler.hpp"
+#include "snapshot.hpp"
+#include "timing.hpp"
+#include "verifier.hpp"
+#include "vm.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <sys/stat.h>
+#include <thread>
+
+// part of every cache file's name , bump it when an opcode changes meaning so old files aren't read
+static const int BYTECODE_VERSION = 1;
+
+void Modules::initModules(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    this->threads = std::max(1u, threads);
+    this->modules.clear();
+    this->compiled = 0;
+    this->cacheHits = 0;
+    if (const char* cache = std::getenv("CLOX_CACHE")) {
+        this->cacheDirectory = cache;
+    } else if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0') {
+        this->cacheDirectory = std::string(xdg) + "/clox/modules";
+    } else if (const char* home = std::getenv("HOME")) {
+        this->cacheDirectory = std::string(home) + "/.cache/clox/modules";
+    } else {
+        this->cacheDirectory.clear();
+    }
+}
+
+Module* Modules::find(const std::string& name) const {
+    auto found = this->modules.find(name);
+    return found == this->modules.end() ? nullptr : found->second.get();
+}
+
+// the names chunk imports , in order
+static std::vector<std::string> importsOf(const Chunk& chunk) {
+    std::vector<std::string> names;
+    const std::vector<Opcode>& code = chunk.code;
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        if (code[i] == Opcode::OP_IMPORT) {
+            names.push_back(*chunk.constants.ValueVector[static_cast<int>(code[i + 1])].data.string);
+        }
+    }
+    return names;
+}
+
+bool Modules::resolve(const std::string& name, std::string& path) const {
+    for (const std::string& directory : this->searchPaths) {
+        std::string candidate = (directory.empty() ? "." : directory) + "/" + name + ".lol";
+        struct stat info;
+        if (stat(candidate.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            path = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string Modules::cachePath(const Module& module, size_t sourceBytes) const {
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(module.hash));
+    return this->cacheDirectory + "/" + hash + "-" + std::to_string(sourceBytes) + "-O"
+           + std::to_string(this->optimizationLevel) + (this->sharedGlobals ? "s" : "") + "-b"
+           + std::to_string(BYTECODE_VERSION) + ".cloxc";
+}
+
+// mkdir -p , true if it's there afterwards
+static bool makeDirectories(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (slash == std::string::npos) return true;
+    }
+}
+
+// reads , hashes and compiles (or reads back) one module. runs on the load's worker threads , so
+// it only touches module and what it can read : compile() keeps its state per thread
+bool Modules::build(Module& module, std::string& diagnostics) const {
+    std::ifstream file(module.path, std::ios::binary);
+    std::string source;
+    if (file) {
+        file.seekg(0, std::ios::end);
+        source.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(source.data(), static_cast<std::streamsize>(source.size()));
+    }
+    if (!file) {
+        diagnostics = "Could not read module '" + module.name + "' from " + module.path + "\n";
+        return false;
+    }
+    module.hash = hashBytes(source);
+
+    std::string cached = this->cacheDirectory.empty() ? "" : cachePath(module, source.size());
+    if (!cached.empty()) {
+        Snapshot snapshot;
+        std::string error;
+        if (snapshot.open(cached, error) && snapshot.chunkCount() == 1 && snapshot.loadChunk(0, &module.chunk, error)
+            && verifyChunk(&module.chunk, nullptr, this->sharedGlobals)) {
+            module.cached = true;
+            return true;
+        }
+        module.chunk.freeChunk(); //a damaged or foreign file is just a miss , it's written again below
+    }
+
+    std::ostringstream errors;
+    module.chunk.initChunk();
+    if (!compile(source, &module.chunk, this->optimizationLevel, &errors, this->sharedGlobals)) {
+        diagnostics = "In module '" + module.name + "' (" + module.path + "):\n" + errors.str();
+        return false;
+    }
+    if (!cached.empty()) { //best effort , the next load just compiles it again
+        VM empty;
+        std::string error;
+        writeSnapshot(cached, empty, {&module.chunk}, error);
+    }
+    return true;
+}
+
+bool Modules::load(const Chunk& chunk, std::ostream& errors) {
+    std::vector<std::string> wanted = importsOf(chunk);
+    if (wanted.empty()) return true; //the common case , nothing to time
+    PhaseTimer phase("modules");
+    if (!this->cacheDirectory.empty() && !makeDirectories(this->cacheDirectory)) {
+        this->cacheDirectory.clear(); //can't keep a cache , compile everything
+    }
+
+    std::vector<std::string> added;
+    auto forget = [&]() {
+        for (const std::string& name : added) this->modules.erase(name);
+        return false;
+    };
+    size_t compiled = 0, hits = 0;
+    while (!wanted.empty()) {
+        // this wave : every wanted module not loaded yet , once
+        std::vector<std::unique_ptr<Module>> wave;
+        for (const std::string& name : wanted) {
+            if (this->modules.count(name) != 0) continue;
+            bool queued = false;
+            for (auto& module : wave) queued = queued || module->name == name;
+            if (queued) continue;
+            auto module = std::make_unique<Module>();
+            module->name = name;
+            if (!resolve(name, module->path)) {
+                errors << "Can't find module '" << name << "'";
+                if (this->searchPaths.empty()) errors << " , there is no module search path\n";
+                else errors << " in " << this->searchPaths.size() << " search paths (first " << this->searchPaths[0] << ")\n";
+                return forget();
+            }
+            wave.push_back(std::move(module));
+        }
+
+        // workers pull the next module off a shared index , so a big module doesn't hold up the small ones
+        std::vector<std::string> diagnostics(wave.size());
+        std::vector<char> built(wave.size(), false);
+        std::atomic<size_t> next{0};
+        auto work = [&]() {
+            for (size_t k = next.fetch_add(1); k < wave.size(); k = next.fetch_add(1)) {
+                built[k] = build(*wave[k], diagnostics[k]);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned worker = 1; worker < std::min<size_t>(this->threads, wave.size()); worker++) {
+            pool.emplace_back(work);
+        }
+        work();
+        for (std::thread& thread : pool) thread.join();
+
+        bool failed = false;
+        for (size_t k = 0; k < wave.size(); k++) {
+            if (!built[k]) {
+                errors << diagnostics[k];
+                failed = true;
+            }
+        }
+        if (failed) return forget();
+
+        wanted.clear();
+        for (auto& module : wave) {
+            (module->cached ? hits : compiled)++;
+            for (std::string& name : importsOf(module->chunk)) wanted.push_back(std::move(name));
+            added.push_back(module->name);
+            this->modules.emplace(module->name, std::move(module));
+        }
+    }
+    this->compiled += compiled;
+    this->cacheHits += hits;
+    phase.count("compiled", compiled);
+    phase.count("cacheHits", hits);
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "common.hpp"
+#include "chunk.hpp"
+
+// import "name"; runs name.lol's top level the first time a VM gets to it , later imports of the
+// same module by that VM do nothing. modules define and read globals like the script itself , one
+// namespace per VM , so whatever a module defines is there for the code after its import.
+//
+// Modules::load takes a compiled chunk , finds every module it imports (and every module those
+// import) in the search paths and compiles each of them once , before anything runs. a wave of
+// imports that don't depend on each other is compiled in parallel , the next wave is what the
+// last one imported. compiled modules are kept on disk in the cache directory , one file per
+// module named after a hash of its source (and the compile options) , so an unchanged module is
+// read back instead of compiled again , whichever script or process imports it. a cache file is a
+// snapshot with one chunk and no globals (see snapshot.hpp) and is verified again when it's read.
+struct Module {
+    std::string name;    //as written in the import
+    std::string path;    //the file it was found in
+    uint64_t hash = 0;   //of the source , see hashBytes()
+    Chunk chunk;
+    bool cached = false; //read back from the cache instead of compiled
+};
+
+class Modules {
+public:
+    std::vector<std::string> searchPaths; //looked in in order for name.lol
+    std::string cacheDirectory;           //empty = compile every module every time
+    int optimizationLevel = 1;            //passed to compile() , see compiler.hpp
+    bool sharedGlobals = false;           //for VMs on a SharedGlobals store , see VM::share()
+    unsigned threads = 1;
+    size_t compiled = 0;                  //modules compiled from source so far
+    size_t cacheHits = 0;                 //read back from the cache so far
+
+    // 0 threads = one per hardware thread. the cache goes in $CLOX_CACHE , or clox/modules under
+    // $XDG_CACHE_HOME or ~/.cache
+    void initModules(unsigned threads = 0);
+    // everything chunk imports , directly or not , ready to run. a module is read once , a later
+    // load() reuses it. false (with the reasons in errors) if one can't be found or doesn't
+    // compile , none of that load's modules are kept then. one load() at a time
+    bool load(const Chunk& chunk, std::ostream& errors);
+    // nullptr if no load() has brought it in. safe from many VMs at once while nothing is loading
+    Module* find(const std::string& name) const;
+    size_t size() const { return this->modules.size(); }
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<Module>> modules;
+
+    bool resolve(const std::string& name, std::string& path) const;
+    std::string cachePath(const Module& module, size_t sourceBytes) const;
+    bool build(Module& module, std::string& diagnostics) const;
+};
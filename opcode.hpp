@@ -21,4 +21,67 @@ enum class Opcode : int {
     OP_SET_GLOBAL,     // Set a global variable value
     OP_POP,            // Pop value from stack
     OP_PRINT,          // Print statement
+    // Unchecked numeric variants , only emitted by the type pass when both operands are known numbers
+    OP_NEGATE_NUM,
+    OP_ADD_NUM,
+    OP_SUBTRACT_NUM,
+    OP_MULTIPLY_NUM,
+    OP_DIVIDE_NUM,
+    OP_GREATER_NUM,
+    OP_LESSER_NUM,
+    OP_YIELD,          // hand control back to the host , see VM::run
+    // arrays , see array.hpp
+    OP_ARRAY,          // push an empty array
+    OP_APPEND,         // pop an element onto the array below it
+    OP_SUM,
+    OP_MIN,
+    OP_MAX,
+    OP_DOT,
+    OP_LENGTH,
+    OP_RANGE,          // n -> [0 , 1 , ... n - 1]
+    OP_IMPORT,         // run a module's top level , the first time this VM imports it. see modules.hpp
+    OP_BREAK,          // breakpoint trap , only ever patched into a debugger's copy of a chunk
 };
+
+//how an instruction changes the stack depth
+inline int stackEffect(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::OP_CONSTANT:
+        case Opcode::OP_NIL:
+        case Opcode::OP_TRUE:
+        case Opcode::OP_FALSE:
+        case Opcode::OP_GET_GLOBAL:
+        case Opcode::OP_ARRAY:
+            return 1;
+        case Opcode::OP_NEGATE:
+        case Opcode::OP_NEGATE_NUM:
+        case Opcode::OP_NOT:
+        case Opcode::OP_SET_GLOBAL:
+        case Opcode::OP_RETURN:
+        case Opcode::OP_YIELD:
+        case Opcode::OP_SUM:
+        case Opcode::OP_MIN:
+        case Opcode::OP_MAX:
+        case Opcode::OP_LENGTH:
+        case Opcode::OP_RANGE:
+        case Opcode::OP_IMPORT:
+        case Opcode::OP_BREAK:
+            return 0;
+        default:
+            return -1; //binary operators , define , pop , print , append
+    }
+}
+
+//how many slots an instruction takes in the code array (opcode + operand)
+inline int opcodeLength(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::OP_CONSTANT:
+        case Opcode::OP_DEFINE_GLOBAL:
+        case Opcode::OP_GET_GLOBAL:
+        case Opcode::OP_SET_GLOBAL:
+        case Opcode::OP_IMPORT:
+            return 2;
+        default:
+            return 1;
+    }
+}
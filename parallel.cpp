@@ -0,0 +1,116 @@
+#include "parallel.hpp"
+#include <thread>
+
+void ParallelBatch::initParallel(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    this->threads = std::max(1u, threads);
+    this->prototype.clearBindings();
+}
+
+void ParallelBatch::bind(const std::string& name, const double* values) {
+    this->prototype.bind(name, values);
+}
+
+void ParallelBatch::bind(const std::string& name, const bool* values) {
+    this->prototype.bind(name, values);
+}
+
+void ParallelBatch::bindScalar(const std::string& name, const Value& value) {
+    this->prototype.bindScalar(name, value);
+}
+
+void ParallelBatch::clearBindings() {
+    this->prototype.clearBindings();
+}
+
+InterpretResult ParallelBatch::run(Chunk* chunk, size_t rows) {
+    std::vector<Morsel> morsels;
+    for (size_t first = 0; first < rows; first += MORSEL_ROWS) {
+        Morsel morsel;
+        morsel.firstRow = first;
+        morsel.rows = std::min(MORSEL_ROWS, rows - first);
+        morsels.push_back(std::move(morsel));
+    }
+
+    // contiguous shares , so without stealing every worker walks its own part of the inputs in order
+    unsigned workers = static_cast<unsigned>(std::min<size_t>(this->threads, std::max<size_t>(1, morsels.size())));
+    std::vector<Queue> queues(workers);
+    for (size_t m = 0; m < morsels.size(); m++) {
+        queues[m * workers / morsels.size()].morsels.push_back(m);
+    }
+
+    std::atomic<bool> failed(false);
+    std::atomic<size_t> stolen(0);
+    std::vector<std::thread> pool;
+    for (unsigned worker = 1; worker < workers; worker++) {
+        pool.emplace_back(&ParallelBatch::work, this, worker, chunk, std::ref(morsels), std::ref(queues),
+                          std::ref(failed), std::ref(stolen));
+    }
+    work(0, chunk, morsels, queues, failed, stolen); //the calling thread is worker 0
+    for (std::thread& thread : pool) thread.join();
+    this->steals = stolen.load();
+
+    // merge in row order. rows share their types , so when anything failed the first morsel that
+    // ran reports the same error a single BatchVM would have
+    this->results.clear();
+    this->printed.clear();
+    if (failed.load()) {
+        for (Morsel& morsel : morsels) {
+            if (morsel.done && morsel.result != InterpretResult::INTERPRET_OK) {
+                *this->prototype.errorOutput << morsel.error;
+                return morsel.result;
+            }
+        }
+    }
+    for (Morsel& morsel : morsels) {
+        for (auto& result : morsel.results) {
+            result.second.appendTo(this->results[result.first], result.second.rows);
+        }
+        if (this->printed.size() < morsel.printed.size()) this->printed.resize(morsel.printed.size());
+        for (size_t k = 0; k < morsel.printed.size(); k++) {
+            morsel.printed[k].appendTo(this->printed[k], morsel.printed[k].rows);
+        }
+    }
+    return InterpretResult::INTERPRET_OK;
+}
+
+void ParallelBatch::work(unsigned worker, Chunk* chunk, std::vector<Morsel>& morsels, std::vector<Queue>& queues,
+                         std::atomic<bool>& failed, std::atomic<size_t>& stolen) {
+    BatchVM vm = this->prototype;
+    std::ostringstream errors;
+    vm.errorOutput = &errors;
+    unsigned workers = static_cast<unsigned>(queues.size());
+
+    while (!failed.load(std::memory_order_relaxed)) {
+        size_t index = morsels.size();
+        {
+            Queue& own = queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.morsels.empty()) {
+                index = own.morsels.front();
+                own.morsels.pop_front();
+            }
+        }
+        for (unsigned offset = 1; index == morsels.size() && offset < workers; offset++) {
+            Queue& victim = queues[(worker + offset) % workers];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.morsels.empty()) {
+                index = victim.morsels.back();
+                victim.morsels.pop_back();
+                stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (index == morsels.size()) return; //nothing left anywhere
+
+        Morsel& morsel = morsels[index];
+        morsel.result = vm.run(chunk, morsel.firstRow, morsel.rows);
+        morsel.done = true;
+        if (morsel.result != InterpretResult::INTERPRET_OK) {
+            morsel.error = errors.str();
+            failed.store(true);
+            return;
+        }
+        morsel.results = std::move(vm.results);
+        morsel.printed = std::move(vm.printed);
+    }
+}
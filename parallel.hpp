@@ -0,0 +1,48 @@
+#pragma once
+#include "common.hpp"
+#include "batch.hpp"
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+// splits a batch evaluation across threads. the row range is cut into morsels of MORSEL_ROWS ,
+// every worker gets a contiguous share of them in its own queue and a private BatchVM (stack and
+// globals) over the same read only Chunk. a worker that runs out steals from the back of someone
+// else's queue , so a slow thread doesn't hold the whole run back.
+// outputs of each morsel are kept apart and concatenated in row order at the end.
+class ParallelBatch {
+public:
+    static constexpr size_t MORSEL_ROWS = 16 * BatchVM::BLOCK_SIZE;
+
+    unsigned threads = 1;
+    std::unordered_map<std::string, Column> results; //same layout as BatchVM::results
+    std::vector<Column> printed;
+    size_t steals = 0;                               //morsels run by a worker other than their owner , last run
+
+    void initParallel(unsigned threads = 0);         //0 = one per hardware thread
+    void bind(const std::string& name, const double* values);
+    void bind(const std::string& name, const bool* values);
+    void bindScalar(const std::string& name, const Value& value);
+    void clearBindings();
+
+    InterpretResult run(Chunk* chunk, size_t rows);
+
+private:
+    struct Morsel {
+        size_t firstRow;
+        size_t rows;
+        bool done = false;
+        InterpretResult result = InterpretResult::INTERPRET_OK;
+        std::string error;
+        std::unordered_map<std::string, Column> results;
+        std::vector<Column> printed;
+    };
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> morsels;
+    };
+    BatchVM prototype; //holds the bindings , copied into every worker
+
+    void work(unsigned worker, Chunk* chunk, std::vector<Morsel>& morsels, std::vector<Queue>& queues,
+              std::atomic<bool>& failed, std::atomic<size_t>& stolen);
+};
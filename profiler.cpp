@@ -0,0 +1,245 @@
+#include "profiler.hpp"
+
+#ifdef CLOX_PROFILE
+#include "chunk.hpp"
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t readCycles() {
+    return __rdtsc();
+}
+#else
+#include <chrono>
+static inline uint64_t readCycles() { //no time stamp counter , nanoseconds will do
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+std::string getString(Opcode opcode); //vm.cpp
+
+// every thread's counters , never freed so the report can read them after the threads are gone
+static std::mutex profilesLock;
+static std::vector<ThreadProfile*> profiles;
+
+static ThreadProfile* threadProfile() {
+    thread_local ThreadProfile* profile = nullptr;
+    if (profile == nullptr) {
+        profile = new ThreadProfile();
+        std::lock_guard<std::mutex> guard(profilesLock);
+        profiles.push_back(profile);
+    }
+    return profile;
+}
+
+ChunkSites* ThreadProfile::sitesFor(const Chunk* chunk) {
+    for (ChunkSites& sites : this->chunks) {
+        if (sites.chunk == chunk && sites.code == chunk->code) return &sites;
+    }
+    this->chunks.push_back(ChunkSites{chunk, chunk->code, chunk->lines,
+                                      std::vector<uint64_t>(chunk->code.size()),
+                                      std::vector<uint64_t>(chunk->code.size())});
+    return &this->chunks.back();
+}
+
+ProfileCursor::ProfileCursor(const Chunk* chunk) {
+    this->profile = threadProfile();
+    this->sites = this->profile->sitesFor(chunk);
+}
+
+ProfileCursor::~ProfileCursor() {
+    if (this->offset >= 0) charge(readCycles());
+}
+
+void ProfileCursor::charge(uint64_t now) {
+    uint64_t spent = now - this->started;
+    int op = static_cast<int>(this->opcode);
+    this->profile->counts[op]++;
+    this->profile->cycles[op] += spent;
+    this->sites->counts[this->offset]++;
+    this->sites->cycles[this->offset] += spent;
+}
+
+void ProfileCursor::step(int offset, Opcode opcode) {
+    uint64_t now = readCycles();
+    if (this->offset >= 0) {
+        charge(now);
+        this->profile->pairs[static_cast<int>(this->opcode)][static_cast<int>(opcode)]++;
+    }
+    this->offset = offset;
+    this->opcode = opcode;
+    this->started = readCycles(); //leave our own bookkeeping out of the next instruction's time
+}
+
+// ------ REPORT ------
+
+namespace {
+
+struct Totals {
+    uint64_t counts[OPCODE_COUNT] = {};
+    uint64_t cycles[OPCODE_COUNT] = {};
+    uint64_t pairs[OPCODE_COUNT][OPCODE_COUNT] = {};
+    std::vector<ChunkSites> chunks; //same code and lines from several threads are merged
+    uint64_t totalCycles = 0;
+};
+
+struct Site {
+    size_t chunk;
+    size_t offset;
+    uint64_t count;
+    uint64_t cycles;
+};
+
+struct Pair {
+    int first;
+    int second;
+    uint64_t count;
+};
+
+Totals merge() {
+    Totals totals;
+    std::lock_guard<std::mutex> guard(profilesLock);
+    for (ThreadProfile* profile : profiles) {
+        for (int op = 0; op < OPCODE_COUNT; op++) {
+            totals.counts[op] += profile->counts[op];
+            totals.cycles[op] += profile->cycles[op];
+            totals.totalCycles += profile->cycles[op];
+            for (int next = 0; next < OPCODE_COUNT; next++) {
+                totals.pairs[op][next] += profile->pairs[op][next];
+            }
+        }
+        for (ChunkSites& sites : profile->chunks) {
+            ChunkSites* into = nullptr;
+            for (ChunkSites& merged : totals.chunks) {
+                if (merged.code == sites.code && merged.lines == sites.lines) into = &merged;
+            }
+            if (into == nullptr) {
+                totals.chunks.push_back(sites);
+                continue;
+            }
+            for (size_t offset = 0; offset < sites.code.size(); offset++) {
+                into->counts[offset] += sites.counts[offset];
+                into->cycles[offset] += sites.cycles[offset];
+            }
+        }
+    }
+    return totals;
+}
+
+std::vector<Site> hotSites(const Totals& totals) {
+    std::vector<Site> sites;
+    for (size_t chunk = 0; chunk < totals.chunks.size(); chunk++) {
+        const ChunkSites& profile = totals.chunks[chunk];
+        for (size_t offset = 0; offset < profile.code.size(); offset++) {
+            if (profile.counts[offset] > 0) {
+                sites.push_back(Site{chunk, offset, profile.counts[offset], profile.cycles[offset]});
+            }
+        }
+    }
+    std::sort(sites.begin(), sites.end(), [](const Site& a, const Site& b) { return a.cycles > b.cycles; });
+    return sites;
+}
+
+std::vector<Pair> hotPairs(const Totals& totals) {
+    std::vector<Pair> pairs;
+    for (int first = 0; first < OPCODE_COUNT; first++) {
+        for (int second = 0; second < OPCODE_COUNT; second++) {
+            if (totals.pairs[first][second] > 0) pairs.push_back(Pair{first, second, totals.pairs[first][second]});
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.count > b.count; });
+    return pairs;
+}
+
+std::vector<int> opcodesByCycles(const Totals& totals) {
+    std::vector<int> order;
+    for (int op = 0; op < OPCODE_COUNT; op++) {
+        if (totals.counts[op] > 0) order.push_back(op);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return totals.cycles[a] > totals.cycles[b]; });
+    return order;
+}
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole == 0 ? 0 : 100.0 * part / whole;
+}
+
+}
+
+void writeProfileReport(std::ostream& out) {
+    Totals totals = merge();
+    const size_t shown = 20;
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+
+    out << "== opcodes by cycles ==\n";
+    out << std::left << std::setw(20) << "opcode" << std::right << std::setw(14) << "count" << std::setw(16)
+        << "cycles" << std::setw(10) << "cyc/op" << std::setw(8) << "%" << "\n";
+    for (int op : opcodesByCycles(totals)) {
+        out << std::left << std::setw(20) << getString(static_cast<Opcode>(op)) << std::right << std::setw(14)
+            << totals.counts[op] << std::setw(16) << totals.cycles[op] << std::setw(10)
+            << static_cast<double>(totals.cycles[op]) / totals.counts[op] << std::setw(8)
+            << percent(totals.cycles[op], totals.totalCycles) << "\n";
+    }
+
+    out << "\n== hottest offsets ==\n";
+    out << std::left << std::setw(8) << "chunk" << std::setw(8) << "offset" << std::setw(20) << "opcode"
+        << std::setw(8) << "line" << std::right << std::setw(14) << "count" << std::setw(16) << "cycles"
+        << std::setw(8) << "%" << "\n";
+    std::vector<Site> sites = hotSites(totals);
+    for (size_t k = 0; k < sites.size() && k < shown; k++) {
+        const Site& site = sites[k];
+        const ChunkSites& chunk = totals.chunks[site.chunk];
+        out << std::left << std::setw(8) << site.chunk << std::setw(8) << site.offset << std::setw(20)
+            << getString(chunk.code[site.offset]) << std::setw(8) << chunk.lines[site.offset] << std::right
+            << std::setw(14) << site.count << std::setw(16) << site.cycles << std::setw(8)
+            << percent(site.cycles, totals.totalCycles) << "\n";
+    }
+
+    out << "\n== opcode pairs ==\n";
+    std::vector<Pair> pairs = hotPairs(totals);
+    for (size_t k = 0; k < pairs.size() && k < shown; k++) {
+        out << std::left << std::setw(20) << getString(static_cast<Opcode>(pairs[k].first)) << std::setw(20)
+            << getString(static_cast<Opcode>(pairs[k].second)) << std::right << std::setw(14) << pairs[k].count
+            << "\n";
+    }
+    out.flags(flags);
+}
+
+bool writeProfileJson(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Could not open " << path << " for writing!\n";
+        return false;
+    }
+    Totals totals = merge();
+
+    out << "{\n  \"totalCycles\": " << totals.totalCycles << ",\n  \"opcodes\": [";
+    bool first = true;
+    for (int op : opcodesByCycles(totals)) {
+        out << (first ? "\n" : ",\n") << "    {\"opcode\": \"" << getString(static_cast<Opcode>(op))
+            << "\", \"count\": " << totals.counts[op] << ", \"cycles\": " << totals.cycles[op] << "}";
+        first = false;
+    }
+    out << "\n  ],\n  \"sites\": [";
+    first = true;
+    for (const Site& site : hotSites(totals)) {
+        const ChunkSites& chunk = totals.chunks[site.chunk];
+        out << (first ? "\n" : ",\n") << "    {\"chunk\": " << site.chunk << ", \"offset\": " << site.offset
+            << ", \"opcode\": \"" << getString(chunk.code[site.offset]) << "\", \"line\": "
+            << chunk.lines[site.offset] << ", \"count\": " << site.count << ", \"cycles\": " << site.cycles << "}";
+        first = false;
+    }
+    out << "\n  ],\n  \"pairs\": [";
+    first = true;
+    for (const Pair& pair : hotPairs(totals)) {
+        out << (first ? "\n" : ",\n") << "    {\"first\": \"" << getString(static_cast<Opcode>(pair.first))
+            << "\", \"second\": \"" << getString(static_cast<Opcode>(pair.second)) << "\", \"count\": "
+            << pair.count << "}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+    return true;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#include "common.hpp"
+#include "opcode.hpp"
+#include <deque>
+
+// opcode profiler , only built with -DCLOX_PROFILE. without it none of this exists and VM::run
+// is exactly the same code as before.
+//
+// every dispatch charges the cycles since the previous one (rdtsc) to the previous instruction ,
+// per opcode and per (chunk , offset) , and counts which opcode followed which. each thread keeps
+// its own counters , they're only merged for the report , so profiling a threaded host (server ,
+// scheduler) doesn't serialize it.
+#ifdef CLOX_PROFILE
+
+class Chunk;
+
+const int OPCODE_COUNT = static_cast<int>(Opcode::OP_BREAK) + 1; //keep in sync with the last opcode
+
+struct ChunkSites {
+    const Chunk* chunk;
+    std::vector<Opcode> code; //to tell a new chunk from a reused address
+    std::vector<int> lines;
+    std::vector<uint64_t> counts;
+    std::vector<uint64_t> cycles;
+};
+
+struct ThreadProfile {
+    uint64_t counts[OPCODE_COUNT] = {};
+    uint64_t cycles[OPCODE_COUNT] = {};
+    uint64_t pairs[OPCODE_COUNT][OPCODE_COUNT] = {};
+    std::deque<ChunkSites> chunks; //a deque so a cursor's sites stay put while a nested run (an import) adds more
+
+    ChunkSites* sitesFor(const Chunk* chunk);
+};
+
+// lives for one VM::run call , charges each instruction when the next one starts
+class ProfileCursor {
+public:
+    explicit ProfileCursor(const Chunk* chunk);
+    ~ProfileCursor();
+    void step(int offset, Opcode opcode);
+
+private:
+    ThreadProfile* profile;
+    ChunkSites* sites;
+    int offset = -1;
+    Opcode opcode = Opcode::OP_RETURN;
+    uint64_t started = 0;
+
+    void charge(uint64_t now);
+};
+
+// sorted text report : opcodes by cycles , hottest offsets with their source lines , opcode pairs
+void writeProfileReport(std::ostream& out);
+// the same data as JSON , for tooling
+bool writeProfileJson(const std::string& path);
+
+#endif
@@ -0,0 +1,202 @@
+#include "records.hpp"
+#include "chunk.hpp"
+#include "vm.hpp"
+#include <charconv>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool RecordReader::open(int fd) {
+    this->fd = fd;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            madvise(address, info.st_size, MADV_SEQUENTIAL);
+            this->mapped = static_cast<const char*>(address);
+            this->mappedSize = info.st_size;
+            return true;
+        }
+    }
+    this->buffer.resize(BUFFER_SIZE);
+    return true;
+}
+
+RecordReader::~RecordReader() {
+    if (this->mapped != nullptr) {
+        munmap(const_cast<char*>(this->mapped), this->mappedSize);
+    }
+}
+
+static std::string_view trimCarriageReturn(const char* data, size_t length) {
+    if (length > 0 && data[length - 1] == '\r') length--;
+    return std::string_view(data, length);
+}
+
+bool RecordReader::next(std::string_view& record) {
+    if (this->mapped != nullptr) {
+        if (this->position >= this->mappedSize) return false;
+        const char* from = this->mapped + this->position;
+        const char* newline = static_cast<const char*>(std::memchr(from, '\n', this->mappedSize - this->position));
+        size_t length = newline ? newline - from : this->mappedSize - this->position;
+        record = trimCarriageReturn(from, length);
+        this->position += length + 1;
+        return true;
+    }
+
+    for (;;) {
+        const char* from = this->buffer.data() + this->start;
+        const char* newline = static_cast<const char*>(std::memchr(from, '\n', this->end - this->start));
+        if (newline != nullptr) {
+            record = trimCarriageReturn(from, newline - from);
+            this->start += newline - from + 1;
+            return true;
+        }
+        if (this->eof) {
+            if (this->start == this->end) return false;
+            record = trimCarriageReturn(from, this->end - this->start); //last record without a newline
+            this->start = this->end;
+            return true;
+        }
+        fill();
+    }
+}
+
+// moves the unfinished record to the front and reads more behind it , growing the buffer only
+// when a single record doesn't fit
+bool RecordReader::fill() {
+    if (this->start > 0) {
+        std::memmove(this->buffer.data(), this->buffer.data() + this->start, this->end - this->start);
+        this->end -= this->start;
+        this->start = 0;
+    }
+    if (this->end == this->buffer.size()) {
+        this->buffer.resize(this->buffer.size() * 2);
+    }
+    ssize_t count;
+    do {
+        count = read(this->fd, this->buffer.data() + this->end, this->buffer.size() - this->end);
+    } while (count < 0 && errno == EINTR);
+    if (count <= 0) {
+        this->eof = true;
+        return false;
+    }
+    this->end += count;
+    return true;
+}
+
+// ------ BINDING ------
+
+// reuses the string the global already owns instead of allocating a new one per record
+static void bindString(Value& global, std::string_view text) {
+    if (global.type == valueType::STRING) {
+        global.data.string->assign(text.data(), text.size());
+    } else {
+        global = Value(std::string(text));
+    }
+}
+
+// a whole number field binds as an integer , like a literal without a '.' would
+static void bindField(Value& global, std::string_view text) {
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+    int64_t integer;
+    auto whole = std::from_chars(first, last, integer);
+    if (!text.empty() && whole.ec == std::errc() && whole.ptr == last) {
+        global = Value(integer);
+        return;
+    }
+    double number;
+    auto parsed = std::from_chars(first, last, number);
+    if (!text.empty() && parsed.ec == std::errc() && parsed.ptr == last) {
+        global = Value(number);
+    } else {
+        bindString(global, text);
+    }
+}
+
+static void splitFields(std::string_view record, char separator, size_t limit, std::vector<std::string_view>& fields) {
+    fields.clear();
+    size_t at = 0;
+    if (separator == ' ') {
+        while (fields.size() < limit) {
+            while (at < record.size() && (record[at] == ' ' || record[at] == '\t')) at++;
+            if (at == record.size()) break;
+            size_t stop = at;
+            while (stop < record.size() && record[stop] != ' ' && record[stop] != '\t') stop++;
+            fields.push_back(record.substr(at, stop - at));
+            at = stop;
+        }
+        return;
+    }
+    if (record.empty()) return;
+    while (fields.size() < limit) {
+        size_t stop = record.find(separator, at);
+        if (stop == std::string_view::npos) {
+            fields.push_back(record.substr(at));
+            break;
+        }
+        fields.push_back(record.substr(at, stop - at));
+        at = stop + 1;
+    }
+}
+
+InterpretResult runRecords(VM& vm, Chunk* chunk, RecordReader& input, char fieldSeparator) {
+    // only pay for what the script reads
+    bool wantLine = false;
+    bool wantNR = false;
+    bool wantNF = false;
+    size_t maxField = 0;
+    const std::vector<Opcode>& code = chunk->code;
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        if (code[i] != Opcode::OP_GET_GLOBAL && code[i] != Opcode::OP_SET_GLOBAL) continue;
+        const std::string& name = *chunk->constants.ValueVector[static_cast<int>(code[i + 1])].data.string;
+        if (name == "line") wantLine = true;
+        else if (name == "NR") wantNR = true;
+        else if (name == "NF") wantNF = true;
+        else if (name.size() > 1 && name[0] == 'f' && name[1] != '0'
+                 && name.find_first_not_of("0123456789", 1) == std::string::npos) {
+            size_t field = 0;
+            auto parsed = std::from_chars(name.data() + 1, name.data() + name.size(), field);
+            if (parsed.ec == std::errc() && field <= MAX_FIELDS) maxField = std::max(maxField, field);
+            //past MAX_FIELDS it's an ordinary global
+        }
+    }
+
+    // globals are never erased , so these stay valid for the whole run
+    Value* line = wantLine ? &vm.globals["line"] : nullptr;
+    Value* recordNumber = wantNR ? &vm.globals["NR"] : nullptr;
+    Value* fieldCount = wantNF ? &vm.globals["NF"] : nullptr;
+    std::vector<Value*> fieldGlobals(maxField + 1, nullptr);
+    for (size_t k = 1; k <= maxField; k++) {
+        fieldGlobals[k] = &vm.globals["f" + std::to_string(k)];
+    }
+    size_t limit = wantNF ? SIZE_MAX : maxField;
+
+    std::vector<std::string_view> fields;
+    std::string_view record;
+    int64_t number = 0;
+    while (input.next(record)) {
+        number++;
+        if (line) bindString(*line, record);
+        if (recordNumber) *recordNumber = Value(number);
+        if (limit > 0) {
+            splitFields(record, fieldSeparator, limit, fields);
+            if (fieldCount) *fieldCount = Value(static_cast<int64_t>(fields.size()));
+            for (size_t k = 1; k <= maxField; k++) {
+                if (k <= fields.size()) {
+                    bindField(*fieldGlobals[k], fields[k - 1]);
+                } else {
+                    *fieldGlobals[k] = Value();
+                }
+            }
+        }
+        vm.stack.clear(); //a failed run can leave values behind
+        InterpretResult result = vm.interpret(chunk);
+        if (result != InterpretResult::INTERPRET_OK) {
+            return result;
+        }
+    }
+    return InterpretResult::INTERPRET_OK;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "common.hpp"
+#include "result.hpp"
+#include <string_view>
+
+class Chunk;
+class VM;
+
+// hands out newline separated records as views into its own storage , no copy per record.
+// regular files are mmap'd whole , pipes and terminals are read through a large buffer.
+// a view stays valid until the next call to next().
+class RecordReader {
+public:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    bool open(int fd);
+    bool next(std::string_view& record);
+    ~RecordReader();
+
+private:
+    int fd = -1;
+    const char* mapped = nullptr;
+    size_t mappedSize = 0;
+    size_t position = 0;
+    std::vector<char> buffer;
+    size_t start = 0;
+    size_t end = 0;
+    bool eof = false;
+
+    bool fill();
+};
+
+const size_t MAX_FIELDS = 4096; //the highest fN bound to a field
+
+// awk style driver : the chunk is compiled once and run for every record on the same VM.
+// before each run the record is bound to the globals the chunk actually reads :
+//   line    the whole record (string)
+//   NR      record number , from 1
+//   NF      number of fields
+//   f1 ...  fields , numbers when they parse as one , strings otherwise , nil when missing. only up
+//           to f<MAX_FIELDS> , a global named past that is an ordinary one
+// fields are split on runs of blanks , or on every fieldSeparator when it isn't ' '.
+// everything else in the globals (eg. totals defined by a --begin script) carries over.
+InterpretResult runRecords(VM& vm, Chunk* chunk, RecordReader& input, char fieldSeparator = ' ');
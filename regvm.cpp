@@ -0,0 +1,465 @@
+#include "regvm.hpp"
+#include "chunk.hpp"
+#include "compiler.hpp"
+#include "ir.hpp"
+
+static std::string getString(RegOp op) {
+    switch (op) {
+        case RegOp::MOVE:         return "MOVE";
+        case RegOp::DEFINE:       return "DEFINE";
+        case RegOp::CHECK:        return "CHECK";
+        case RegOp::NEGATE:       return "NEGATE";
+        case RegOp::NOT:          return "NOT";
+        case RegOp::ADD:          return "ADD";
+        case RegOp::SUBTRACT:     return "SUBTRACT";
+        case RegOp::MULTIPLY:     return "MULTIPLY";
+        case RegOp::DIVIDE:       return "DIVIDE";
+        case RegOp::EQUAL:        return "EQUAL";
+        case RegOp::GREATER:      return "GREATER";
+        case RegOp::LESSER:       return "LESSER";
+        case RegOp::NEGATE_NUM:   return "NEGATE_NUM";
+        case RegOp::ADD_NUM:      return "ADD_NUM";
+        case RegOp::SUBTRACT_NUM: return "SUBTRACT_NUM";
+        case RegOp::MULTIPLY_NUM: return "MULTIPLY_NUM";
+        case RegOp::DIVIDE_NUM:   return "DIVIDE_NUM";
+        case RegOp::GREATER_NUM:  return "GREATER_NUM";
+        case RegOp::LESSER_NUM:   return "LESSER_NUM";
+        case RegOp::PRINT:        return "PRINT";
+        case RegOp::RETURN:       return "RETURN";
+        default:                  return "UNKNOWN_OP";
+    }
+}
+
+void RegProgram::dump(std::ostream& os) {
+    for (size_t i = 0; i < this->code.size(); i++) {
+        const RegInstr& instr = this->code[i];
+        os << i << ": " << getString(instr.op);
+        for (int operand : {instr.a, instr.b, instr.c}) {
+            if (operand < 0) continue;
+            if (operand < this->globalCount) {
+                os << " g" << operand;
+            } else if (operand < this->globalCount + static_cast<int>(this->constants.size())) {
+                os << " k" << operand - this->globalCount;
+            } else {
+                os << " r" << operand;
+            }
+        }
+        os << "\n";
+    }
+}
+
+// ------ REGISTER ALLOCATION : IR -> three address code ------
+
+namespace {
+
+enum class LocKind { NONE, GLOBAL, CONSTANT, TEMP };
+
+// where a value lives , turned into a register number once the layout is known
+struct Loc {
+    LocKind kind = LocKind::NONE;
+    int index = -1;
+
+    bool operator==(const Loc& other) const { return kind == other.kind && index == other.index; }
+};
+
+struct Draft {
+    RegOp op;
+    Loc a, b, c;
+    int line;
+};
+
+RegOp checkedOp(IrOp op) {
+    switch (op) {
+        case IrOp::NEGATE:   return RegOp::NEGATE;
+        case IrOp::NOT:      return RegOp::NOT;
+        case IrOp::ADD:      return RegOp::ADD;
+        case IrOp::SUBTRACT: return RegOp::SUBTRACT;
+        case IrOp::MULTIPLY: return RegOp::MULTIPLY;
+        case IrOp::DIVIDE:   return RegOp::DIVIDE;
+        case IrOp::EQUAL:    return RegOp::EQUAL;
+        case IrOp::GREATER:  return RegOp::GREATER;
+        default:             return RegOp::LESSER;
+    }
+}
+
+RegOp uncheckedOp(RegOp op) {
+    switch (op) {
+        case RegOp::NEGATE:   return RegOp::NEGATE_NUM;
+        case RegOp::ADD:      return RegOp::ADD_NUM;
+        case RegOp::SUBTRACT: return RegOp::SUBTRACT_NUM;
+        case RegOp::MULTIPLY: return RegOp::MULTIPLY_NUM;
+        case RegOp::DIVIDE:   return RegOp::DIVIDE_NUM;
+        case RegOp::GREATER:  return RegOp::GREATER_NUM;
+        case RegOp::LESSER:   return RegOp::LESSER_NUM;
+        default:              return op;
+    }
+}
+
+}
+
+bool RegVM::translate(IrBlock& block, RegProgram& program) {
+    block.analyze();
+    std::vector<IrInstr>& instrs = block.instrs;
+    size_t count = instrs.size();
+
+    // DISCARD doesn't count as a use , the value was already computed where it was defined
+    std::vector<int> uses(count, 0);
+    for (size_t id = 0; id < count; id++) {
+        if (instrs[id].removed || instrs[id].op == IrOp::DISCARD) continue;
+        if (instrs[id].a >= 0) uses[instrs[id].a]++;
+        if (instrs[id].b >= 0) uses[instrs[id].b]++;
+    }
+
+    std::vector<Loc> where(count);
+    std::vector<Draft> drafts;
+    std::vector<Value> constants;
+    std::unordered_map<std::string, int> constantIndex;
+    std::vector<int> freeTemps;
+    int tempCount = 0;
+    std::unordered_map<int, std::vector<int>> residents; //global slot -> values whose location is that slot
+    std::unordered_map<int, bool> knownDefined;          //globals defined earlier in this program
+    int fusedStore = -1;                                 //store whose value was computed straight into the global
+
+    auto slotOf = [&](const std::string& name) {
+        auto found = this->slots.find(name);
+        if (found != this->slots.end()) return found->second;
+        int slot = static_cast<int>(this->names.size());
+        this->slots[name] = slot;
+        this->names.push_back(name);
+        return slot;
+    };
+    auto allocTemp = [&]() {
+        Loc loc{LocKind::TEMP, 0};
+        if (!freeTemps.empty()) {
+            loc.index = freeTemps.back();
+            freeTemps.pop_back();
+        } else {
+            loc.index = tempCount++;
+        }
+        return loc;
+    };
+    auto release = [&](int value) {
+        if (--uses[value] == 0 && where[value].kind == LocKind::TEMP) {
+            freeTemps.push_back(where[value].index);
+        }
+    };
+    auto emit = [&](RegOp op, Loc a, Loc b, Loc c, int line) {
+        drafts.push_back(Draft{op, a, b, c, line});
+    };
+    // a global is about to be overwritten , move anything still needed out of it first
+    auto evacuate = [&](int slot, int keep, int consumer) {
+        std::vector<int>& values = residents[slot];
+        for (int value : values) {
+            if (value == keep) continue;
+            int remaining = uses[value];
+            if (consumer >= 0) {
+                remaining -= (instrs[consumer].a == value) + (instrs[consumer].b == value);
+            }
+            if (remaining > 0) {
+                Loc temp = allocTemp();
+                emit(RegOp::MOVE, temp, where[value], Loc{}, instrs[value].line);
+                where[value] = temp;
+            }
+        }
+        values.clear();
+        if (keep >= 0 && where[keep] == Loc{LocKind::GLOBAL, slot}) {
+            values.push_back(keep);
+        }
+    };
+
+    for (size_t id = 0; id < count; id++) {
+        IrInstr& instr = instrs[id];
+        if (instr.removed) continue;
+
+        switch (instr.op) {
+            case IrOp::CONSTANT: {
+                uint64_t bits = 0;
+                if (instr.constant.type == valueType::NUMBER) {
+                    std::memcpy(&bits, &instr.constant.data.number, sizeof(bits));
+                } else if (instr.constant.type == valueType::INTEGER) {
+                    bits = static_cast<uint64_t>(instr.constant.data.integer);
+                } else if (instr.constant.type == valueType::BOOLEAN) {
+                    bits = instr.constant.data.boolean;
+                }
+                std::string key = std::to_string(static_cast<int>(instr.constant.type)) + ":" + std::to_string(bits);
+                auto found = constantIndex.find(key);
+                if (found == constantIndex.end()) {
+                    found = constantIndex.emplace(key, static_cast<int>(constants.size())).first;
+                    constants.push_back(instr.constant);
+                }
+                where[id] = Loc{LocKind::CONSTANT, found->second};
+                break;
+            }
+            case IrOp::LOAD: {
+                int slot = slotOf(instr.global);
+                where[id] = Loc{LocKind::GLOBAL, slot};
+                residents[slot].push_back(id);
+                if (instr.mayFault) {
+                    emit(RegOp::CHECK, where[id], Loc{}, Loc{}, instr.line);
+                }
+                break;
+            }
+            case IrOp::STORE: {
+                int slot = slotOf(instr.global);
+                Loc global{LocKind::GLOBAL, slot};
+                if (fusedStore == static_cast<int>(id)) {
+                    if (!instr.define && instr.mayFault) {
+                        emit(RegOp::CHECK, global, Loc{}, Loc{}, instr.line);
+                    }
+                    if (instr.define && !knownDefined[slot]) {
+                        emit(RegOp::DEFINE, global, Loc{}, Loc{}, instr.line);
+                    }
+                } else {
+                    if (!instr.define && instr.mayFault) {
+                        emit(RegOp::CHECK, global, Loc{}, Loc{}, instr.line);
+                    }
+                    evacuate(slot, instr.a, -1);
+                    if (instr.define) {
+                        if (where[instr.a] == global) {
+                            if (!knownDefined[slot]) emit(RegOp::DEFINE, global, Loc{}, Loc{}, instr.line);
+                        } else {
+                            emit(RegOp::DEFINE, global, where[instr.a], Loc{}, instr.line);
+                        }
+                    } else if (!(where[instr.a] == global)) {
+                        emit(RegOp::MOVE, global, where[instr.a], Loc{}, instr.line);
+                    }
+                }
+                knownDefined[slot] = true;
+                release(instr.a);
+                break;
+            }
+            case IrOp::PRINT:
+                emit(RegOp::PRINT, where[instr.a], Loc{}, Loc{}, instr.line);
+                release(instr.a);
+                break;
+            case IrOp::DISCARD:
+                break;
+            default: {
+                bool unary = instr.op == IrOp::NEGATE || instr.op == IrOp::NOT;
+                if (uses[id] == 0 && !instr.mayFault) {
+                    //nobody needs it and it can't fail , skip it
+                    release(instr.a);
+                    if (!unary) release(instr.b);
+                    break;
+                }
+
+                // if the only use is the very next store , compute straight into the global
+                size_t next = id + 1;
+                while (next < count && instrs[next].removed) next++;
+                bool fuse = uses[id] == 1 && next < count && instrs[next].op == IrOp::STORE
+                            && instrs[next].a == static_cast<int>(id);
+                Loc destination;
+                if (fuse) {
+                    int slot = slotOf(instrs[next].global);
+                    evacuate(slot, -1, id);
+                    destination = Loc{LocKind::GLOBAL, slot};
+                    fusedStore = next;
+                }
+
+                Loc a = where[instr.a];
+                Loc b = unary ? Loc{} : where[instr.b];
+                InferredType typeA = instrs[instr.a].type;
+                InferredType typeB = unary ? InferredType::NUMBER : instrs[instr.b].type;
+                release(instr.a);
+                if (!unary) release(instr.b);
+
+                if (!fuse) {
+                    destination = allocTemp();
+                } else {
+                    residents[destination.index].push_back(id);
+                }
+                where[id] = destination;
+                if (uses[id] == 0) {
+                    freeTemps.push_back(destination.index); //computed only for its runtime error
+                }
+
+                RegOp op = checkedOp(instr.op);
+                if (typeA == InferredType::NUMBER && typeB == InferredType::NUMBER) {
+                    op = uncheckedOp(op);
+                }
+                emit(op, destination, a, b, instr.line);
+                break;
+            }
+        }
+    }
+    emit(RegOp::RETURN, Loc{}, Loc{}, Loc{}, block.returnLine);
+
+    // now the layout is fixed : [ globals | constants | temporaries ]
+    int globalCount = static_cast<int>(this->names.size());
+    int constantCount = static_cast<int>(constants.size());
+    auto registerOf = [&](Loc loc) {
+        switch (loc.kind) {
+            case LocKind::GLOBAL:   return loc.index;
+            case LocKind::CONSTANT: return globalCount + loc.index;
+            case LocKind::TEMP:     return globalCount + constantCount + loc.index;
+            default:                return -1;
+        }
+    };
+
+    program.code.clear();
+    for (const Draft& draft : drafts) {
+        RegInstr instr;
+        instr.op = draft.op;
+        instr.a = registerOf(draft.a);
+        instr.b = registerOf(draft.b);
+        instr.c = registerOf(draft.c);
+        instr.line = draft.line;
+        program.code.push_back(instr);
+    }
+    program.constants = constants;
+    program.globalCount = globalCount;
+    program.registerCount = globalCount + constantCount + tempCount;
+    return true;
+}
+
+bool RegVM::compile(const std::string& source, RegProgram& program) {
+    Chunk chunk;
+    chunk.initChunk();
+    if (!::compile(source, &chunk, 0)) {
+        return false;
+    }
+    IrBlock block;
+    if (!block.lift(&chunk, true)) { //no suspension in this engine , a yield is a no-op
+        std::cerr << "The register engine doesn't support arrays or imports yet , run this script on the stack VM.\n";
+        return false;
+    }
+    if (this->optimizationLevel >= 2) {
+        block.forwardGlobals();
+        block.foldConstants();
+        block.eliminateCommonSubexpressions();
+        block.eliminateDeadStores();
+    }
+    return translate(block, program);
+}
+
+// ------ EXECUTION ------
+
+InterpretResult RegVM::run(RegProgram& program) {
+    int globalCount = static_cast<int>(this->names.size());
+    if (program.globalCount != globalCount) {
+        // other programs added globals since this one was compiled , shift its constants and temporaries up
+        int shift = globalCount - program.globalCount;
+        for (RegInstr& instr : program.code) {
+            if (instr.a >= program.globalCount) instr.a += shift;
+            if (instr.b >= program.globalCount) instr.b += shift;
+            if (instr.c >= program.globalCount) instr.c += shift;
+        }
+        program.globalCount = globalCount;
+        program.registerCount += shift;
+    }
+
+    int oldGlobals = static_cast<int>(this->defined.size());
+    if (static_cast<int>(this->registers.size()) < program.registerCount) {
+        this->registers.resize(program.registerCount);
+    }
+    for (int slot = oldGlobals; slot < globalCount; slot++) {
+        this->registers[slot] = Value(); //was a constant or temporary of an earlier program
+    }
+    this->defined.resize(globalCount, false);
+    for (size_t k = 0; k < program.constants.size(); k++) {
+        this->registers[globalCount + k] = program.constants[k];
+    }
+
+    Value* r = this->registers.data();
+    for (const RegInstr& instr : program.code) {
+        switch (instr.op) {
+            case RegOp::MOVE:
+                r[instr.a] = r[instr.b];
+                break;
+            case RegOp::DEFINE:
+                if (instr.b >= 0) r[instr.a] = r[instr.b];
+                this->defined[instr.a] = true;
+                break;
+            case RegOp::CHECK:
+                if (!this->defined[instr.a]) {
+                    runtimeError("Undefined variable '" + this->names[instr.a] + "'", instr.line);
+                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                }
+                break;
+            case RegOp::NEGATE:
+                if (!isNumeric(r[instr.b])) {
+                    runtimeError("You do know only numbers support '-' right?", instr.line);
+                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                }
+                r[instr.a] = r[instr.b];
+                r[instr.a].negate();
+                break;
+            case RegOp::NOT:
+                r[instr.a] = Value(r[instr.b].isFalsey());
+                break;
+            case RegOp::ADD:
+            case RegOp::SUBTRACT:
+            case RegOp::MULTIPLY:
+            case RegOp::DIVIDE:
+            case RegOp::GREATER:
+            case RegOp::LESSER: {
+                const Value& first = r[instr.b];
+                const Value& second = r[instr.c];
+                if (!isNumeric(first) || !isNumeric(second)) {
+                    runtimeError("Invalid operation for given operands", instr.line);
+                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                }
+                switch (instr.op) { //the Value operators have the integer rules , see value.hpp
+                    case RegOp::ADD:      r[instr.a] = first + second; break;
+                    case RegOp::SUBTRACT: r[instr.a] = first - second; break;
+                    case RegOp::MULTIPLY: r[instr.a] = first * second; break;
+                    case RegOp::DIVIDE:   r[instr.a] = first / second; break;
+                    case RegOp::GREATER:  r[instr.a] = Value(greaterThan(first, second)); break;
+                    default:              r[instr.a] = Value(lessThan(first, second)); break;
+                }
+                break;
+            }
+            case RegOp::EQUAL: {
+                r[instr.a] = Value(valuesEqual(r[instr.b], r[instr.c]));
+                break;
+            }
+            case RegOp::NEGATE_NUM:
+                r[instr.a] = Value(-r[instr.b].data.number);
+                break;
+            case RegOp::ADD_NUM:
+                r[instr.a] = Value(r[instr.b].data.number + r[instr.c].data.number);
+                break;
+            case RegOp::SUBTRACT_NUM:
+                r[instr.a] = Value(r[instr.b].data.number - r[instr.c].data.number);
+                break;
+            case RegOp::MULTIPLY_NUM:
+                r[instr.a] = Value(r[instr.b].data.number * r[instr.c].data.number);
+                break;
+            case RegOp::DIVIDE_NUM:
+                r[instr.a] = Value(r[instr.b].data.number / r[instr.c].data.number);
+                break;
+            case RegOp::GREATER_NUM:
+                r[instr.a] = Value(r[instr.b].data.number > r[instr.c].data.number);
+                break;
+            case RegOp::LESSER_NUM:
+                r[instr.a] = Value(r[instr.b].data.number < r[instr.c].data.number);
+                break;
+            case RegOp::PRINT:
+                r[instr.a].printValue();
+                std::cout << '\n';
+                break;
+            case RegOp::RETURN:
+                return InterpretResult::INTERPRET_OK;
+        }
+    }
+    return InterpretResult::INTERPRET_OK;
+}
+
+void RegVM::initVM() {
+    this->registers.clear();
+    this->defined.clear();
+    this->slots.clear();
+    this->names.clear();
+}
+
+InterpretResult RegVM::interpret(const std::string& source) {
+    RegProgram program;
+    if (!compile(source, program)) {
+        return InterpretResult::INTERPRET_COMPILE_ERROR;
+    }
+    return run(program);
+}
+
+void RegVM::runtimeError(std::string message, int line) {
+    std::cout << "Runtime Error: " << message << " at line " << line << std::endl;
+}
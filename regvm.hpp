@@ -0,0 +1,69 @@
+#pragma once
+#include "common.hpp"
+#include "result.hpp"
+#include "value.hpp"
+
+class IrBlock;
+
+// three address instruction set. a is the destination , b and c the sources.
+// every operand is a register number , the register file is laid out as
+// [ globals | constants | temporaries ] so reading a global or a constant is free.
+enum class RegOp : int {
+    MOVE,          // a = b
+    DEFINE,        // a = b (if b >= 0) and mark global a as defined
+    CHECK,         // runtime error if global a isn't defined yet
+    NEGATE,
+    NOT,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    EQUAL,
+    GREATER,
+    LESSER,
+    // unchecked variants , operand types were proven numbers
+    NEGATE_NUM,
+    ADD_NUM,
+    SUBTRACT_NUM,
+    MULTIPLY_NUM,
+    DIVIDE_NUM,
+    GREATER_NUM,
+    LESSER_NUM,
+    PRINT,         // print a
+    RETURN,
+};
+
+class RegInstr {
+public:
+    RegOp op;
+    int a = -1;
+    int b = -1;
+    int c = -1;
+    int line = 0;
+};
+
+class RegProgram {
+public:
+    std::vector<RegInstr> code;
+    std::vector<Value> constants;  //copied into the constant registers before running
+    int globalCount = 0;           //globals known to the VM when this was compiled
+    int registerCount = 0;
+
+    void dump(std::ostream& os);
+};
+
+class RegVM {
+public:
+    std::vector<Value> registers;
+    std::vector<bool> defined;                      //per global slot
+    std::unordered_map<std::string, int> slots;     //global name -> register , stable across programs
+    std::vector<std::string> names;                 //register -> global name , for error messages
+    int optimizationLevel = 1;                      //>= 2 runs the IR passes before register allocation
+
+    void initVM();
+    bool compile(const std::string& source, RegProgram& program);
+    bool translate(IrBlock& block, RegProgram& program);
+    InterpretResult run(RegProgram& program);
+    InterpretResult interpret(const std::string& source);
+    void runtimeError(std::string message, int line);
+};
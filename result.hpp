@@ -4,4 +4,7 @@ enum class InterpretResult : int {
     INTERPRET_OK,
     INTERPRET_COMPILE_ERROR,
     INTERPRET_RUNTIME_ERROR,
+    INTERPRET_YIELD,         //suspended , VM::run picks it up again from VM::ip
+    INTERPRET_BUDGET_EXCEEDED, //hit one of VM::limits
+    INTERPRET_BREAK,         //stopped at a breakpoint trap , VM::ip is on it. see debugger.hpp
 };
\ No newline at end of file
@@ -1,13 +1,11 @@
 #include "scanner.hpp"
 #include "token.hpp"
 
-void Scanner::initScanner(std::string source) {
-    source += '\0';
-    this->line = 1;
-    this->source = source;
-    this->start = &(this->source[0]);
-    this->current = &(this->source[0]);
-    this->end = &(this->source[source.length()-1]);
+void Scanner::initScanner(std::string_view source, int firstLine) {
+    this->line = firstLine;
+    this->start = source.data();
+    this->current = this->start;
+    this->end = this->start + source.size();
 }
 
 Token Scanner::scanToken() {
@@ -32,6 +30,8 @@ Token Scanner::scanToken() {
         case ')': return makeToken(TokenType::TOKEN_RIGHT_PAREN);
         case '{': return makeToken(TokenType::TOKEN_LEFT_BRACE);
         case '}': return makeToken(TokenType::TOKEN_RIGHT_BRACE);
+        case '[': return makeToken(TokenType::TOKEN_LEFT_BRACKET);
+        case ']': return makeToken(TokenType::TOKEN_RIGHT_BRACKET);
         case ';': return makeToken(TokenType::TOKEN_SEMICOLON);
         case ',': return makeToken(TokenType::TOKEN_COMMA);
         case '.': return makeToken(TokenType::TOKEN_DOT);
@@ -61,12 +61,12 @@ bool Scanner::isAtEnd() {
 Token Scanner::makeToken(TokenType tokenType) {
     Token token;
     token.type = tokenType;
-    token.lexeme = std::string(start, current);
+    token.lexeme = std::string_view(start, current - start);
     token.line = this->line;
     return token;
 }
 
-Token Scanner::errorToken(std::string message) {
+Token Scanner::errorToken(const char* message) {
     Token token;
     token.type = TokenType::TOKEN_ERROR;
     token.lexeme = message;
@@ -127,6 +127,7 @@ Token Scanner::string() {
     if (isAtEnd()) {
         return errorToken("close your goddamn strings bro PLEASE");
     }
+    readAndAdvance(); //the closing quote
     return makeToken(TokenType::TOKEN_STRING); //the token lexeme should have the actual string
 }
 
@@ -156,7 +157,7 @@ char Scanner::peekNext() {
     if (isAtEnd()) {
         return '\0';
     }
-    char * next = this->current;
+    const char * next = this->current;
     next++;
     return *next;
 }
@@ -192,7 +193,14 @@ TokenType Scanner::identifierType() {
                 }
             }
             break;
-        case 'i' : return checkKeyword(1 , 1 , "f" , TokenType::TOKEN_IF);
+        case 'i':
+            if (this->current - this->start > 1) {
+                switch (this->start[1]) {
+                    case 'f': return checkKeyword(2, 0, "", TokenType::TOKEN_IF);
+                    case 'm': return checkKeyword(2, 4, "port", TokenType::TOKEN_IMPORT);
+                }
+            }
+            break;
         case 'n' : return checkKeyword(1 , 2 , "il"   , TokenType::TOKEN_NIL);
         case 'o': return checkKeyword(1, 1, "r", TokenType::TOKEN_OR);
         case 'p': return checkKeyword(1, 4, "rint", TokenType::TOKEN_PRINT);
@@ -208,13 +216,14 @@ TokenType Scanner::identifierType() {
             break;
         case 'v': return checkKeyword(1, 2, "ar", TokenType::TOKEN_VAR);
         case 'w': return checkKeyword(1, 4, "hile", TokenType::TOKEN_WHILE);
+        case 'y': return checkKeyword(1, 4, "ield", TokenType::TOKEN_YIELD);
     }
     return TokenType::TOKEN_IDENTIFIER;
 }
 
-TokenType Scanner::checkKeyword(int start, int length,  std::string rest, TokenType type) {
+TokenType Scanner::checkKeyword(int start, int length,  const char* rest, TokenType type) {
     if (this->current - this->start == start + length &&
-        std::string(this->start + start, length) == rest) {
+        std::memcmp(this->start + start, rest, length) == 0) {
         return type;
         }
     return TokenType::TOKEN_IDENTIFIER;
@@ -6,16 +6,18 @@ class Token;
 
 class Scanner {
 public:
-    char * start;
-    char * current;
-    char * end;
+    const char * start;
+    const char * current;
+    const char * end;
     int line;
-    std::string source;
 
-    void initScanner(std::string source);
+    // scans source in place , it has to outlive the tokens (their lexemes point into it). the byte
+    // just past it is read (peek() at the end) and has to be one no token goes on with , eg. the
+    // '\0' a std::string ends in. line numbers count from firstLine
+    void initScanner(std::string_view source, int firstLine = 1);
     Token scanToken();
     Token makeToken(TokenType tokenType);
-    Token errorToken(std::string message);
+    Token errorToken(const char* message);
     char readAndAdvance();
     bool match(char expected);
     void skipWhiteSpace();
@@ -28,5 +30,5 @@ public:
     bool isAlpha(char c);
     Token identifier();
     TokenType identifierType();
-    TokenType checkKeyword(int start  , int length , std::string rest , TokenType type); //start is the point where we want to start as some identifiers can start with the same letter (eg -> false , for , fun)
-};
\ No newline at end of file
+    TokenType checkKeyword(int start  , int length , const char* rest , TokenType type); //start is the point where we want to start as some identifiers can start with the same letter (eg -> false , for , fun)
+};
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "scheduler.hpp"
+#include "chunk.hpp"
+#include <thread>
+
+void Scheduler::initScheduler(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    this->threads = std::max(1u, threads);
+    this->fibers.clear();
+}
+
+Fiber* Scheduler::spawn(std::shared_ptr<Chunk> chunk) {
+    std::unique_ptr<Fiber> fiber = std::make_unique<Fiber>();
+    fiber->id = this->fibers.size();
+    fiber->chunk = std::move(chunk);
+    fiber->vm.initVM();
+    fiber->vm.output = &fiber->output;
+    fiber->vm.start(fiber->chunk.get());
+    this->fibers.push_back(std::move(fiber));
+    return this->fibers.back().get();
+}
+
+void Scheduler::run() {
+    this->queues = std::vector<Queue>(this->threads);
+    size_t waiting = 0;
+    for (auto& fiber : this->fibers) {
+        if (fiber->finished) continue;
+        this->queues[waiting++ % this->threads].fibers.push_back(fiber.get());
+    }
+    this->remaining = waiting;
+    this->stolen = 0;
+
+    std::vector<std::thread> pool;
+    for (unsigned worker = 1; worker < this->threads; worker++) {
+        pool.emplace_back(&Scheduler::work, this, worker);
+    }
+    work(0);
+    for (std::thread& thread : pool) thread.join();
+    this->steals = this->stolen.load();
+}
+
+void Scheduler::work(unsigned worker) {
+    Queue& own = this->queues[worker];
+    while (this->remaining.load() > 0) {
+        Fiber* fiber = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.fibers.empty()) {
+                fiber = own.fibers.front();
+                own.fibers.pop_front();
+            }
+        }
+        for (unsigned offset = 1; fiber == nullptr && offset < this->threads; offset++) {
+            Queue& victim = this->queues[(worker + offset) % this->threads];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.fibers.empty()) {
+                fiber = victim.fibers.front();
+                victim.fibers.pop_front();
+                this->stolen++;
+            }
+        }
+        if (fiber == nullptr) {
+            std::this_thread::yield(); //the rest are running elsewhere , one of them may come back
+            continue;
+        }
+
+        fiber->slices++;
+        fiber->result = fiber->vm.run(this->quantum);
+        if (fiber->result == InterpretResult::INTERPRET_YIELD) {
+            std::lock_guard<std::mutex> guard(own.lock);
+            own.fibers.push_back(fiber);
+        } else {
+            fiber->finished = true;
+            this->remaining--;
+        }
+    }
+}
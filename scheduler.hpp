@@ -0,0 +1,48 @@
+#pragma once
+#include "common.hpp"
+#include "result.hpp"
+#include "vm.hpp"
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+class Chunk;
+
+// one script in flight : its own VM (stack , globals , ip) over a shared chunk
+class Fiber {
+public:
+    size_t id = 0;
+    VM vm;
+    std::shared_ptr<Chunk> chunk;
+    std::ostringstream output; //whatever the fiber printed
+    InterpretResult result = InterpretResult::INTERPRET_OK;
+    bool finished = false;
+    size_t slices = 0;         //how many times it got a thread
+};
+
+// multiplexes many fibers over a few OS threads. a fiber runs until it finishes , hits a yield
+// statement or has used up quantum code units , then goes to the back of its thread's queue.
+// a thread with an empty queue steals from the front of another one's , where the fibers that
+// have been waiting the longest are. a fiber never runs on two threads at once.
+class Scheduler {
+public:
+    size_t quantum = 10000; //0 = run every fiber to completion in one go
+    unsigned threads = 1;
+    std::vector<std::unique_ptr<Fiber>> fibers;
+    size_t steals = 0;      //last run
+
+    void initScheduler(unsigned threads = 0); //0 = one per hardware thread
+    Fiber* spawn(std::shared_ptr<Chunk> chunk);
+    void run(); //until every spawned fiber has finished
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Fiber*> fibers;
+    };
+    std::vector<Queue> queues;
+    std::atomic<size_t> remaining{0};
+    std::atomic<size_t> stolen{0};
+
+    void work(unsigned worker);
+};
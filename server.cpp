@@ -0,0 +1,311 @@
+#include "server.hpp"
+#include "chunk.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
+#include <cerrno>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ------ CACHE ------
+
+// FNV-1a
+uint64_t ChunkCache::hash(const std::string& source) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : source) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::shared_ptr<Chunk> ChunkCache::find(const std::string& source) {
+    uint64_t key = hash(source);
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto found = this->index.find(key);
+    if (found == this->index.end() || found->second->source != source) {
+        this->misses++;
+        return nullptr;
+    }
+    this->entries.splice(this->entries.begin(), this->entries, found->second);
+    this->hits++;
+    return found->second->chunk;
+}
+
+void ChunkCache::insert(const std::string& source, std::shared_ptr<Chunk> chunk) {
+    if (this->capacity == 0) return;
+    uint64_t key = hash(source);
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto found = this->index.find(key);
+    if (found != this->index.end()) {
+        this->entries.erase(found->second);
+    }
+    this->entries.push_front(Entry{key, source, std::move(chunk)});
+    this->index[key] = this->entries.begin();
+    while (this->entries.size() > this->capacity) {
+        this->index.erase(this->entries.back().hash);
+        this->entries.pop_back();
+    }
+}
+
+// ------ WIRE ------
+
+static bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t count = send(fd, data, length, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        data += count;
+        length -= count;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* data, size_t length) {
+    while (length > 0) {
+        ssize_t count = read(fd, data, length);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        data += count;
+        length -= count;
+    }
+    return true;
+}
+
+bool writeMessage(int fd, char tag, const std::string& payload) {
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    char header[5] = {tag, static_cast<char>(length), static_cast<char>(length >> 8),
+                      static_cast<char>(length >> 16), static_cast<char>(length >> 24)};
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, payload.data(), payload.size());
+}
+
+bool readMessage(int fd, char& tag, std::string& payload) {
+    unsigned char header[5];
+    if (!readAll(fd, reinterpret_cast<char*>(header), sizeof(header))) return false;
+    uint32_t length = header[1] | header[2] << 8 | header[3] << 16 | static_cast<uint32_t>(header[4]) << 24;
+    if (length > (64u << 20)) return false; //nobody sends a 64 MB script , drop the connection
+    tag = static_cast<char>(header[0]);
+    payload.resize(length);
+    return readAll(fd, &payload[0], length);
+}
+
+static bool socketAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connectServer(const std::string& path) {
+    sockaddr_un address;
+    if (!socketAddress(path, address)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ------ SERVER ------
+
+bool Server::initServer(const std::string& path, unsigned workers) {
+    if (workers == 0) workers = std::thread::hardware_concurrency();
+    this->workers = std::max(1u, workers);
+    this->path = path;
+    this->stopping = false;
+
+    sockaddr_un address;
+    if (!socketAddress(path, address)) {
+        std::cerr << "Socket path too long: " << path << "\n";
+        return false;
+    }
+    this->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (this->listenFd < 0) {
+        std::cerr << "Could not create socket: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    unlink(path.c_str()); //a socket file left behind by a previous run
+    if (bind(this->listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || listen(this->listenFd, 128) < 0) {
+        std::cerr << "Could not listen on " << path << ": " << std::strerror(errno) << "\n";
+        close(this->listenFd);
+        this->listenFd = -1;
+        return false;
+    }
+    if (pipe2(this->wake, O_NONBLOCK | O_CLOEXEC) < 0) {
+        std::cerr << "Could not create a pipe: " << std::strerror(errno) << "\n";
+        close(this->listenFd);
+        this->listenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+// a byte down the wake pipe gets serve() out of poll() , a full pipe will already
+static void wakeUp(int fd) {
+    char byte = 0;
+    ssize_t written = write(fd, &byte, 1);
+    (void)written;
+}
+
+void Server::serve() {
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < this->workers; i++) {
+        pool.emplace_back(&Server::work, this);
+    }
+    std::vector<int> idle; //connections waiting for their client's next request
+    std::vector<pollfd> polled;
+    while (!this->stopping) {
+        polled.clear();
+        polled.push_back({this->listenFd, POLLIN, 0});
+        polled.push_back({this->wake[0], POLLIN, 0});
+        for (int fd : idle) polled.push_back({fd, POLLIN, 0});
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        // a readable connection goes to the workers , hangups too : their read fails and closes it
+        std::vector<int> waiting;
+        size_t kept = 0;
+        for (size_t i = 2; i < polled.size(); i++) {
+            if (polled[i].revents != 0) {
+                waiting.push_back(polled[i].fd);
+            } else {
+                idle[kept++] = polled[i].fd;
+            }
+        }
+        idle.resize(kept);
+        if (polled[1].revents != 0) {
+            char drained[64];
+            while (read(this->wake[0], drained, sizeof(drained)) > 0) {}
+        }
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            for (int fd : waiting) {
+                this->pending.push_back(fd);
+                this->ready.notify_one();
+            }
+            idle.insert(idle.end(), this->served.begin(), this->served.end());
+            this->served.clear();
+        }
+        if (polled[0].revents != 0) {
+            int fd = accept4(this->listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                std::lock_guard<std::mutex> guard(this->lock);
+                this->open.insert(fd);
+                idle.push_back(fd);
+            } else if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+                break;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = true;
+        this->ready.notify_all();
+    }
+    for (std::thread& thread : pool) thread.join();
+    idle.insert(idle.end(), this->pending.begin(), this->pending.end());
+    idle.insert(idle.end(), this->served.begin(), this->served.end());
+    for (int fd : idle) close(fd);
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->pending.clear();
+    this->served.clear();
+    this->open.clear();
+    close(this->wake[0]);
+    close(this->wake[1]);
+    this->wake[0] = this->wake[1] = -1;
+    close(this->listenFd);
+    this->listenFd = -1;
+    unlink(this->path.c_str());
+}
+
+void Server::stop() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->stopping = true;
+    for (int fd : this->open) shutdown(fd, SHUT_RDWR); //wakes a worker blocked reading or writing it
+    this->ready.notify_all();
+    if (this->wake[1] >= 0) wakeUp(this->wake[1]);
+}
+
+void Server::work() {
+    VM vm;
+    vm.initVM();
+    for (;;) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->ready.wait(guard, [this] { return this->stopping || !this->pending.empty(); });
+            if (this->stopping) return; //serve() closes what's still queued
+            fd = this->pending.front();
+            this->pending.pop_front();
+        }
+        if (!handle(vm, fd)) {
+            drop(fd);
+            continue;
+        }
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->served.push_back(fd);
+        wakeUp(this->wake[1]);
+    }
+}
+
+bool Server::handle(VM& vm, int fd) {
+    char tag;
+    std::string payload;
+    if (this->stopping || !readMessage(fd, tag, payload)) return false;
+    std::ostringstream output;
+    InterpretResult result = execute(vm, tag, payload, output);
+    return writeMessage(fd, static_cast<char>('0' + static_cast<int>(result)), output.str());
+}
+
+// closed under the lock , so stop() never shuts down a descriptor number that's been reused
+void Server::drop(int fd) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->open.erase(fd);
+    close(fd);
+}
+
+InterpretResult Server::execute(VM& vm, char kind, const std::string& payload, std::ostream& output) {
+    std::string source;
+    if (kind == 'S') {
+        source = payload;
+    } else if (kind == 'F') {
+        std::ifstream file(payload, std::ios::binary);
+        if (!file) {
+            output << "Could not open file \"" << payload << "\".\n";
+            return InterpretResult::INTERPRET_COMPILE_ERROR;
+        }
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+        source = buffer.str(); //keyed by content , an edited file is simply a new entry
+    } else {
+        output << "Unknown request type '" << kind << "'\n";
+        return InterpretResult::INTERPRET_COMPILE_ERROR;
+    }
+
+    std::shared_ptr<Chunk> chunk = this->cache.find(source);
+    if (!chunk) {
+        chunk = std::make_shared<Chunk>();
+        chunk->initChunk();
+        if (!compile(source, chunk.get(), this->optimizationLevel, &output)) {
+            return InterpretResult::INTERPRET_COMPILE_ERROR;
+        }
+        this->cache.insert(source, chunk);
+    }
+
+    vm.initVM();
+    vm.limits = this->limits;
+    vm.output = &output;
+    InterpretResult result = vm.interpret(chunk.get());
+    vm.output = &std::cout;
+    return result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "common.hpp"
+#include "result.hpp"
+#include "vm.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_set>
+
+class Chunk;
+
+// compiled chunks keyed by a hash of their source , the least recently used one is dropped once
+// there are more than capacity. chunks are shared read only between VMs.
+class ChunkCache {
+public:
+    size_t capacity = 64;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    std::shared_ptr<Chunk> find(const std::string& source); //nullptr on a miss
+    void insert(const std::string& source, std::shared_ptr<Chunk> chunk);
+    static uint64_t hash(const std::string& source);
+
+private:
+    struct Entry {
+        uint64_t hash;
+        std::string source; //compared on lookup , a hash collision is just a miss
+        std::shared_ptr<Chunk> chunk;
+    };
+    std::mutex lock;
+    std::list<Entry> entries; //most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+};
+
+// wire format , both directions : 1 byte tag , 4 byte little endian length , payload.
+// requests  : 'S' the payload is script source , 'F' it's the path of a script on the server's side
+// responses : '0' + InterpretResult , the payload is everything the script printed (errors included)
+// a connection can carry any number of requests , one at a time.
+bool writeMessage(int fd, char tag, const std::string& payload);
+bool readMessage(int fd, char& tag, std::string& payload);
+int connectServer(const std::string& path); //-1 on failure
+
+// clox --serve=path : listens on a Unix domain socket. serve() polls every open connection and
+// queues the ones with a request waiting , every worker thread owns one VM and takes them off the
+// queue one request at a time , so a client holds a worker only while its request runs , not while
+// it sits idle. the VM's globals are reset before each request so requests never see each other's
+// state , and its output goes to a buffer that becomes the response.
+class Server {
+public:
+    ChunkCache cache;
+    int optimizationLevel = 1;
+    VM::Limits limits;       //applied to every request
+
+    bool initServer(const std::string& path, unsigned workers = 0); //0 = one per hardware thread
+    void serve();  //blocks until stop()
+    void stop();   //from any thread , shuts open connections down , serve() returns once requests in flight are done
+    InterpretResult execute(VM& vm, char kind, const std::string& payload, std::ostream& output);
+
+private:
+    std::string path;
+    int listenFd = -1;
+    unsigned workers = 1;
+    std::atomic<bool> stopping{false};
+    std::mutex lock;
+    std::condition_variable ready;
+    int wake[2] = {-1, -1};  //a pipe , written to get serve() out of poll()
+    std::deque<int> pending; //connections with a request waiting , for the workers
+    std::vector<int> served; //connections a worker answered , going back to serve() to be polled again
+    std::unordered_set<int> open; //every accepted connection not closed yet , stop() shuts them down
+
+    void work();
+    bool handle(VM& vm, int fd); //one request , false once the connection is done with
+    void drop(int fd);
+};
@@ -0,0 +1,90 @@
+#include "session.hpp"
+#include "compiler.hpp"
+#include "value.hpp"
+#include "vm.hpp"
+#include "modules.hpp"
+
+void Session::initSession(VM* vm) {
+    this->vm = vm;
+    this->chunk.initChunk();
+    this->names.clear();
+    this->numbers.clear();
+    this->integers.clear();
+    this->segments = 0;
+}
+
+int Session::intern(const Value& value) {
+    if (value.type == valueType::STRING) {
+        auto found = this->names.find(*value.data.string);
+        if (found != this->names.end()) return found->second;
+        int index = static_cast<int>(this->chunk.constants.ValueVector.size());
+        this->chunk.constants.ValueVector.push_back(value);
+        this->names.emplace(*value.data.string, index);
+        return index;
+    }
+    if (value.type == valueType::NUMBER || value.type == valueType::INTEGER) {
+        // separate tables , 1 and 1.0 share no bits but are different constants all the same
+        auto& table = value.type == valueType::NUMBER ? this->numbers : this->integers;
+        uint64_t bits;
+        std::memcpy(&bits, &value.data, sizeof(bits));
+        auto found = table.find(bits);
+        if (found != table.end()) return found->second;
+        int index = static_cast<int>(this->chunk.constants.ValueVector.size());
+        this->chunk.constants.ValueVector.push_back(value);
+        table.emplace(bits, index);
+        return index;
+    }
+    int index = static_cast<int>(this->chunk.constants.ValueVector.size());
+    this->chunk.constants.ValueVector.push_back(value);
+    return index;
+}
+
+InterpretResult Session::execute(const std::string& source) {
+    Chunk input;
+    input.initChunk();
+    if (!compile(source, &input, this->vm->optimizationLevel)) {
+        return InterpretResult::INTERPRET_COMPILE_ERROR;
+    }
+    if (this->vm->modules != nullptr && !this->vm->modules->load(input, std::cerr)) {
+        return InterpretResult::INTERPRET_COMPILE_ERROR;
+    }
+
+    // the input's constants , renumbered into the session pool
+    std::vector<int> remap(input.constants.ValueVector.size());
+    for (size_t k = 0; k < remap.size(); k++) {
+        remap[k] = intern(input.constants.ValueVector[k]);
+    }
+    if (this->chunk.constants.ValueVector.size() > static_cast<size_t>(MAX_CONSTANTS)) {
+        *this->vm->output << "Too many constants in the session.\n";
+        return InterpretResult::INTERPRET_COMPILE_ERROR;
+    }
+
+    // every segment ends where the next one starts , so the input's OP_RETURN is left out
+    size_t start = this->chunk.code.size();
+    size_t end = input.code.size();
+    if (end > 0 && input.code[end - 1] == Opcode::OP_RETURN) end--;
+    for (size_t i = 0; i < end; i += opcodeLength(input.code[i])) {
+        this->chunk.code.push_back(input.code[i]);
+        this->chunk.lines.push_back(input.lines[i]);
+        if (opcodeLength(input.code[i]) == 2) {
+            this->chunk.code.push_back(static_cast<Opcode>(remap[static_cast<int>(input.code[i + 1])]));
+            this->chunk.lines.push_back(input.lines[i + 1]);
+        }
+    }
+    this->chunk.revision = nextRevision(); //appended without writeChunk , JIT code for what was there is stale
+    // renumbering keeps every check the verifier made on the input , and statements leave the
+    // stack as they found it , so the session stays verified without walking it again
+    this->chunk.verified = true;
+    this->chunk.maxStack = std::max(this->chunk.maxStack, input.maxStack);
+    this->segments++;
+
+    this->vm->chunk = &this->chunk;
+    this->vm->ip = start;
+    this->vm->stack.reserve(this->vm->stack.size() + input.maxStack);
+    this->vm->startLimits();
+    InterpretResult result;
+    do {
+        result = this->vm->run();
+    } while (result == InterpretResult::INTERPRET_YIELD);
+    return result;
+}
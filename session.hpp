@@ -0,0 +1,31 @@
+#pragma once
+#include "common.hpp"
+#include "chunk.hpp"
+#include "result.hpp"
+
+class VM;
+
+// an incremental REPL session : one chunk that grows by one segment per input instead of a fresh
+// chunk per line. each input is compiled on its own (so optimization and verification only see the
+// new code) , then appended with its constants merged into the session's pool , names and numbers
+// interned so a global used on every line is stored once. the VM carries on from the end of the
+// previous segment , globals , stack and limits work as they do for one long script.
+// per-line cost only depends on the line , not on how long the session has been running.
+class Session {
+public:
+    Chunk chunk;
+    size_t segments = 0; //inputs appended so far
+
+    void initSession(VM* vm);
+    // compile errors leave the session as it was , a runtime error keeps the segment (whatever ran
+    // before the error has happened) and the next input carries on after it
+    InterpretResult execute(const std::string& source);
+
+private:
+    VM* vm = nullptr;
+    std::unordered_map<std::string, int> names;
+    std::unordered_map<uint64_t, int> numbers; //by bit pattern , so -0 and 0 stay apart
+    std::unordered_map<uint64_t, int> integers;
+
+    int intern(const Value& value);
+};
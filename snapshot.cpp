@@ -0,0 +1,405 @@
+#include "snapshot.hpp"
+#include "chunk.hpp"
+#include "value.hpp"
+#include "vm.hpp"
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[8] = {'C', 'L', 'O', 'X', 'S', 'N', 'A', 'P'};
+const uint32_t VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const uint32_t NO_NAME = UINT32_MAX; //constants aren't named
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t fileSize;
+    uint64_t strings;
+    uint64_t globals;
+    uint64_t buckets;
+    uint64_t chunks;
+    uint32_t stringCount;
+    uint32_t globalCount;
+    uint32_t bucketCount;
+    uint32_t chunkCount;
+};
+
+struct StringRecord {
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct StoredValue {
+    uint32_t name;    //string id , NO_NAME for a constant
+    uint32_t type;    //valueType
+    uint64_t payload; //the double's bits , the integer , the boolean , a string id or an array's offset
+};
+
+struct Bucket {
+    uint32_t entry; //index + 1 , 0 = empty
+    uint32_t hash;  //low bits of the name's hash , so a probe rarely has to look at the name
+};
+
+struct ChunkRecord {
+    uint64_t code;
+    uint64_t codeCount;
+    uint64_t lines;
+    uint64_t constants;
+    uint64_t constantCount;
+};
+
+// [offset , offset + count * width) lies inside a file of size bytes , without overflowing. anything
+// but string bytes was written 8 byte aligned and is read in place , so it has to still be
+bool inside(uint64_t offset, uint64_t count, uint64_t width, size_t size) {
+    return offset <= size && count <= (size - offset) / width && (width == 1 || offset % 8 == 0);
+}
+
+template <typename T>
+const T* at(const char* base, uint64_t offset) {
+    return reinterpret_cast<const T*>(base + offset);
+}
+
+// the file as it's built , sections are appended and patched into the header at the end
+class Writer {
+public:
+    std::vector<char> bytes;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> strings;
+
+    Writer() : bytes(sizeof(Header), 0) {}
+
+    uint64_t align() {
+        this->bytes.resize((this->bytes.size() + 7) / 8 * 8, 0);
+        return this->bytes.size();
+    }
+
+    uint64_t append(const void* data, size_t length) {
+        uint64_t offset = this->bytes.size();
+        const char* from = static_cast<const char*>(data);
+        this->bytes.insert(this->bytes.end(), from, from + length);
+        return offset;
+    }
+
+    uint32_t intern(const std::string& text) {
+        auto found = this->ids.find(text);
+        if (found != this->ids.end()) return found->second;
+        uint32_t id = static_cast<uint32_t>(this->strings.size());
+        this->ids.emplace(text, id);
+        this->strings.push_back(text);
+        return id;
+    }
+
+    // arrays go into the data section straight away , everything else fits in the payload
+    StoredValue store(uint32_t name, const Value& value) {
+        StoredValue stored{name, static_cast<uint32_t>(value.type), 0};
+        switch (value.type) {
+            case valueType::NUMBER:  std::memcpy(&stored.payload, &value.data.number, sizeof(double)); break;
+            case valueType::INTEGER: std::memcpy(&stored.payload, &value.data.integer, sizeof(int64_t)); break;
+            case valueType::BOOLEAN: stored.payload = value.data.boolean ? 1 : 0; break;
+            case valueType::STRING:  stored.payload = intern(*value.data.string); break;
+            case valueType::ARRAY: {
+                uint64_t length = value.data.array->length;
+                stored.payload = align();
+                append(&length, sizeof(length));
+                append(value.data.array->elements, length * sizeof(double));
+                break;
+            }
+            default: break;
+        }
+        return stored;
+    }
+};
+
+} // namespace
+
+uint64_t hashBytes(std::string_view bytes) {
+    uint64_t hash = 14695981039346656037ull; //FNV-1a
+    for (char c : bytes) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// ------ WRITING ------
+
+bool writeSnapshot(const std::string& path, const VM& vm, const std::vector<const Chunk*>& chunks,
+                   std::string& error) {
+    Writer writer;
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+
+    // the VM's own globals shadow whatever its snapshot still has under the same name
+    std::vector<std::pair<std::string, Value>> globals(vm.globals.begin(), vm.globals.end());
+    if (vm.snapshot != nullptr) {
+        std::string name;
+        for (size_t index = 0; index < vm.snapshot->globalCount(); index++) {
+            Value value;
+            if (vm.snapshot->global(index, name, value) && vm.globals.find(name) == vm.globals.end()) {
+                globals.emplace_back(name, value);
+            }
+        }
+    }
+
+    // chunk data first , their records and the globals' entries are written once their offsets are known
+    std::vector<ChunkRecord> records;
+    for (const Chunk* chunk : chunks) {
+        ChunkRecord record{};
+        record.codeCount = chunk->code.size();
+        record.code = writer.align();
+        writer.append(chunk->code.data(), chunk->code.size() * sizeof(Opcode));
+        record.lines = writer.align();
+        writer.append(chunk->lines.data(), chunk->lines.size() * sizeof(int));
+        std::vector<StoredValue> constants;
+        for (const Value& constant : chunk->constants.ValueVector) {
+            constants.push_back(writer.store(NO_NAME, constant));
+        }
+        record.constantCount = constants.size();
+        record.constants = writer.align();
+        writer.append(constants.data(), constants.size() * sizeof(StoredValue));
+        records.push_back(record);
+    }
+    std::vector<StoredValue> entries;
+    for (auto& global : globals) {
+        entries.push_back(writer.store(writer.intern(global.first), global.second));
+    }
+
+    uint32_t bucketCount = 16;
+    while (bucketCount < entries.size() * 2) bucketCount *= 2; //at most half full
+    std::vector<Bucket> buckets(bucketCount, Bucket{0, 0});
+    for (size_t index = 0; index < globals.size(); index++) {
+        uint64_t hash = hashBytes(globals[index].first);
+        size_t slot = hash & (bucketCount - 1);
+        while (buckets[slot].entry != 0) slot = (slot + 1) & (bucketCount - 1);
+        buckets[slot] = Bucket{static_cast<uint32_t>(index + 1), static_cast<uint32_t>(hash)};
+    }
+
+    header.globals = writer.align();
+    header.globalCount = static_cast<uint32_t>(entries.size());
+    writer.append(entries.data(), entries.size() * sizeof(StoredValue));
+    header.buckets = writer.align();
+    header.bucketCount = bucketCount;
+    writer.append(buckets.data(), buckets.size() * sizeof(Bucket));
+    header.chunks = writer.align();
+    header.chunkCount = static_cast<uint32_t>(records.size());
+    writer.append(records.data(), records.size() * sizeof(ChunkRecord));
+
+    header.strings = writer.align();
+    header.stringCount = static_cast<uint32_t>(writer.strings.size());
+    uint64_t text = header.strings + writer.strings.size() * sizeof(StringRecord);
+    for (const std::string& string : writer.strings) {
+        StringRecord record{text, string.size()};
+        writer.append(&record, sizeof(record));
+        text += string.size();
+    }
+    for (const std::string& string : writer.strings) {
+        writer.append(string.data(), string.size());
+    }
+    header.fileSize = writer.align();
+    std::memcpy(writer.bytes.data(), &header, sizeof(header));
+
+    std::string temporary = path + "." + std::to_string(getpid()) + ".tmp"; //several processes may write the same path
+    std::ofstream out(temporary, std::ios::binary);
+    out.write(writer.bytes.data(), writer.bytes.size());
+    out.close();
+    if (!out) {
+        error = "Could not write " + temporary;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "Could not rename " + temporary + " to " + path;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ------ READING ------
+
+Snapshot::~Snapshot() {
+    close();
+}
+
+bool Snapshot::open(const std::string& path, std::string& error) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Could not open snapshot \"" + path + "\"";
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        ::close(fd);
+        error = "\"" + path + "\" is too short to be a snapshot";
+        return false;
+    }
+    void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        error = "Could not map snapshot \"" + path + "\"";
+        return false;
+    }
+    madvise(address, info.st_size, MADV_RANDOM); //no read-ahead , only the pages we look at come in
+    this->base = static_cast<const char*>(address);
+    this->size = info.st_size;
+
+    const Header* header = at<Header>(this->base, 0);
+    const char* problem = nullptr;
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        problem = "isn't a snapshot";
+    } else if (header->version != VERSION || header->byteOrder != BYTE_ORDER_MARK) {
+        problem = "was written by another version or on another kind of machine";
+    } else if (header->fileSize != this->size) {
+        problem = "is truncated";
+    } else if (!inside(header->strings, header->stringCount, sizeof(StringRecord), this->size)
+               || !inside(header->globals, header->globalCount, sizeof(StoredValue), this->size)
+               || !inside(header->buckets, header->bucketCount, sizeof(Bucket), this->size)
+               || !inside(header->chunks, header->chunkCount, sizeof(ChunkRecord), this->size)
+               || header->bucketCount == 0 || (header->bucketCount & (header->bucketCount - 1)) != 0
+               || header->globalCount >= header->bucketCount) {
+        problem = "has a damaged header";
+    }
+    if (problem != nullptr) {
+        close();
+        error = "\"" + path + "\" " + problem;
+        return false;
+    }
+    return true;
+}
+
+void Snapshot::close() {
+    if (this->base != nullptr) {
+        munmap(const_cast<char*>(this->base), this->size);
+        this->base = nullptr;
+        this->size = 0;
+    }
+}
+
+size_t Snapshot::globalCount() const {
+    return this->base ? at<Header>(this->base, 0)->globalCount : 0;
+}
+
+size_t Snapshot::chunkCount() const {
+    return this->base ? at<Header>(this->base, 0)->chunkCount : 0;
+}
+
+bool Snapshot::text(uint64_t id, std::string_view& out) const {
+    const Header* header = at<Header>(this->base, 0);
+    if (id >= header->stringCount) return false;
+    const StringRecord* record = at<StringRecord>(this->base, header->strings) + id;
+    if (!inside(record->offset, record->length, 1, this->size)) return false;
+    out = std::string_view(this->base + record->offset, record->length);
+    return true;
+}
+
+bool Snapshot::decode(const void* where, Value& value) const {
+    const StoredValue* stored = static_cast<const StoredValue*>(where);
+    switch (static_cast<valueType>(stored->type)) {
+        case valueType::NIL:
+            value = Value();
+            return true;
+        case valueType::BOOLEAN:
+            value = Value(stored->payload != 0);
+            return true;
+        case valueType::NUMBER: {
+            double number;
+            std::memcpy(&number, &stored->payload, sizeof(number));
+            value = Value(number);
+            return true;
+        }
+        case valueType::INTEGER: {
+            int64_t integer;
+            std::memcpy(&integer, &stored->payload, sizeof(integer));
+            value = Value(integer);
+            return true;
+        }
+        case valueType::STRING: {
+            std::string_view string;
+            if (!text(stored->payload, string)) return false;
+            value = Value(std::string(string));
+            return true;
+        }
+        case valueType::ARRAY: {
+            if (!inside(stored->payload, 1, sizeof(uint64_t), this->size)) return false;
+            uint64_t length = *at<uint64_t>(this->base, stored->payload);
+            if (!inside(stored->payload + sizeof(uint64_t), length, sizeof(double), this->size)) return false;
+            value = Value(NumberArray::copyOf(at<double>(this->base, stored->payload + sizeof(uint64_t)), length));
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool Snapshot::find(const std::string& name, Value& value) const {
+    if (this->base == nullptr) return false;
+    const Header* header = at<Header>(this->base, 0);
+    const Bucket* buckets = at<Bucket>(this->base, header->buckets);
+    const StoredValue* entries = at<StoredValue>(this->base, header->globals);
+    uint64_t hash = hashBytes(name);
+    size_t slot = hash & (header->bucketCount - 1);
+    for (uint32_t probe = 0; probe < header->bucketCount; probe++, slot = (slot + 1) & (header->bucketCount - 1)) {
+        const Bucket& bucket = buckets[slot];
+        if (bucket.entry == 0) return false;
+        if (bucket.hash != static_cast<uint32_t>(hash) || bucket.entry > header->globalCount) continue;
+        const StoredValue& entry = entries[bucket.entry - 1];
+        std::string_view stored;
+        if (text(entry.name, stored) && stored == name) {
+            return decode(&entry, value);
+        }
+    }
+    return false; //only a damaged file has no empty bucket
+}
+
+bool Snapshot::global(size_t index, std::string& name, Value& value) const {
+    if (index >= globalCount()) return false;
+    const StoredValue& entry = at<StoredValue>(this->base, at<Header>(this->base, 0)->globals)[index];
+    std::string_view stored;
+    if (!text(entry.name, stored) || !decode(&entry, value)) return false;
+    name = std::string(stored);
+    return true;
+}
+
+bool Snapshot::loadChunk(size_t index, Chunk* chunk, std::string& error) const {
+    if (index >= chunkCount()) {
+        error = "the snapshot has no chunk " + std::to_string(index);
+        return false;
+    }
+    const ChunkRecord& record = at<ChunkRecord>(this->base, at<Header>(this->base, 0)->chunks)[index];
+    if (!inside(record.code, record.codeCount, sizeof(Opcode), this->size)
+        || !inside(record.lines, record.codeCount, sizeof(int), this->size)
+        || !inside(record.constants, record.constantCount, sizeof(StoredValue), this->size)) {
+        error = "chunk " + std::to_string(index) + " of the snapshot is damaged";
+        return false;
+    }
+    chunk->initChunk();
+    const Opcode* code = at<Opcode>(this->base, record.code);
+    const int* lines = at<int>(this->base, record.lines);
+    chunk->code.assign(code, code + record.codeCount);
+    chunk->lines.assign(lines, lines + record.codeCount);
+    const StoredValue* constants = at<StoredValue>(this->base, record.constants);
+    for (size_t k = 0; k < record.constantCount; k++) {
+        Value constant;
+        if (!decode(constants + k, constant)) {
+            chunk->freeChunk();
+            error = "constant " + std::to_string(k) + " of chunk " + std::to_string(index) + " is damaged";
+            return false;
+        }
+        chunk->addConstant(std::move(constant));
+    }
+    chunk->verified = false; //VM::run checks it before trusting it
+    return true;
+}
+
+void Snapshot::restore(VM& vm) const {
+    vm.snapshot = this;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "common.hpp"
+#include <string_view>
+
+class Chunk;
+class Value;
+class VM;
+
+// a VM's globals and a few compiled chunks in one file , so a process can start from the state a
+// setup script left behind instead of running the script again (clox --save-snapshot / --snapshot).
+//
+// the file is mmap'd and read in place. opening it only checks the header , the globals are a
+// hash table in the file that VM::run looks a name up in the first time the script uses it , and
+// a chunk is copied out when it's asked for. so starting from a snapshot touches the header , the
+// pages of the globals the script reads and the chunks it runs , whatever the size of the rest.
+//
+// layout , native byte order (the header records it) , every section 8 byte aligned :
+//   header   : where the sections below start and how long they are
+//   data     : code (an int per slot) , line tables , constants , arrays as {length , doubles}
+//   globals  : count x {name , type , payload} , the payload is the value or a string id or an offset
+//   buckets  : power of two x {entry + 1 , hash} , open addressing on FNV-1a of the name , 0 = empty
+//   chunks   : count x {code , code count , lines , constants , constant count}
+//   strings  : count x {offset , length} , then the bytes. every name and string value once
+// a damaged file is caught where it's read : a global that points outside the file is missing ,
+// a chunk that does fails to load , and loaded chunks are verified again before they run.
+class Snapshot {
+public:
+    Snapshot() = default;
+    ~Snapshot();
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+    void close();
+    bool isOpen() const { return this->base != nullptr; }
+
+    size_t globalCount() const;
+    size_t chunkCount() const;
+    // the global called name , false if the snapshot doesn't have it
+    bool find(const std::string& name, Value& value) const;
+    // the index-th global in the file , for walking all of them
+    bool global(size_t index, std::string& name, Value& value) const;
+    // a copy of the index-th chunk , not verified yet
+    bool loadChunk(size_t index, Chunk* chunk, std::string& error) const;
+
+    // the VM looks up globals here from now on , the snapshot has to outlive it. several VMs (on
+    // several threads) can share one snapshot , nothing in it changes once it's open
+    void restore(VM& vm) const;
+
+private:
+    const char* base = nullptr;
+    size_t size = 0;
+
+    bool text(uint64_t id, std::string_view& out) const;
+    bool decode(const void* stored, Value& value) const;
+};
+
+// FNV-1a , what the globals table is keyed by. also names module cache files , see modules.hpp
+uint64_t hashBytes(std::string_view bytes);
+
+// the VM's globals (its own and those still only in its snapshot) and the given chunks , written
+// to a temporary file and renamed over path so a reader never sees half a snapshot
+bool writeSnapshot(const std::string& path, const VM& vm, const std::vector<const Chunk*>& chunks,
+                   std::string& error);
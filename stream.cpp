@@ -0,0 +1,86 @@
+#include "stream.hpp"
+#include "chunk.hpp"
+#include "compiler.hpp"
+#include "modules.hpp"
+#include "timing.hpp"
+#include "vm.hpp"
+#include <cerrno>
+#include <unistd.h>
+
+InterpretResult SourceStream::run(int fd, VM* vm, std::ostream* errors) {
+    PhaseTimer phase("stream");
+    std::ostream& diagnostics = errors != nullptr ? *errors : std::cerr;
+    this->segments = 0;
+    this->bytes = 0;
+    this->peakCode = 0;
+    size_t capacity = std::max<size_t>(this->window, 64);
+    std::vector<char> buffer(capacity + 1); //+1 : compile() reads the byte after a segment
+    size_t filled = 0;     //bytes in buffer
+    size_t scanned = 0;    //of those , looked at for statement ends
+    size_t cut = 0;        //just past the last ';' outside a string seen so far , 0 for none
+    bool inString = false; //at scanned
+    bool eof = false;
+    int line = 1;          //the line buffer[0] is on
+    Chunk chunk;
+    chunk.initChunk();
+    vm->startLimits();
+
+    InterpretResult result = InterpretResult::INTERPRET_OK;
+    for (;;) {
+        while (!eof && filled < capacity) { //a pipe hands out less than asked for , ask again
+            ssize_t got = read(fd, buffer.data() + filled, capacity - filled);
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) {
+                diagnostics << "Could not read the script: " << std::strerror(errno) << "\n";
+                result = InterpretResult::INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            eof = got == 0;
+            filled += static_cast<size_t>(got);
+            this->bytes += static_cast<size_t>(got);
+        }
+        if (result != InterpretResult::INTERPRET_OK) break;
+        for (; scanned < filled; scanned++) {
+            char c = buffer[scanned];
+            if (c == '"') inString = !inString;
+            else if (c == ';' && !inString) cut = scanned + 1;
+        }
+        size_t end = eof ? filled : cut; //the file's tail goes as it is , compile() reports what's unfinished
+        if (end == 0) {
+            if (eof) break;
+            capacity *= 2; //not one whole statement in a full window
+            buffer.resize(capacity + 1);
+            continue;
+        }
+
+        char after = buffer[end];
+        buffer[end] = '\0';
+        chunk.freeChunk();
+        bool compiled = compile(std::string_view(buffer.data(), end), &chunk, vm->optimizationLevel, &diagnostics,
+                                vm->shared != nullptr, line);
+        buffer[end] = after;
+        if (!compiled || (vm->modules != nullptr && !vm->modules->load(chunk, diagnostics))) {
+            result = InterpretResult::INTERPRET_COMPILE_ERROR;
+            break;
+        }
+        this->segments++;
+        this->peakCode = std::max(this->peakCode, chunk.code.size());
+        vm->continueWith(&chunk);
+        do {
+            result = vm->run();
+        } while (result == InterpretResult::INTERPRET_YIELD); //nobody to hand control to , carry on
+        if (result != InterpretResult::INTERPRET_OK) break;
+
+        line += static_cast<int>(std::count(buffer.data(), buffer.data() + end, '\n'));
+        std::memmove(buffer.data(), buffer.data() + end, filled - end);
+        filled -= end;
+        scanned -= end;
+        cut = 0;
+        if (eof && filled == 0) break;
+    }
+    this->peakWindow = capacity;
+    phase.count("segments", this->segments);
+    phase.count("bytes", this->bytes);
+    phase.count("peakWindow", this->peakWindow);
+    return result;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "common.hpp"
+#include "result.hpp"
+
+class VM;
+
+// runs a script too big to hold , eg. a generated one of a few GB , in memory that doesn't grow
+// with it. the source is read a window at a time and cut after the last whole statement in it :
+// the language has no blocks , so that's the last ';' outside a string literal. the cut is
+// compiled into one chunk that every segment reuses (code , line table and constant pool keep
+// their capacity) , run , and dropped. the rest of the window moves to the front and the next
+// read tops it up.
+//
+// to the script it's one run : globals , the stack and what's left of the limits carry over from
+// segment to segment , and errors give the file's line numbers. a compile error stops the stream
+// at its segment , after the segments before it have run. a statement longer than the window
+// doubles it. each segment is optimized on its own , type facts don't cross a cut.
+class SourceStream {
+public:
+    size_t window = 1 << 20; //bytes read and compiled at a time
+
+    // what the last run() did
+    size_t segments = 0;
+    size_t bytes = 0;      //of source read
+    size_t peakWindow = 0; //more than window only if a statement didn't fit in it
+    size_t peakCode = 0;   //code slots of the biggest segment
+
+    // reads fd to its end. compile errors and read failures go to errors , std::cerr when null
+    InterpretResult run(int fd, VM* vm, std::ostream* errors = nullptr);
+};
@@ -0,0 +1,148 @@
+#include "timing.hpp"
+#include "chunk.hpp"
+#include "opcode.hpp"
+
+Timeline timeline;
+
+static std::atomic<int> threadCount{0};
+thread_local int threadId = -1;
+thread_local int phaseDepth = 0;
+
+static int currentThread() {
+    if (threadId < 0) threadId = threadCount++;
+    return threadId;
+}
+
+void Timeline::enable() {
+    this->origin = std::chrono::steady_clock::now();
+    this->enabled.store(true, std::memory_order_relaxed);
+}
+
+uint64_t Timeline::now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->origin).count();
+}
+
+void Timeline::record(PhaseEvent event) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->recorded.push_back(std::move(event));
+}
+
+std::vector<PhaseEvent> Timeline::events() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    std::vector<PhaseEvent> events = this->recorded;
+    std::sort(events.begin(), events.end(), [](const PhaseEvent& a, const PhaseEvent& b) {
+        return a.thread != b.thread ? a.thread < b.thread : a.start < b.start;
+    });
+    return events;
+}
+
+// one line per phase name (and nesting) : calls , total and slowest time , counters summed
+void Timeline::writeSummary(std::ostream& out) {
+    struct Row {
+        std::string name;
+        size_t calls = 0;
+        uint64_t total = 0;
+        uint64_t slowest = 0;
+        std::vector<std::pair<const char*, uint64_t>> counters;
+    };
+    std::vector<Row> rows;
+    for (const PhaseEvent& event : events()) {
+        std::string name = std::string(event.depth * 2, ' ') + event.name;
+        auto row = std::find_if(rows.begin(), rows.end(), [&](const Row& r) { return r.name == name; });
+        if (row == rows.end()) {
+            Row added;
+            added.name = name;
+            rows.push_back(std::move(added));
+            row = rows.end() - 1;
+        }
+        row->calls++;
+        row->total += event.duration;
+        row->slowest = std::max(row->slowest, event.duration);
+        for (const auto& counter : event.counters) {
+            auto summed = std::find_if(row->counters.begin(), row->counters.end(),
+                                       [&](const auto& c) { return std::strcmp(c.first, counter.first) == 0; });
+            if (summed == row->counters.end()) {
+                row->counters.push_back(counter);
+            } else if (std::strcmp(counter.first, "peakStack") == 0) {
+                summed->second = std::max(summed->second, counter.second); //a peak doesn't add up
+            } else {
+                summed->second += counter.second;
+            }
+        }
+    }
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+    out << std::left << std::setw(20) << "phase" << std::right << std::setw(8) << "calls" << std::setw(14)
+        << "total ms" << std::setw(14) << "slowest ms" << "  counters\n";
+    for (const Row& row : rows) {
+        out << std::left << std::setw(20) << row.name << std::right << std::setw(8) << row.calls << std::setw(14)
+            << row.total / 1e6 << std::setw(14) << row.slowest / 1e6 << " ";
+        for (const auto& counter : row.counters) out << " " << counter.first << "=" << counter.second;
+        out << "\n";
+    }
+    out.flags(flags);
+}
+
+// complete ("X") events , timestamps in microseconds as the format wants
+bool Timeline::writeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Could not open " << path << " for writing!\n";
+        return false;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (const PhaseEvent& event : events()) {
+        out << (first ? "\n" : ",\n") << "  {\"name\": \"" << event.name << "\", \"cat\": \"clox\", \"ph\": \"X\", "
+            << "\"ts\": " << event.start / 1e3 << ", \"dur\": " << event.duration / 1e3
+            << ", \"pid\": 1, \"tid\": " << event.thread << ", \"args\": {";
+        for (size_t k = 0; k < event.counters.size(); k++) {
+            out << (k == 0 ? "" : ", ") << "\"" << event.counters[k].first << "\": " << event.counters[k].second;
+        }
+        out << "}}";
+        first = false;
+    }
+    out << "\n]}\n";
+    return true;
+}
+
+// ------ PHASES ------
+
+PhaseTimer::PhaseTimer(const char* name) {
+    this->active = timeline.enabled.load(std::memory_order_relaxed);
+    if (!this->active) return;
+    this->event.name = name;
+    this->event.thread = currentThread();
+    this->event.depth = phaseDepth++;
+    this->event.start = timeline.now();
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (!this->active) return;
+    this->event.duration = timeline.now() - this->event.start;
+    phaseDepth--;
+    timeline.record(std::move(this->event));
+}
+
+void PhaseTimer::count(const char* counter, uint64_t value) {
+    if (this->active) this->event.counters.emplace_back(counter, value);
+}
+
+void PhaseTimer::add(const char* name, uint64_t start, uint64_t duration,
+                     std::vector<std::pair<const char*, uint64_t>> counters) {
+    if (!timeline.enabled.load(std::memory_order_relaxed)) return;
+    timeline.record(PhaseEvent{name, start, duration, currentThread(), phaseDepth, std::move(counters)});
+}
+
+size_t peakStackDepth(const Chunk* chunk, size_t from, size_t to) {
+    if (to == 0 || to > chunk->code.size()) to = chunk->code.size();
+    long depth = 0;
+    long peak = 0;
+    for (size_t i = from; i < to; i += opcodeLength(chunk->code[i])) {
+        depth += stackEffect(chunk->code[i]);
+        peak = std::max(peak, depth);
+    }
+    return static_cast<size_t>(peak);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "common.hpp"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+class Chunk;
+
+// wall clock timings of the phases of a run : readFile , compile (scan , parse/emit , optimize ,
+// typeinfer) and VM::run , each with a few counters. off by default , when it's off a phase costs
+// one relaxed load. when it's on every finished phase is kept as an event , printed as a summary
+// (--timings) and / or written as Chrome trace_event JSON (--trace=out.json , load it in
+// chrome://tracing or ui.perfetto.dev).
+struct PhaseEvent {
+    const char* name;
+    uint64_t start;    //ns since the timeline started
+    uint64_t duration; //ns
+    int thread;
+    int depth;         //nesting on its thread , for the summary
+    std::vector<std::pair<const char*, uint64_t>> counters;
+};
+
+class Timeline {
+public:
+    std::atomic<bool> enabled{false};
+
+    void enable();
+    uint64_t now() const; //ns since enable()
+    void record(PhaseEvent event);
+    std::vector<PhaseEvent> events();
+    void writeSummary(std::ostream& out);
+    bool writeTrace(const std::string& path);
+
+private:
+    std::chrono::steady_clock::time_point origin;
+    std::mutex lock;
+    std::vector<PhaseEvent> recorded;
+};
+
+extern Timeline timeline;
+
+// times the enclosing scope as one phase , nested phases on the same thread show up inside it
+class PhaseTimer {
+public:
+    explicit PhaseTimer(const char* name);
+    ~PhaseTimer();
+    void count(const char* counter, uint64_t value); //shown with the phase , no-op when disabled
+
+    // a phase that didn't run in one piece (scanning is interleaved with parsing) , added with its
+    // total time at the given start
+    static void add(const char* name, uint64_t start, uint64_t duration,
+                    std::vector<std::pair<const char*, uint64_t>> counters = {});
+
+private:
+    bool active;
+    PhaseEvent event;
+};
+
+// how far above its starting depth the stack gets running chunk over [from , to) , exact since
+// there are no jumps. to = 0 means the end of the chunk
+size_t peakStackDepth(const Chunk* chunk, size_t from = 0, size_t to = 0);
@@ -1,16 +1,17 @@
 #pragma once
 #include "common.hpp"
 #include "tokentype.hpp"
+#include <string_view>
 
 class Token {
 public:
     TokenType type;
-    std::string lexeme;
+    std::string_view lexeme; //into the scanned source (or a static message for TOKEN_ERROR) , nothing to free
     int line;
 
     // Default constructor
     Token() : type(TokenType::TOKEN_ERROR), lexeme(""), line(0) {}
 
     // Constructor with parameters
-    Token(TokenType t, std::string l, int ln) : type(t), lexeme(l), line(ln) {}
-};
\ No newline at end of file
+    Token(TokenType t, std::string_view l, int ln) : type(t), lexeme(l), line(ln) {}
+};
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "typeinfer.hpp"
+#include "chunk.hpp"
+#include "value.hpp"
+
+InferredType typeOfConstant(const Value& value) {
+    switch (value.type) {
+        case valueType::NUMBER:  return InferredType::NUMBER;
+        case valueType::INTEGER: return InferredType::INTEGER;
+        case valueType::BOOLEAN: return InferredType::BOOLEAN;
+        case valueType::NIL:     return InferredType::NIL;
+        case valueType::ARRAY:   return InferredType::ARRAY;
+        default:                 return InferredType::UNKNOWN;
+    }
+}
+
+bool isNumericType(InferredType type) {
+    return type == InferredType::NUMBER || type == InferredType::INTEGER || type == InferredType::NUMERIC;
+}
+
+InferredType arithmeticType(bool divide, InferredType first, InferredType second) {
+    if (first == InferredType::ARRAY || second == InferredType::ARRAY) {
+        return InferredType::ARRAY;
+    }
+    if (!isNumericType(first) || !isNumericType(second)) {
+        return InferredType::UNKNOWN;
+    }
+    if (divide || first == InferredType::NUMBER || second == InferredType::NUMBER) {
+        return InferredType::NUMBER;
+    }
+    return InferredType::NUMERIC;
+}
+
+InferredType negateType(InferredType operand) {
+    if (operand == InferredType::NUMBER || operand == InferredType::ARRAY) return operand;
+    return isNumericType(operand) ? InferredType::NUMERIC : InferredType::UNKNOWN;
+}
+
+static Opcode uncheckedVariant(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::OP_ADD:      return Opcode::OP_ADD_NUM;
+        case Opcode::OP_SUBTRACT: return Opcode::OP_SUBTRACT_NUM;
+        case Opcode::OP_MULTIPLY: return Opcode::OP_MULTIPLY_NUM;
+        case Opcode::OP_DIVIDE:   return Opcode::OP_DIVIDE_NUM;
+        case Opcode::OP_GREATER:  return Opcode::OP_GREATER_NUM;
+        case Opcode::OP_LESSER:   return Opcode::OP_LESSER_NUM;
+        default:                  return opcode;
+    }
+}
+
+void inferTypes(Chunk* chunk, bool sharedGlobals) {
+    // the code is straight line (no jumps yet) so a single forward walk is flow sensitive.
+    // if an instruction fails at runtime the VM stops there , so after every instruction
+    // we may assume it succeeded (eg. the result of any OP_ADD is a number).
+    // every slot remembers the OP_CONSTANT that pushed it , if one did , so an integer literal
+    // used straight away by a double operation can become a double literal
+    struct Slot {
+        InferredType type;
+        size_t constantAt;
+    };
+    const size_t NOT_CONSTANT = SIZE_MAX;
+    std::vector<Slot> stack;
+    std::unordered_map<std::string, InferredType> globals; //globals from earlier runs start out unknown
+    std::unordered_map<int64_t, int> widened;                //integer literal -> its double constant
+
+    std::vector<Opcode>& code = chunk->code;
+    std::vector<Value>& constants = chunk->constants.ValueVector;
+    auto widen = [&](Slot& slot) {
+        if (slot.type != InferredType::INTEGER || slot.constantAt == NOT_CONSTANT) return false;
+        int64_t integer = constants[static_cast<int>(code[slot.constantAt + 1])].data.integer;
+        auto found = widened.find(integer);
+        if (found == widened.end()) {
+            if (constants.size() >= static_cast<size_t>(MAX_CONSTANTS)) return false;
+            found = widened.emplace(integer, chunk->addConstant(Value(static_cast<double>(integer)))).first;
+        }
+        code[slot.constantAt + 1] = static_cast<Opcode>(found->second);
+        slot.type = InferredType::NUMBER;
+        return true;
+    };
+
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        Opcode opcode = code[i];
+        switch (opcode) {
+            case Opcode::OP_CONSTANT:
+                stack.push_back({typeOfConstant(constants[static_cast<int>(code[i + 1])]), i});
+                break;
+            case Opcode::OP_NIL:
+                stack.push_back({InferredType::NIL, NOT_CONSTANT});
+                break;
+            case Opcode::OP_TRUE:
+            case Opcode::OP_FALSE:
+                stack.push_back({InferredType::BOOLEAN, NOT_CONSTANT});
+                break;
+            case Opcode::OP_NEGATE:
+                if (stack.back().type == InferredType::NUMBER) {
+                    code[i] = Opcode::OP_NEGATE_NUM;
+                }
+                stack.back() = {negateType(stack.back().type), NOT_CONSTANT};
+                break;
+            case Opcode::OP_NOT:
+                stack.back() = {InferredType::BOOLEAN, NOT_CONSTANT};
+                break;
+            case Opcode::OP_ADD:
+            case Opcode::OP_SUBTRACT:
+            case Opcode::OP_MULTIPLY:
+            case Opcode::OP_DIVIDE:
+            case Opcode::OP_GREATER:
+            case Opcode::OP_LESSER: {
+                Slot second = stack.back();
+                stack.pop_back();
+                Slot& first = stack.back();
+                if (first.type == InferredType::NUMBER && second.type == InferredType::NUMBER) {
+                    code[i] = uncheckedVariant(opcode);
+                } else if ((first.type == InferredType::NUMBER && widen(second))
+                           || (second.type == InferredType::NUMBER && widen(first))) {
+                    code[i] = uncheckedVariant(opcode);
+                }
+                bool comparison = opcode == Opcode::OP_GREATER || opcode == Opcode::OP_LESSER;
+                first.type = comparison ? InferredType::BOOLEAN
+                                        : arithmeticType(opcode == Opcode::OP_DIVIDE, first.type, second.type);
+                first.constantAt = NOT_CONSTANT;
+                break;
+            }
+            case Opcode::OP_EQUAL:
+                stack.pop_back();
+                stack.back() = {InferredType::BOOLEAN, NOT_CONSTANT};
+                break;
+            case Opcode::OP_DEFINE_GLOBAL:
+                if (!sharedGlobals) globals[constants[static_cast<int>(code[i + 1])].getString()] = stack.back().type;
+                stack.pop_back();
+                break;
+            case Opcode::OP_GET_GLOBAL: {
+                auto found = globals.find(constants[static_cast<int>(code[i + 1])].getString());
+                stack.push_back({found == globals.end() ? InferredType::UNKNOWN : found->second, NOT_CONSTANT});
+                break;
+            }
+            case Opcode::OP_SET_GLOBAL:
+                if (!sharedGlobals) globals[constants[static_cast<int>(code[i + 1])].getString()] = stack.back().type;
+                stack.back().constantAt = NOT_CONSTANT; //the global holds the literal too , it has to stay as it is
+                break;
+            case Opcode::OP_POP:
+            case Opcode::OP_PRINT:
+                stack.pop_back();
+                break;
+            case Opcode::OP_YIELD:
+                globals.clear(); //the host may touch globals while we're suspended
+                break;
+            case Opcode::OP_IMPORT:
+                globals.clear(); //so may the module
+                break;
+            case Opcode::OP_ARRAY:
+                stack.push_back({InferredType::ARRAY, NOT_CONSTANT});
+                break;
+            case Opcode::OP_APPEND:
+            case Opcode::OP_DOT:
+                stack.pop_back();
+                stack.back() = {opcode == Opcode::OP_DOT ? InferredType::NUMBER : InferredType::ARRAY, NOT_CONSTANT};
+                break;
+            case Opcode::OP_SUM:
+            case Opcode::OP_MIN:
+            case Opcode::OP_MAX:
+                stack.back() = {InferredType::NUMBER, NOT_CONSTANT};
+                break;
+            case Opcode::OP_LENGTH:
+                stack.back() = {InferredType::INTEGER, NOT_CONSTANT};
+                break;
+            case Opcode::OP_RANGE:
+                stack.back() = {InferredType::ARRAY, NOT_CONSTANT};
+                break;
+            case Opcode::OP_RETURN:
+                return;
+            default:
+                return; //something we don't understand , leave the rest alone
+        }
+    }
+}
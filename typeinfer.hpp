@@ -0,0 +1,32 @@
+#pragma once
+#include "common.hpp"
+
+class Chunk;
+class Value;
+
+//what the type pass knows about a value at compile time
+enum class InferredType {
+    UNKNOWN,
+    NUMBER,   //a double
+    BOOLEAN,
+    NIL,
+    INTEGER,
+    NUMERIC,  //INTEGER or NUMBER , not known which (integer arithmetic can overflow into a double)
+    ARRAY,
+};
+
+InferredType typeOfConstant(const Value& value);
+bool isNumericType(InferredType type);
+// the result of + - * / (divide) or unary - , once it has succeeded , following the rules in value.hpp.
+// an operand that may be an array (anything not known to be a number) may make the result one
+InferredType arithmeticType(bool divide, InferredType first, InferredType second);
+InferredType negateType(InferredType operand);
+
+// walks the compiled chunk tracking the type of every stack slot and global,
+// and rewrites arithmetic/comparison opcodes into their unchecked _NUM variants
+// when both operands are provably doubles. an integer literal meeting a double is
+// turned into a double literal first , mixed arithmetic would convert it anyway.
+// everything else keeps the checked opcode (with its integer fast path) so mistyped
+// programs still fail at the same instruction with the same message.
+// with sharedGlobals nothing is assumed about a global that was read , see checkChunk()
+void inferTypes(Chunk* chunk, bool sharedGlobals = false);
@@ -3,6 +3,8 @@
 double Value::getDouble() {
     if (this->type == valueType::NUMBER) {
         return this->data.number;
+    } else if (this->type == valueType::INTEGER) {
+        return static_cast<double>(this->data.integer);
     } else {
         throw std::runtime_error("NOT A DOUBLE");
     }
@@ -16,10 +18,22 @@ std::string Value::getString() {
     }
 }
 
+static void printArray(std::ostream& os, const NumberArray& array) {
+    os << '[';
+    for (size_t k = 0; k < array.length; k++) {
+        if (k > 0) os << ", ";
+        os << array.elements[k];
+    }
+    os << ']';
+}
+
 void Value::printValue() {
     if (this->type == valueType::NUMBER) {
         std::cout << this->data.number;
     }
+    else if (this->type == valueType::INTEGER) {
+        std::cout << this->data.integer;
+    }
     else if (this->type == valueType::BOOLEAN) {
         if (this->data.boolean) {
             std::cout << "true";
@@ -33,6 +47,9 @@ void Value::printValue() {
     else if (this->type == valueType::STRING) {
         std::cout << *this->data.string;
     }
+    else if (this->type == valueType::ARRAY) {
+        printArray(std::cout, *this->data.array);
+    }
     else {
         throw std::runtime_error("UNKNOWN VALUE TYPE");
     }
@@ -41,6 +58,14 @@ void Value::printValue() {
 void Value::negate() {
     if (this->type == valueType::NUMBER) {
         this->data.number = -this->data.number;
+    } else if (this->type == valueType::INTEGER) {
+        if (this->data.integer == INT64_MIN) {
+            *this = Value(-static_cast<double>(this->data.integer)); //-INT64_MIN doesn't fit
+        } else {
+            this->data.integer = -this->data.integer;
+        }
+    } else if (this->type == valueType::ARRAY) {
+        negateArray(*this);
     }
 }
 
@@ -49,30 +74,47 @@ bool Value::isFalsey() {
 }
 
 // Fixed operator implementations - now as member functions
+// integer + - * are done in 128 bits , exact , and only narrowed when the result fits (see value.hpp)
+static Value integerResult(__int128 exact) {
+    if (exact >= INT64_MIN && exact <= INT64_MAX) {
+        return Value(static_cast<int64_t>(exact));
+    }
+    return Value(static_cast<double>(exact));
+}
+
 Value Value::operator+(const Value& other) const {
-    if (this->type == valueType::NUMBER && other.type == valueType::NUMBER) {
-        return Value(this->data.number + other.data.number);
+    if (bothIntegers(*this, other)) {
+        return integerResult(static_cast<__int128>(this->data.integer) + other.data.integer);
+    }
+    if (isNumeric(*this) && isNumeric(other)) {
+        return Value(asDouble(*this) + asDouble(other));
     }
     throw std::runtime_error("Invalid operands for addition");
 }
 
 Value Value::operator-(const Value& other) const {
-    if (this->type == valueType::NUMBER && other.type == valueType::NUMBER) {
-        return Value(this->data.number - other.data.number);
+    if (bothIntegers(*this, other)) {
+        return integerResult(static_cast<__int128>(this->data.integer) - other.data.integer);
+    }
+    if (isNumeric(*this) && isNumeric(other)) {
+        return Value(asDouble(*this) - asDouble(other));
     }
     throw std::runtime_error("Invalid operands for subtraction");
 }
 
 Value Value::operator*(const Value& other) const {
-    if (this->type == valueType::NUMBER && other.type == valueType::NUMBER) {
-        return Value(this->data.number * other.data.number);
+    if (bothIntegers(*this, other)) {
+        return integerResult(static_cast<__int128>(this->data.integer) * other.data.integer);
+    }
+    if (isNumeric(*this) && isNumeric(other)) {
+        return Value(asDouble(*this) * asDouble(other));
     }
     throw std::runtime_error("Invalid operands for multiplication");
 }
 
 Value Value::operator/(const Value& other) const {
-    if (this->type == valueType::NUMBER && other.type == valueType::NUMBER) {
-        return Value(this->data.number / other.data.number);
+    if (isNumeric(*this) && isNumeric(other)) {
+        return Value(asDouble(*this) / asDouble(other));
     }
     throw std::runtime_error("Invalid operands for division");
 }
@@ -80,6 +122,8 @@ Value Value::operator/(const Value& other) const {
 void Value::setNil() {
     if (type == valueType::STRING) {
         delete data.string;
+    } else if (type == valueType::ARRAY) {
+        data.array->release();
     }
     this->type = valueType::NIL;
     return;
@@ -89,6 +133,9 @@ void Value::printValue(std::ostream& os) {
     if (this->type == valueType::NUMBER) {
         os << this->data.number;
     }
+    else if (this->type == valueType::INTEGER) {
+        os << this->data.integer;
+    }
     else if (this->type == valueType::BOOLEAN) {
         if (this->data.boolean) {
             os << "true";
@@ -102,6 +149,9 @@ void Value::printValue(std::ostream& os) {
     else if (this->type == valueType::STRING) {
         os << *this->data.string;
     }
+    else if (this->type == valueType::ARRAY) {
+        printArray(os, *this->data.array);
+    }
     else {
         throw std::runtime_error("UNKNOWN VALUE TYPE");
     }
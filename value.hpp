@@ -1,5 +1,6 @@
 #pragma once
 #include "common.hpp"
+#include "array.hpp"
 #include <variant>
 
 class Value {
@@ -7,8 +8,10 @@ public:
     valueType type;
     union {
         double number;
+        int64_t integer;
         bool boolean;
         std::string* string;  // For identifiers
+        NumberArray* array;   // shared , copies take a reference
     } data;
 
     Value(double input) {     //constructor for double datatype
@@ -16,6 +19,11 @@ public:
         data.number = input;
     }
 
+    explicit Value(int64_t input) {
+        type = valueType::INTEGER;
+        data.integer = input;
+    }
+
     Value(bool input) {
         type = valueType::BOOLEAN;
         data.boolean = input;
@@ -23,7 +31,12 @@ public:
 
     Value(std::string input) {  // Constructor for string identifiers
         type = valueType::STRING;
-        data.string = new std::string(input);
+        data.string = new std::string(std::move(input));
+    }
+
+    explicit Value(NumberArray* input) {  // takes over one reference
+        type = valueType::ARRAY;
+        data.array = input;
     }
 
     // Copy constructor
@@ -33,23 +46,48 @@ public:
             data.string = new std::string(*other.data.string);
         } else {
             data = other.data;
+            if (type == valueType::ARRAY) data.array->retain();
         }
     }
+    // Move constructor , takes the string over instead of copying it (constant pools growing ,
+    // addConstant) and leaves nil behind
+    Value(Value&& other) noexcept {
+        type = other.type;
+        data = other.data;
+        other.type = valueType::NIL;
+    }
     Value() {
         type = valueType::NIL;
+        data.number = 0;
     }
     // Assignment operator
     Value& operator=(const Value& other) {
         if (this != &other) {
             if (type == valueType::STRING) {
                 delete data.string;
+            } else if (type == valueType::ARRAY) {
+                data.array->release();
             }
             type = other.type;
             if (type == valueType::STRING) {
                 data.string = new std::string(*other.data.string);
             } else {
                 data = other.data;
+                if (type == valueType::ARRAY) data.array->retain();
+            }
+        }
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            if (type == valueType::STRING) {
+                delete data.string;
+            } else if (type == valueType::ARRAY) {
+                data.array->release();
             }
+            type = other.type;
+            data = other.data;
+            other.type = valueType::NIL;
         }
         return *this;
     }
@@ -57,6 +95,8 @@ public:
     ~Value() {
         if (type == valueType::STRING) {
             delete data.string;
+        } else if (type == valueType::ARRAY) {
+            data.array->release();
         }
     }
 
@@ -73,4 +113,47 @@ public:
 
     double getDouble();
     std::string getString();
-};
\ No newline at end of file
+};
+
+// ------ NUMBERS ------
+// INTEGER and NUMBER (double) are both numbers and mix freely :
+//   + - * on two integers give an integer , or if it overflows the double nearest the exact result
+//   / always gives a double , 7 / 2 is 3.5 whatever the operands
+//   any other mix is done in doubles , the integer converted first , comparisons and == included
+//   (so 1 == 1.0 , and integers past 2^53 compare with doubles after rounding)
+//   negating the smallest integer gives a double
+// the VM , register VM , -O2 folding and generated C++ all go through these.
+
+inline bool isNumeric(const Value& value) {
+    return value.type == valueType::NUMBER || value.type == valueType::INTEGER;
+}
+
+inline double asDouble(const Value& value) {
+    return value.type == valueType::INTEGER ? static_cast<double>(value.data.integer) : value.data.number;
+}
+
+inline bool bothIntegers(const Value& first, const Value& second) {
+    return first.type == valueType::INTEGER && second.type == valueType::INTEGER;
+}
+
+// numeric operands only , the callers check
+inline bool lessThan(const Value& first, const Value& second) {
+    if (bothIntegers(first, second)) return first.data.integer < second.data.integer;
+    return asDouble(first) < asDouble(second);
+}
+
+inline bool greaterThan(const Value& first, const Value& second) {
+    if (bothIntegers(first, second)) return first.data.integer > second.data.integer;
+    return asDouble(first) > asDouble(second);
+}
+
+// any two values , strings never compare equal (they're only names so far) , arrays do when they
+// have the same elements
+inline bool valuesEqual(const Value& first, const Value& second) {
+    if (bothIntegers(first, second)) return first.data.integer == second.data.integer;
+    if (isNumeric(first) && isNumeric(second)) return asDouble(first) == asDouble(second);
+    if (first.type != second.type) return false;
+    if (first.type == valueType::BOOLEAN) return first.data.boolean == second.data.boolean;
+    if (first.type == valueType::ARRAY) return arraysEqual(*first.data.array, *second.data.array);
+    return first.type == valueType::NIL;
+}
\ No newline at end of file
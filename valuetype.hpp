@@ -5,4 +5,6 @@ enum class valueType {
     BOOLEAN,
     NIL,
     STRING,  // For identifiers
+    INTEGER, //64 bit integer , literals without a decimal point
+    ARRAY,   //unboxed doubles , see array.hpp
 };
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "verifier.hpp"
+#include "chunk.hpp"
+#include "value.hpp"
+#include "typeinfer.hpp"
+
+// values an instruction needs on the stack before it runs
+static int stackInputs(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::OP_NEGATE:
+        case Opcode::OP_NEGATE_NUM:
+        case Opcode::OP_NOT:
+        case Opcode::OP_DEFINE_GLOBAL:
+        case Opcode::OP_SET_GLOBAL:
+        case Opcode::OP_POP:
+        case Opcode::OP_PRINT:
+        case Opcode::OP_SUM:
+        case Opcode::OP_MIN:
+        case Opcode::OP_MAX:
+        case Opcode::OP_LENGTH:
+        case Opcode::OP_RANGE:
+            return 1;
+        case Opcode::OP_ADD:
+        case Opcode::OP_SUBTRACT:
+        case Opcode::OP_MULTIPLY:
+        case Opcode::OP_DIVIDE:
+        case Opcode::OP_EQUAL:
+        case Opcode::OP_GREATER:
+        case Opcode::OP_LESSER:
+        case Opcode::OP_ADD_NUM:
+        case Opcode::OP_SUBTRACT_NUM:
+        case Opcode::OP_MULTIPLY_NUM:
+        case Opcode::OP_DIVIDE_NUM:
+        case Opcode::OP_GREATER_NUM:
+        case Opcode::OP_LESSER_NUM:
+        case Opcode::OP_APPEND:
+        case Opcode::OP_DOT:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static bool isUnchecked(Opcode opcode) {
+    return opcode >= Opcode::OP_NEGATE_NUM && opcode <= Opcode::OP_LESSER_NUM;
+}
+
+Verification checkChunk(const Chunk* chunk, bool sharedGlobals) {
+    Verification result;
+    auto fail = [&](size_t offset, const std::string& message) {
+        result.offset = static_cast<int>(offset);
+        result.message = message;
+        return result;
+    };
+
+    const std::vector<Opcode>& code = chunk->code;
+    const std::vector<Value>& constants = chunk->constants.ValueVector;
+    if (chunk->lines.size() != code.size()) {
+        return fail(0, "line table doesn't match the code");
+    }
+
+    // the same forward walk as the type pass , an unchecked opcode is only fine where it would
+    // have put one. stack holds the type of every slot pushed by this chunk
+    std::vector<InferredType> stack;
+    std::unordered_map<std::string, InferredType> globals;
+    for (size_t i = 0; i < code.size(); i += opcodeLength(code[i])) {
+        Opcode opcode = code[i];
+        if (opcode < Opcode::OP_RETURN || opcode > Opcode::OP_BREAK) {
+            return fail(i, "unknown opcode " + std::to_string(static_cast<int>(opcode)));
+        }
+        if (opcode == Opcode::OP_BREAK) { //a debugger patches it into a copy it has verified already
+            return fail(i, "breakpoint trap outside the debugger");
+        }
+        const Value* constant = nullptr;
+        if (opcodeLength(opcode) == 2) {
+            if (i + 1 >= code.size()) {
+                return fail(i, "missing operand");
+            }
+            int index = static_cast<int>(code[i + 1]);
+            if (index < 0 || static_cast<size_t>(index) >= constants.size()) {
+                return fail(i, "constant " + std::to_string(index) + " out of range");
+            }
+            constant = &constants[index];
+            if (opcode != Opcode::OP_CONSTANT && constant->type != valueType::STRING) {
+                return fail(i, opcode == Opcode::OP_IMPORT ? "module name is not a string" : "global name is not a string");
+            }
+        }
+        if (stack.size() < static_cast<size_t>(stackInputs(opcode))) {
+            return fail(i, "stack underflow");
+        }
+        if (isUnchecked(opcode)) {
+            bool numbers = stack.back() == InferredType::NUMBER
+                && (opcode == Opcode::OP_NEGATE_NUM || stack[stack.size() - 2] == InferredType::NUMBER);
+            if (!numbers) {
+                return fail(i, "unchecked opcode on values that may not be doubles");
+            }
+        }
+
+        switch (opcode) {
+            case Opcode::OP_CONSTANT:
+                stack.push_back(typeOfConstant(*constant));
+                break;
+            case Opcode::OP_NIL:
+                stack.push_back(InferredType::NIL);
+                break;
+            case Opcode::OP_TRUE:
+            case Opcode::OP_FALSE:
+                stack.push_back(InferredType::BOOLEAN);
+                break;
+            case Opcode::OP_NEGATE:
+            case Opcode::OP_NEGATE_NUM:
+                stack.back() = negateType(stack.back());
+                break;
+            case Opcode::OP_NOT:
+                stack.back() = InferredType::BOOLEAN;
+                break;
+            case Opcode::OP_EQUAL:
+            case Opcode::OP_GREATER:
+            case Opcode::OP_LESSER:
+            case Opcode::OP_GREATER_NUM:
+            case Opcode::OP_LESSER_NUM:
+                stack.pop_back();
+                stack.back() = InferredType::BOOLEAN;
+                break;
+            case Opcode::OP_ADD:
+            case Opcode::OP_SUBTRACT:
+            case Opcode::OP_MULTIPLY:
+            case Opcode::OP_DIVIDE:
+            case Opcode::OP_ADD_NUM:
+            case Opcode::OP_SUBTRACT_NUM:
+            case Opcode::OP_MULTIPLY_NUM:
+            case Opcode::OP_DIVIDE_NUM: {
+                InferredType second = stack.back();
+                stack.pop_back();
+                bool divide = opcode == Opcode::OP_DIVIDE || opcode == Opcode::OP_DIVIDE_NUM;
+                stack.back() = arithmeticType(divide, stack.back(), second);
+                break;
+            }
+            case Opcode::OP_DEFINE_GLOBAL:
+                if (!sharedGlobals) globals[*constant->data.string] = stack.back();
+                stack.pop_back();
+                break;
+            case Opcode::OP_GET_GLOBAL: {
+                auto found = globals.find(*constant->data.string);
+                stack.push_back(found == globals.end() ? InferredType::UNKNOWN : found->second);
+                break;
+            }
+            case Opcode::OP_SET_GLOBAL:
+                if (!sharedGlobals) globals[*constant->data.string] = stack.back();
+                break;
+            case Opcode::OP_POP:
+            case Opcode::OP_PRINT:
+                stack.pop_back();
+                break;
+            case Opcode::OP_YIELD:
+                globals.clear(); //the host may touch globals while we're suspended
+                break;
+            case Opcode::OP_IMPORT:
+                globals.clear(); //so may the module
+                break;
+            case Opcode::OP_ARRAY:
+                stack.push_back(InferredType::ARRAY);
+                break;
+            case Opcode::OP_APPEND:
+            case Opcode::OP_DOT:
+                stack.pop_back();
+                stack.back() = opcode == Opcode::OP_DOT ? InferredType::NUMBER : InferredType::ARRAY;
+                break;
+            case Opcode::OP_SUM:
+            case Opcode::OP_MIN:
+            case Opcode::OP_MAX:
+                stack.back() = InferredType::NUMBER;
+                break;
+            case Opcode::OP_LENGTH:
+                stack.back() = InferredType::INTEGER;
+                break;
+            case Opcode::OP_RANGE:
+                stack.back() = InferredType::ARRAY;
+                break;
+            case Opcode::OP_RETURN:
+                result.ok = true; //whatever follows never runs
+                return result;
+            case Opcode::OP_BREAK: //failed above , before its operands were looked at
+                __builtin_unreachable();
+        }
+        result.maxStack = std::max(result.maxStack, stack.size());
+    }
+    result.ok = true;
+    return result;
+}
+
+bool verifyChunk(Chunk* chunk, Verification* result, bool sharedGlobals) {
+    Verification verification = checkChunk(chunk, sharedGlobals);
+    chunk->verified = verification.ok;
+    chunk->sharedGlobals = verification.ok && sharedGlobals;
+    chunk->maxStack = verification.ok ? verification.maxStack : 0;
+    if (result != nullptr) *result = verification;
+    return verification.ok;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "common.hpp"
+
+class Chunk;
+
+// load time checks that make VM::run's unchecked dispatch safe for a chunk :
+//   every opcode is known and has its operand , every operand indexes the constant pool ,
+//   global opcodes name a string constant , nothing pops an empty stack , and the unchecked _NUM
+//   opcodes only ever see doubles (proven the same way the type pass does it).
+// the code has no jumps , so the one path through it is all paths and the deepest the stack gets
+// is exact. compile() verifies what it emits , VM::run verifies anything else the first time it
+// sees it. editing code or constants by hand after that has to clear Chunk::verified.
+struct Verification {
+    bool ok = false;
+    size_t maxStack = 0; //values on the stack at its deepest , on top of what was there before
+    int offset = -1;     //of the first bad instruction
+    std::string message;
+};
+
+// sharedGlobals : another thread may write any global between two instructions , so a global read
+// is never assumed to have the type this chunk last stored in it (what a SharedGlobals store needs)
+Verification checkChunk(const Chunk* chunk, bool sharedGlobals = false);
+// checkChunk and , if it passed , mark the chunk verified with its max stack (and Chunk::sharedGlobals)
+bool verifyChunk(Chunk* chunk, Verification* result = nullptr, bool sharedGlobals = false);
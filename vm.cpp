@@ -4,6 +4,12 @@
 #include "chunk.hpp"
 #include "opcode.hpp"
 #include "compiler.hpp"
+#include "jit.hpp"
+#include "profiler.hpp"
+#include "timing.hpp"
+#include "verifier.hpp"
+#include "snapshot.hpp"
+#include "modules.hpp"
 
 //for writing in ot insides , to show the opcodes
 std::string getString(Opcode opcode) {
@@ -27,6 +33,24 @@ std::string getString(Opcode opcode) {
         case Opcode::OP_SET_GLOBAL:    return "OP_SET_GLOBAL";
         case Opcode::OP_POP:           return "OP_POP";
         case Opcode::OP_PRINT:         return "OP_PRINT";
+        case Opcode::OP_NEGATE_NUM:    return "OP_NEGATE_NUM";
+        case Opcode::OP_ADD_NUM:       return "OP_ADD_NUM";
+        case Opcode::OP_SUBTRACT_NUM:  return "OP_SUBTRACT_NUM";
+        case Opcode::OP_MULTIPLY_NUM:  return "OP_MULTIPLY_NUM";
+        case Opcode::OP_DIVIDE_NUM:    return "OP_DIVIDE_NUM";
+        case Opcode::OP_GREATER_NUM:   return "OP_GREATER_NUM";
+        case Opcode::OP_LESSER_NUM:    return "OP_LESSER_NUM";
+        case Opcode::OP_YIELD:         return "OP_YIELD";
+        case Opcode::OP_ARRAY:         return "OP_ARRAY";
+        case Opcode::OP_APPEND:        return "OP_APPEND";
+        case Opcode::OP_SUM:           return "OP_SUM";
+        case Opcode::OP_MIN:           return "OP_MIN";
+        case Opcode::OP_MAX:           return "OP_MAX";
+        case Opcode::OP_DOT:           return "OP_DOT";
+        case Opcode::OP_LENGTH:        return "OP_LENGTH";
+        case Opcode::OP_RANGE:         return "OP_RANGE";
+        case Opcode::OP_IMPORT:        return "OP_IMPORT";
+        case Opcode::OP_BREAK:         return "OP_BREAK";
         default:                       return "UNKNOWN_OPCODE";
     }
 }
@@ -37,45 +61,261 @@ Value VM::peek(int distance) {
 
 InterpretResult VM::interpret(Chunk* chunk) {
     this->chunk = chunk;
-    return run();
+    this->ip = 0;
+    startLimits();
+    InterpretResult result;
+    do {
+        result = run();
+    } while (result == InterpretResult::INTERPRET_YIELD); //nobody to hand control to , carry on
+    return result;
+}
+
+void VM::start(Chunk* chunk) {
+    this->chunk = chunk;
+    this->ip = 0;
+    this->stack.clear();
+    startLimits();
+}
+
+void VM::continueWith(Chunk* chunk) {
+    this->chunk = chunk;
+    this->ip = 0;
+    this->limitCache = LimitCache(); //keyed by the chunk , which may hold other code of the same size now
 }
 
-InterpretResult VM::run() {
-    for (int i = 0; i < this->chunk->code.size(); i++) {
+// ------ LIMITS ------
+
+static size_t globalBytes(const std::string& name, const Value& value) {
+    size_t bytes = sizeof(std::pair<const std::string, Value>) + 2 * sizeof(void*); //node + bucket
+    if (name.size() >= sizeof(std::string)) bytes += name.size() + 1;               //past the small string buffer
+    if (value.type == valueType::STRING) bytes += sizeof(std::string) + value.data.string->size() + 1;
+    return bytes; //an array's elements are charged where it's made , see arrayBytes
+}
+
+void VM::startLimits() {
+    this->instructionsLeft = this->limits.instructions;
+    if (this->limits.heapBytes != 0) {
+        this->heapUsed = 0;
+        for (auto& global : this->globals) {
+            this->heapUsed += globalBytes(global.first, global.second);
+        }
+    }
+}
+
+// first instruction the limits won't let a run starting at from execute , code.size() if none.
+// everything executed and the stack depth at every point are known up front.
+size_t VM::limitEnd(size_t from, const char*& reason) {
+    const std::vector<Opcode>& code = this->chunk->code;
+    if (this->limits.stackDepth == 0
+        && (this->limits.instructions == 0 || code.size() - from <= this->instructionsLeft)) {
+        return code.size(); //instructions <= code units , can't run out
+    }
+    bool fresh = from == 0 && this->stack.empty() && this->instructionsLeft == this->limits.instructions;
+    LimitCache& cache = this->limitCache;
+    if (fresh && cache.chunk == this->chunk && cache.codeSize == code.size()
+        && cache.instructions == this->limits.instructions && cache.stackDepth == this->limits.stackDepth) {
+        reason = cache.reason;
+        return cache.end;
+    }
+
+    size_t executed = 0;
+    size_t depth = this->stack.size();
+    size_t i = from;
+    reason = nullptr;
+    for (; i < code.size(); i += opcodeLength(code[i])) {
+        if (this->limits.instructions != 0 && executed == this->instructionsLeft) {
+            reason = "Instruction budget exceeded";
+            break;
+        }
+        depth += stackEffect(code[i]);
+        if (this->limits.stackDepth != 0 && depth > this->limits.stackDepth) {
+            reason = "Stack limit exceeded";
+            break;
+        }
+        executed++;
+    }
+    if (fresh) {
+        cache = LimitCache{this->chunk, code.size(), this->limits.instructions, this->limits.stackDepth, i, reason};
+    }
+    return i;
+}
+
+// accounts for value replacing old (null when the global is new) , false if that goes over the limit
+bool VM::chargeHeap(const std::string& name, const Value* old, const Value& value) {
+    size_t used = this->heapUsed + globalBytes(name, value) - (old ? globalBytes(name, *old) : 0);
+    if (used + this->arrayBytes->load(std::memory_order_relaxed) > this->limits.heapBytes) {
+        return false;
+    }
+    this->heapUsed = used;
+    return true;
+}
+
+// the heap limit sees it from here on , like a global that was defined , but never refuses it
+std::unordered_map<std::string, Value>::iterator VM::faultGlobal(const std::string& name) {
+    Value value;
+    if (this->snapshot == nullptr || !this->snapshot->find(name, value)) {
+        return this->globals.end();
+    }
+    if (this->limits.heapBytes != 0) this->heapUsed += globalBytes(name, value);
+    return this->globals.emplace(name, std::move(value)).first;
+}
+
+InterpretResult VM::run(size_t budget) {
+    PhaseTimer phase("run");
+    // compiled chunks come verified , anything else is checked once here. from then on the loop
+    // below trusts operands , constant types and stack depth without looking
+    Verification verification;
+    bool shared = this->shared != nullptr;
+    bool verified = this->chunk->verified && (!shared || this->chunk->sharedGlobals);
+    bool privateOnly = shared && this->chunk->verified; //fine on its own globals , not on shared ones
+    if (!verified && !verifyChunk(this->chunk, &verification, shared)) {
+        if (privateOnly) verification.message += " , compile it with sharedGlobals to run it on shared globals";
+        size_t at = static_cast<size_t>(verification.offset);
+        *this->output << "Runtime Error: Invalid bytecode: " << verification.message << " at offset " << at;
+        if (at < this->chunk->lines.size()) *this->output << " (line " << this->chunk->lines[at] << ")";
+        *this->output << std::endl;
+        resetStack();
+        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+    }
+    if (this->ip == 0) {
+        this->stack.reserve(this->stack.size() + this->chunk->maxStack); //pushes never reallocate
+    }
+    bool limited = this->limits.instructions != 0 || this->limits.stackDepth != 0 || this->limits.heapBytes != 0;
+    std::optional<ArrayCharge> arrayCharge; //arrays made from here on count against the heap limit
+    if (this->limits.heapBytes != 0) arrayCharge.emplace(this->arrayBytes);
+    if (this->useJit && this->ip == 0 && budget == 0 && !limited && !shared) { //JIT code doesn't check limits
+        auto jit = this->jitCache.find(this->chunk->revision);
+        if (jit == this->jitCache.end()) {
+            std::unique_ptr<JitCode> compiled = JitCode::compile(this->chunk, this);
+            if (compiled) {
+                if (this->jitCache.size() >= MAX_JIT_CACHE) this->jitCache.clear();
+                jit = this->jitCache.emplace(this->chunk->revision, std::move(compiled)).first;
+            }
+        }
+        if (jit != this->jitCache.end() && jit->second->run(this)) {
+            return InterpretResult::INTERPRET_OK;
+        }
+    }
+
+    // the code has no jumps , so a budget is just a point in the code array we stop at
+    const char* limitReason = nullptr;
+    size_t limit = limitEnd(this->ip, limitReason);
+    int end = static_cast<int>(limit);
+    if (budget > 0 && this->ip + budget < limit) {
+        end = static_cast<int>(this->ip + budget);
+    }
+    size_t from = this->ip;
+    if (timeline.enabled.load(std::memory_order_relaxed)) {
+        phase.count("codeUnits", end - from);
+        phase.count("peakStack", this->stack.size() + peakStackDepth(this->chunk, from, end));
+    }
+    auto arraysOverHeap = [&](int at) { //after an instruction that may have made an array
+        if (this->limits.heapBytes == 0
+            || this->heapUsed + this->arrayBytes->load(std::memory_order_relaxed) <= this->limits.heapBytes) {
+            return false;
+        }
+        this->runtimeError("Heap limit exceeded", at);
+        return true;
+    };
+    auto charge = [&](int at) { //what ran since from , against the instruction limit
+        if (this->limits.instructions != 0) {
+            for (size_t k = from; k < static_cast<size_t>(at); k += opcodeLength(this->chunk->code[k])) {
+                this->instructionsLeft--;
+            }
+        }
+    };
+    auto suspend = [&](int at) {
+        charge(at);
+        this->ip = at;
+        return InterpretResult::INTERPRET_YIELD;
+    };
+    SharedReadSection reading(this->shared, this->reader); //quiescent again once we return
+    int i = static_cast<int>(this->ip);
+#ifdef CLOX_PROFILE
+    ProfileCursor profile(this->chunk);
+#endif
+    for (; i < end; i++) {
+#ifdef CLOX_PROFILE
+        profile.step(i, this->chunk->code[i]);
+#endif
         switch (this->chunk->code[i]) {
             case Opcode::OP_NEGATE:
-                if (peek(0).type != valueType::NUMBER) {
+                if (!isNumeric(this->stack.back()) && this->stack.back().type != valueType::ARRAY) {
                     this->runtimeError("You do know only numbers support '-' right?", i);
                     return InterpretResult::INTERPRET_RUNTIME_ERROR;
                 }
                 this->stack[stack.size() - 1].negate();
+                if (this->stack.back().type == valueType::ARRAY && arraysOverHeap(i)) {
+                    return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                }
                 break;
             case Opcode::OP_ADD: {
+                // integer fast path , in place when it doesn't overflow (an overflow goes on to the
+                // generic path , which promotes to double)
+                Value& below = this->stack[this->stack.size() - 2];
+                const Value& top = this->stack.back();
+                int64_t result;
+                if (bothIntegers(below, top) && !__builtin_add_overflow(below.data.integer, top.data.integer, &result)) {
+                    below.data.integer = result;
+                    this->stack.pop_back();
+                    break;
+                }
                 Value addSecond = this->pop();
                 Value addFirst = this->pop();
-                if (addFirst.type != valueType::NUMBER || addSecond.type != valueType::NUMBER) {
-                    this->runtimeError("Invalid operation for given operands", i);
-                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                if (!isNumeric(addFirst) || !isNumeric(addSecond)) {
+                    if (const char* error = arrayArithmetic(Opcode::OP_ADD, addFirst, addSecond)) {
+                        this->runtimeError(error, i);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    push(std::move(addFirst));
+                    if (arraysOverHeap(i)) return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                    break;
                 }
                 push(addFirst + addSecond);
                 break;
             }
             case Opcode::OP_SUBTRACT: {
+                Value& below = this->stack[this->stack.size() - 2];
+                const Value& top = this->stack.back();
+                int64_t result;
+                if (bothIntegers(below, top) && !__builtin_sub_overflow(below.data.integer, top.data.integer, &result)) {
+                    below.data.integer = result;
+                    this->stack.pop_back();
+                    break;
+                }
                 Value subtractSecond = this->pop();
                 Value subtractFirst = this->pop();
-                if (subtractFirst.type != valueType::NUMBER || subtractSecond.type != valueType::NUMBER) {
-                    this->runtimeError("Invalid operation for given operands", i);
-                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                if (!isNumeric(subtractFirst) || !isNumeric(subtractSecond)) {
+                    if (const char* error = arrayArithmetic(Opcode::OP_SUBTRACT, subtractFirst, subtractSecond)) {
+                        this->runtimeError(error, i);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    push(std::move(subtractFirst));
+                    if (arraysOverHeap(i)) return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                    break;
                 }
                 push(subtractFirst - subtractSecond);
                 break;
             }
             case Opcode::OP_MULTIPLY: {
+                Value& below = this->stack[this->stack.size() - 2];
+                const Value& top = this->stack.back();
+                int64_t result;
+                if (bothIntegers(below, top) && !__builtin_mul_overflow(below.data.integer, top.data.integer, &result)) {
+                    below.data.integer = result;
+                    this->stack.pop_back();
+                    break;
+                }
                 Value multiplySecond = this->pop();
                 Value multiplyFirst = this->pop();
-                if (multiplyFirst.type != valueType::NUMBER || multiplySecond.type != valueType::NUMBER) {
-                    this->runtimeError("Invalid operation for given operands", i);
-                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                if (!isNumeric(multiplyFirst) || !isNumeric(multiplySecond)) {
+                    if (const char* error = arrayArithmetic(Opcode::OP_MULTIPLY, multiplyFirst, multiplySecond)) {
+                        this->runtimeError(error, i);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    push(std::move(multiplyFirst));
+                    if (arraysOverHeap(i)) return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                    break;
                 }
                 push(multiplyFirst * multiplySecond);
                 break;
@@ -83,14 +323,20 @@ InterpretResult VM::run() {
             case Opcode::OP_DIVIDE: {
                 Value divideSecond = this->pop();
                 Value divideFirst = this->pop();
-                if (divideFirst.type != valueType::NUMBER || divideSecond.type != valueType::NUMBER) {
-                    this->runtimeError("Invalid operation for given operands", i);
-                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                if (!isNumeric(divideFirst) || !isNumeric(divideSecond)) {
+                    if (const char* error = arrayArithmetic(Opcode::OP_DIVIDE, divideFirst, divideSecond)) {
+                        this->runtimeError(error, i);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    push(std::move(divideFirst));
+                    if (arraysOverHeap(i)) return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                    break;
                 }
                 push(divideFirst / divideSecond);
                 break;
             }
             case Opcode::OP_RETURN: {
+                charge(i); //a stream's next segment goes on with what's left
                 return InterpretResult::INTERPRET_OK;
             }
             case Opcode::OP_CONSTANT: {
@@ -120,44 +366,46 @@ InterpretResult VM::run() {
             case Opcode::OP_EQUAL: {
                 Value first = this->pop();
                 Value second = this->pop();
-                if (first.type != second.type) {
-                    push(Value(false));
-                } else {
-                    if (first.type == valueType::NUMBER) {
-                        push(Value(first.data.number == second.data.number));
-                    } else if (first.type == valueType::BOOLEAN) {
-                        push(Value(first.data.boolean == second.data.boolean));
-                    } else if (first.type == valueType::NIL) {
-                        push(Value(true));
-                    } else {
-                        push(Value(false));
-                    }
-                }
+                push(Value(valuesEqual(first, second)));
                 break;
             }
             case Opcode::OP_GREATER: {
+                Value& below = this->stack[this->stack.size() - 2];
+                const Value& top = this->stack.back();
+                if (bothIntegers(below, top)) {
+                    below = Value(below.data.integer > top.data.integer);
+                    this->stack.pop_back();
+                    break;
+                }
                 Value second = this->pop();
                 Value first = this->pop();
-                if (first.type != valueType::NUMBER || second.type != valueType::NUMBER) {
+                if (!isNumeric(first) || !isNumeric(second)) {
                     this->runtimeError("Invalid operation for given operands", i);
                     return InterpretResult::INTERPRET_RUNTIME_ERROR;
                 }
-                push(Value(first.data.number > second.data.number));
+                push(Value(greaterThan(first, second)));
                 break;
             }
             case Opcode::OP_LESSER: {
+                Value& below = this->stack[this->stack.size() - 2];
+                const Value& top = this->stack.back();
+                if (bothIntegers(below, top)) {
+                    below = Value(below.data.integer < top.data.integer);
+                    this->stack.pop_back();
+                    break;
+                }
                 Value second = this->pop();
                 Value first = this->pop();
-                if (first.type != valueType::NUMBER || second.type != valueType::NUMBER) {
+                if (!isNumeric(first) || !isNumeric(second)) {
                     this->runtimeError("Invalid operation for given operands", i);
                     return InterpretResult::INTERPRET_RUNTIME_ERROR;
                 }
-                push(Value(first.data.number < second.data.number));
+                push(Value(lessThan(first, second)));
                 break;
             }
             case Opcode::OP_PRINT: {
-                pop().printValue();
-                std::cout << std::endl;
+                pop().printValue(*this->output);
+                *this->output << '\n';
                 break;
             }
             case Opcode::OP_POP: {
@@ -165,44 +413,227 @@ InterpretResult VM::run() {
                 break;
             }
             case Opcode::OP_DEFINE_GLOBAL: {
-                std::string name = this->chunk->constants.ValueVector[static_cast<int>(this->chunk->code[i + 1])].getString();
+                const std::string& name = *this->chunk->constants.ValueVector[static_cast<int>(this->chunk->code[i + 1])].data.string;
+                if (shared) {
+                    this->shared->define(name, this->stack.back());
+                    this->stack.pop_back();
+                    i++;
+                    break;
+                }
+                if (this->limits.heapBytes != 0) {
+                    auto found = globals.find(name);
+                    if (!chargeHeap(name, found == globals.end() ? nullptr : &found->second, this->stack.back())) {
+                        this->runtimeError("Heap limit exceeded", i);
+                        return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                    }
+                }
                 globals[name] = peek(0);
                 pop();
                 i++;
                 break;
             }
             case Opcode::OP_GET_GLOBAL: {
-                std::string name = this->chunk->constants.ValueVector[static_cast<int>(this->chunk->code[i + 1])].getString();
-                if (globals.find(name) == globals.end()) {
+                const std::string& name = *this->chunk->constants.ValueVector[static_cast<int>(this->chunk->code[i + 1])].data.string;
+                if (shared) {
+                    this->stack.emplace_back();
+                    if (!this->shared->get(name, this->stack.back())) {
+                        this->runtimeError("Undefined variable '" + name + "'", i);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    i++;
+                    break;
+                }
+                auto found = globals.find(name);
+                if (found == globals.end() && (this->snapshot == nullptr || (found = faultGlobal(name)) == globals.end())) {
                     this->runtimeError("Undefined variable '" + name + "'", i);
                     return InterpretResult::INTERPRET_RUNTIME_ERROR;
                 }
-                push(globals[name]);
+                push(found->second);
                 i++;
                 break;
             }
             case Opcode::OP_SET_GLOBAL: {
-                std::string name = this->chunk->constants.ValueVector[static_cast<int>(this->chunk->code[i + 1])].getString();
-                if (globals.find(name) == globals.end()) {
+                const std::string& name = *this->chunk->constants.ValueVector[static_cast<int>(this->chunk->code[i + 1])].data.string;
+                if (shared) {
+                    if (!this->shared->set(name, this->stack.back())) {
+                        this->runtimeError("Undefined variable '" + name + "'", i);
+                        return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                    }
+                    i++;
+                    break;
+                }
+                auto found = globals.find(name);
+                if (found == globals.end() && (this->snapshot == nullptr || (found = faultGlobal(name)) == globals.end())) {
                     this->runtimeError("Undefined variable '" + name + "'", i);
                     return InterpretResult::INTERPRET_RUNTIME_ERROR;
                 }
-                globals[name] = peek(0);
+                // only strings change the size of an existing global , arrays are charged where they're made
+                bool resized = found->second.type == valueType::STRING || this->stack.back().type == valueType::STRING;
+                if (this->limits.heapBytes != 0 && resized && !chargeHeap(name, &found->second, this->stack.back())) {
+                    this->runtimeError("Heap limit exceeded", i);
+                    return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                }
+                found->second = peek(0);
                 i++;
                 break;
             }
+            // unchecked variants , the type pass already proved both operands are numbers
+            case Opcode::OP_NEGATE_NUM: {
+                this->stack.back().data.number = -this->stack.back().data.number;
+                break;
+            }
+            case Opcode::OP_ADD_NUM: {
+                double second = this->stack.back().data.number;
+                this->stack.pop_back();
+                this->stack.back().data.number += second;
+                break;
+            }
+            case Opcode::OP_SUBTRACT_NUM: {
+                double second = this->stack.back().data.number;
+                this->stack.pop_back();
+                this->stack.back().data.number -= second;
+                break;
+            }
+            case Opcode::OP_MULTIPLY_NUM: {
+                double second = this->stack.back().data.number;
+                this->stack.pop_back();
+                this->stack.back().data.number *= second;
+                break;
+            }
+            case Opcode::OP_DIVIDE_NUM: {
+                double second = this->stack.back().data.number;
+                this->stack.pop_back();
+                this->stack.back().data.number /= second;
+                break;
+            }
+            case Opcode::OP_GREATER_NUM: {
+                double second = this->stack.back().data.number;
+                this->stack.pop_back();
+                this->stack.back() = Value(this->stack.back().data.number > second);
+                break;
+            }
+            case Opcode::OP_LESSER_NUM: {
+                double second = this->stack.back().data.number;
+                this->stack.pop_back();
+                this->stack.back() = Value(this->stack.back().data.number < second);
+                break;
+            }
+            case Opcode::OP_YIELD: {
+                return suspend(i + 1);
+            }
+            case Opcode::OP_BREAK: { //stop on the trap , the debugger runs what it replaced. it sets no limits
+                this->ip = i;
+                return InterpretResult::INTERPRET_BREAK;
+            }
+            // arrays , element-wise arithmetic is in the arithmetic cases above. the work is in array.cpp
+            case Opcode::OP_ARRAY: {
+                push(Value(NumberArray::create(0)));
+                if (arraysOverHeap(i)) return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                break;
+            }
+            case Opcode::OP_APPEND: {
+                Value element = this->pop();
+                if (const char* error = arrayAppend(this->stack.back(), element)) {
+                    this->runtimeError(error, i);
+                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                }
+                if (arraysOverHeap(i)) return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                break;
+            }
+            case Opcode::OP_RANGE:
+                if (this->limits.heapBytes != 0 && this->stack.back().type == valueType::INTEGER
+                    && this->stack.back().data.integer > static_cast<int64_t>(this->limits.heapBytes / sizeof(double))) {
+                    this->runtimeError("Heap limit exceeded", i);
+                    return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                }
+                [[fallthrough]];
+            case Opcode::OP_SUM:
+            case Opcode::OP_MIN:
+            case Opcode::OP_MAX:
+            case Opcode::OP_LENGTH: {
+                if (const char* error = arrayBuiltin(this->chunk->code[i], this->stack.back())) {
+                    this->runtimeError(error, i);
+                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                }
+                if (this->chunk->code[i] == Opcode::OP_RANGE && arraysOverHeap(i)) {
+                    return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+                }
+                break;
+            }
+            case Opcode::OP_DOT: {
+                Value second = this->pop();
+                if (const char* error = arrayDot(this->stack.back(), second)) {
+                    this->runtimeError(error, i);
+                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                }
+                break;
+            }
+            // the module's top level runs here like a nested interpret() , on this VM's stack ,
+            // globals and limits , in one go whatever the budget
+            case Opcode::OP_IMPORT: {
+                const std::string& name = *this->chunk->constants.ValueVector[static_cast<int>(this->chunk->code[i + 1])].data.string;
+                Module* module = this->modules != nullptr ? this->modules->find(name) : nullptr;
+                if (module == nullptr) {
+                    this->runtimeError("Module '" + name + "' isn't loaded", i);
+                    return InterpretResult::INTERPRET_RUNTIME_ERROR;
+                }
+                i++;
+                if (!this->imported.insert(module).second) {
+                    break; //ran already , or is running and this is an import cycle
+                }
+                charge(i + 1);
+                Chunk* importer = this->chunk;
+                this->chunk = &module->chunk;
+                this->ip = 0;
+                InterpretResult result;
+                do {
+                    result = run(); //charges what it ran , at its OP_RETURN or when it yields
+                } while (result == InterpretResult::INTERPRET_YIELD);
+                this->chunk = importer;
+                if (result != InterpretResult::INTERPRET_OK) {
+                    return result; //reported at the module's line
+                }
+                if (shared) this->shared->enter(this->reader); //the module's run left the read section
+                from = i + 1;
+                limit = limitEnd(from, limitReason); //the module used some of what was left
+                end = std::min(end, static_cast<int>(limit));
+                break;
+            }
         }
     }
+    if (i == static_cast<int>(limit) && limit < this->chunk->code.size()) {
+        this->runtimeError(limitReason, i);
+        return InterpretResult::INTERPRET_BUDGET_EXCEEDED;
+    }
+    if (i < static_cast<int>(this->chunk->code.size())) {
+        return suspend(i); //out of budget for this slice
+    }
     return InterpretResult::INTERPRET_OK;
 }
 
 void VM::initVM() {
     this->stack = {};
     this->globals.clear();
+    this->imported.clear();
+}
+
+VM::~VM() {
+    share(nullptr);
+}
+
+void VM::share(SharedGlobals* store) {
+    if (this->reader != nullptr) {
+        this->shared->detach(this->reader);
+        this->reader = nullptr;
+    }
+    this->shared = store;
+    if (store != nullptr) {
+        this->reader = store->attach();
+    }
 }
 
 Value VM::pop() {
-    Value result = this->stack.back();
+    Value result = std::move(this->stack.back());
     this->stack.pop_back();
     return result;
 }
@@ -215,7 +646,12 @@ InterpretResult VM::interpret(const std::string source) {
     Chunk chunk;
     chunk.initChunk();
 
-    if (!compile(source, &chunk)) {
+    bool compiled = compile(source, &chunk, this->optimizationLevel, nullptr, this->shared != nullptr);
+    if (compiled && this->modules != nullptr && !this->modules->load(chunk, std::cerr)) {
+        chunk.freeChunk();
+        return InterpretResult::INTERPRET_COMPILE_ERROR;
+    }
+    if (!compiled) {
         // Dump opcode/constant info on compile error too
         std::ofstream out("C:\\Users\\samar\\CLionProjects\\cppcompiler\\insides.lol");
         out << "Opcode Array:\n";
@@ -223,7 +659,8 @@ InterpretResult VM::interpret(const std::string source) {
         for (size_t i = 0; i < code.size(); ++i) {
             out << i << ": " << getString(code[i]);
             if (code[i] == Opcode::OP_CONSTANT || code[i] == Opcode::OP_DEFINE_GLOBAL ||
-                code[i] == Opcode::OP_GET_GLOBAL || code[i] == Opcode::OP_SET_GLOBAL) {
+                code[i] == Opcode::OP_GET_GLOBAL || code[i] == Opcode::OP_SET_GLOBAL ||
+                code[i] == Opcode::OP_IMPORT) {
                 out << " [" << static_cast<int>(code[i+1]) << "]";
                 ++i;
                 }
@@ -242,7 +679,8 @@ InterpretResult VM::interpret(const std::string source) {
     for (size_t i = 0; i < code.size(); ++i) {
         out << i << ": " << getString(code[i]);
         if (code[i] == Opcode::OP_CONSTANT || code[i] == Opcode::OP_DEFINE_GLOBAL ||
-            code[i] == Opcode::OP_GET_GLOBAL || code[i] == Opcode::OP_SET_GLOBAL) {
+            code[i] == Opcode::OP_GET_GLOBAL || code[i] == Opcode::OP_SET_GLOBAL ||
+            code[i] == Opcode::OP_IMPORT) {
             out << " [" << static_cast<int>(code[i+1]) << "]";
             ++i;
             }
@@ -253,14 +691,13 @@ InterpretResult VM::interpret(const std::string source) {
 
     out.close();
 
-    this->chunk = &chunk;
-    InterpretResult result = run();
+    InterpretResult result = interpret(&chunk);
 
     chunk.freeChunk();
     return result;
 }
 void VM::runtimeError(std::string message, int codeIndex) {
-    std::cout << "Runtime Error: " << message << " at line " << this->chunk->lines[codeIndex] << std::endl;
+    *this->output << "Runtime Error: " << message << " at line " << this->chunk->lines[codeIndex] << std::endl;
     resetStack();
 }
 
@@ -2,22 +2,86 @@
 #include "common.hpp"
 #include "opcode.hpp"
 #include "result.hpp"
+#include "globals.hpp"
+#include "jit.hpp"
+#include <unordered_set>
 class Chunk;
 class Value;
+class Snapshot;
+class Modules;
+struct Module;
+
+const size_t MAX_JIT_CACHE = 64; //compiled chunks a VM keeps , all dropped when it fills
 
 class VM {
 public:
+    // per interpret() call , 0 = unlimited. going over one stops the run with INTERPRET_BUDGET_EXCEEDED.
+    // the code has no jumps , so instruction and stack limits are turned into a point in the code
+    // array before running instead of being checked on every dispatch. the heap is only checked
+    // where it grows , when a global is defined or assigned and when an array is made.
+    struct Limits {
+        size_t instructions = 0; //instructions executed , across yields
+        size_t stackDepth = 0;   //values on the stack
+        size_t heapBytes = 0;    //bytes held by VM::globals (entries , names , string values) and by the arrays
+                                 //made while it's set , on the stack or anywhere else. a shared store isn't counted
+    };
+
     Chunk* chunk;
     std::vector<Value> stack;
     std::unordered_map<std::string, Value> globals;
+    SharedGlobals* shared = nullptr; //where the global opcodes go instead of globals , set by share()
+    const Snapshot* snapshot = nullptr; //globals not in globals yet are looked up here , see snapshot.hpp
+    Modules* modules = nullptr; //where import statements find their module , see modules.hpp
+    std::unordered_set<const Module*> imported; //modules whose top level this VM has run , or is running
+    int optimizationLevel = 1; //passed to compile() , see compiler.hpp
+    bool useJit = false;       //try the baseline JIT first , see jit.hpp
+    std::unordered_map<uint64_t, std::unique_ptr<JitCode>> jitCache; //by Chunk::revision , a chunk run again isn't compiled again
+    std::ostream* output = &std::cout; //print statements and runtime errors
+    size_t ip = 0;             //where run() continues , saved when the VM yields
+    Limits limits;
+    size_t instructionsLeft = 0; //of limits.instructions , for this interpret() call
+    size_t heapUsed = 0;         //by globals , only kept up to date while limits.heapBytes is set
+    std::shared_ptr<std::atomic<size_t>> arrayBytes = std::make_shared<std::atomic<size_t>>(0); //live arrays made under it
+
+    VM() = default;
+    ~VM();
+    VM(const VM&) = delete; //a copy would share the reader
+    VM& operator=(const VM&) = delete;
 
     void initVM();
+    // read and write globals in store from now on (nullptr goes back to VM::globals). chunks run
+    // here have to be compiled with sharedGlobals , another thread may change a global's type
+    // between two instructions. --jit is ignored while shared
+    void share(SharedGlobals* store);
     InterpretResult interpret(Chunk* chunk);
     InterpretResult interpret(const std::string source);
-    InterpretResult run();
+    void start(Chunk* chunk);                //load a chunk without running it
+    // the next part of the current run : ip goes to chunk's start , the stack , globals and what's
+    // left of the limits stay. chunk may be the one that just ran , compiled again (see stream.hpp)
+    void continueWith(Chunk* chunk);
+    // continues from ip until the chunk ends , a yield statement , or budget code units have run
+    // (0 = no budget). returns INTERPRET_YIELD when suspended , the stack is kept as is.
+    InterpretResult run(size_t budget = 0);
     Value peek(int distance);
     void runtimeError(std::string message, int codeIndex);
     void resetStack();
+    void startLimits();
+    size_t limitEnd(size_t from, const char*& reason);
+    bool chargeHeap(const std::string& name, const Value* old, const Value& value);
+    // a global this VM hasn't got yet copied in from its snapshot , globals.end() if that has none either
+    std::unordered_map<std::string, Value>::iterator faultGlobal(const std::string& name);
     Value pop();
     void push(Value value);
+
+private:
+    struct LimitCache { //limitEnd() of a fresh run , the common case when the same chunk runs again
+        Chunk* chunk = nullptr;
+        size_t codeSize = 0;
+        size_t instructions = 0;
+        size_t stackDepth = 0;
+        size_t end = 0;
+        const char* reason = nullptr;
+    };
+    LimitCache limitCache;
+    SharedGlobals::Reader* reader = nullptr; //registered with shared
 };
\ No newline at end of file